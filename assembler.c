@@ -0,0 +1,1025 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "assembler.h"
+
+#define MAX_INSN 16
+#define MAX_NAME 256
+#define MAX_OPERANDS 3
+
+// The backend only writes the instructions and directives below, always in
+// the same spelling, so a line-at-a-time parser with no expression evaluator
+// is enough. Jumps always use rel32 forms, so instruction sizes never depend
+// on label values and one pass plus fixups suffices.
+
+typedef enum {
+    OPERAND_REG,
+    OPERAND_IMM,
+    OPERAND_MEM,
+    OPERAND_LABEL
+} OperandKind;
+
+typedef enum {
+    REG_GPR,
+    REG_XMM,
+    REG_YMM
+} RegClass;
+
+typedef struct {
+    OperandKind kind;
+    int reg;            // Register number 0-15
+    RegClass reg_class;
+    int size;           // GPR width in bytes: 1, 4 or 8
+    int64_t imm;
+    int base;           // Memory operands; -1 if absent
+    int index;
+    int scale;
+    int64_t disp;
+    char symbol[MAX_NAME];  // rip-relative memory symbol or jump target, "" if none
+} Operand;
+
+// One encoded instruction with at most one symbol-relative field
+typedef struct {
+    uint8_t bytes[MAX_INSN];
+    int len;
+    int fixup_pos;      // Offset of the 32-bit field, -1 if none
+    int fixup_symbol;
+    int64_t fixup_disp;
+    AsmRelocType fixup_type;
+} Insn;
+
+typedef struct {
+    const char* name;
+    int num;
+    int size;
+} GprName;
+
+static const GprName gprs[] = {
+    {"rax", 0, 8}, {"rcx", 1, 8}, {"rdx", 2, 8}, {"rbx", 3, 8},
+    {"rsp", 4, 8}, {"rbp", 5, 8}, {"rsi", 6, 8}, {"rdi", 7, 8},
+    {"r8", 8, 8}, {"r9", 9, 8}, {"r10", 10, 8}, {"r11", 11, 8},
+    {"r12", 12, 8}, {"r13", 13, 8}, {"r14", 14, 8}, {"r15", 15, 8},
+    {"eax", 0, 4}, {"ecx", 1, 4}, {"edx", 2, 4}, {"ebx", 3, 4},
+    {"esp", 4, 4}, {"ebp", 5, 4}, {"esi", 6, 4}, {"edi", 7, 4},
+    {"al", 0, 1}, {"cl", 1, 1}, {"dl", 2, 1}, {"bl", 3, 1},
+    {NULL, 0, 0}
+};
+
+// Condition codes of the jcc/setcc the backend uses
+typedef struct {
+    const char* cc;
+    int code;
+} CondCode;
+
+static const CondCode cond_codes[] = {
+    {"o", 0x0}, {"no", 0x1}, {"b", 0x2}, {"ae", 0x3}, {"z", 0x4}, {"e", 0x4},
+    {"nz", 0x5}, {"ne", 0x5}, {"be", 0x6}, {"a", 0x7}, {"s", 0x8}, {"ns", 0x9},
+    {"l", 0xC}, {"ge", 0xD}, {"le", 0xE}, {"g", 0xF},
+    {NULL, 0}
+};
+
+// Symbol whose size is "end - symbol", resolved once everything is defined
+typedef struct PendingSize {
+    int symbol;
+    char end[MAX_NAME];
+    struct PendingSize* next;
+} PendingSize;
+
+static AsmObject* obj;
+static int current_section;
+static char scope[MAX_NAME];  // Last non-local label; prefix of ".name" labels
+static int line_number;
+static PendingSize* pending_sizes;
+
+static void asm_error(const char* message, const char* detail) {
+    fprintf(stderr, "Error: assembler: line %d: %s '%s'\n", line_number, message, detail);
+    exit(1);
+}
+
+static unsigned hash_name(const char* name) {
+    unsigned hash = 2166136261u;
+    for (; *name; name++) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    }
+    return hash;
+}
+
+int find_asm_symbol(AsmObject* o, const char* name) {
+    unsigned mask = o->bucket_count - 1;
+    for (unsigned slot = hash_name(name) & mask;; slot = (slot + 1) & mask) {
+        int entry = o->buckets[slot];
+        if (entry == 0) {
+            return -1;
+        }
+        if (strcmp(o->symbols[entry - 1].name, name) == 0) {
+            return entry - 1;
+        }
+    }
+}
+
+static void grow_buckets(void) {
+    free(obj->buckets);
+    obj->bucket_count *= 2;
+    obj->buckets = calloc(obj->bucket_count, sizeof(int));
+    unsigned mask = obj->bucket_count - 1;
+    for (int i = 0; i < obj->symbol_count; i++) {
+        unsigned slot = hash_name(obj->symbols[i].name) & mask;
+        while (obj->buckets[slot]) {
+            slot = (slot + 1) & mask;
+        }
+        obj->buckets[slot] = i + 1;
+    }
+}
+
+// ".x" names are local to the last non-local label, as in NASM
+static void full_name(const char* name, char* out) {
+    if (name[0] == '.') {
+        snprintf(out, MAX_NAME, "%s%s", scope, name);
+    } else {
+        snprintf(out, MAX_NAME, "%s", name);
+    }
+}
+
+// Index of a symbol, created undefined on first reference
+static int symbol_index(const char* name) {
+    char full[MAX_NAME];
+    full_name(name, full);
+    int index = find_asm_symbol(obj, full);
+    if (index >= 0) {
+        return index;
+    }
+    if (obj->symbol_count >= obj->symbol_capacity) {
+        obj->symbol_capacity *= 2;
+        obj->symbols = realloc(obj->symbols, obj->symbol_capacity * sizeof(AsmSymbol));
+    }
+    if ((obj->symbol_count + 1) * 2 > obj->bucket_count) {
+        grow_buckets();
+    }
+    AsmSymbol* sym = &obj->symbols[obj->symbol_count];
+    memset(sym, 0, sizeof(*sym));
+    sym->name = strdup(full);
+    sym->section = -1;
+
+    unsigned mask = obj->bucket_count - 1;
+    unsigned slot = hash_name(full) & mask;
+    while (obj->buckets[slot]) {
+        slot = (slot + 1) & mask;
+    }
+    obj->buckets[slot] = ++obj->symbol_count;
+    return obj->symbol_count - 1;
+}
+
+static void define_label(const char* name) {
+    int index = symbol_index(name);
+    AsmSymbol* sym = &obj->symbols[index];
+    if (sym->section >= 0) {
+        asm_error("label defined twice:", sym->name);
+    }
+    sym->section = current_section;
+    sym->value = obj->sections[current_section].size;
+    if (name[0] != '.') {
+        snprintf(scope, sizeof(scope), "%s", name);
+    }
+}
+
+static void add_reloc(int section, size_t offset, AsmRelocType type, int symbol, int64_t addend) {
+    if (obj->reloc_count >= obj->reloc_capacity) {
+        obj->reloc_capacity *= 2;
+        obj->relocs = realloc(obj->relocs, obj->reloc_capacity * sizeof(AsmReloc));
+    }
+    AsmReloc* r = &obj->relocs[obj->reloc_count++];
+    r->section = section;
+    r->offset = offset;
+    r->type = type;
+    r->symbol = symbol;
+    r->addend = addend;
+}
+
+static void section_emit(const void* bytes, size_t n) {
+    AsmSection* sec = &obj->sections[current_section];
+    if (current_section == SECTION_BSS) {
+        asm_error("initialized data in", ".bss");
+    }
+    if (sec->size + n > sec->capacity) {
+        while (sec->size + n > sec->capacity) {
+            sec->capacity = sec->capacity ? sec->capacity * 2 : 4096;
+        }
+        sec->bytes = realloc(sec->bytes, sec->capacity);
+    }
+    memcpy(sec->bytes + sec->size, bytes, n);
+    sec->size += n;
+}
+
+// Zero bytes (nops in .text); .bss only grows
+static void section_fill(size_t n) {
+    AsmSection* sec = &obj->sections[current_section];
+    if (current_section == SECTION_BSS) {
+        sec->size += n;
+        return;
+    }
+    uint8_t fill = current_section <= SECTION_TEXT_UNLIKELY ? 0x90 : 0;
+    for (size_t i = 0; i < n; i++) {
+        section_emit(&fill, 1);
+    }
+}
+
+static void section_align(int align) {
+    AsmSection* sec = &obj->sections[current_section];
+    if (align > sec->align) {
+        sec->align = align;
+    }
+    size_t pad = (align - sec->size % align) % align;
+    section_fill(pad);
+}
+
+// Parsing helpers
+
+static char* skip_space(char* s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+static void trim_end(char* s) {
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char)s[len - 1])) {
+        s[--len] = '\0';
+    }
+}
+
+static int is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$' || c == '@' || c == '?';
+}
+
+static int parse_number(const char* s, int64_t* value) {
+    char* end;
+    if (*s == '-') {
+        *value = strtoll(s, &end, 10);
+    } else {
+        *value = (int64_t)strtoull(s, &end, 10);
+    }
+    return end != s && *skip_space(end) == '\0';
+}
+
+static int find_gpr(const char* name, int* num, int* size) {
+    for (int i = 0; gprs[i].name; i++) {
+        if (strcmp(gprs[i].name, name) == 0) {
+            *num = gprs[i].num;
+            *size = gprs[i].size;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int parse_register(const char* name, Operand* op) {
+    op->kind = OPERAND_REG;
+    if (find_gpr(name, &op->reg, &op->size)) {
+        op->reg_class = REG_GPR;
+        return 1;
+    }
+    if ((strncmp(name, "xmm", 3) == 0 || strncmp(name, "ymm", 3) == 0) && isdigit((unsigned char)name[3])) {
+        op->reg = atoi(name + 3);
+        op->reg_class = name[0] == 'x' ? REG_XMM : REG_YMM;
+        op->size = name[0] == 'x' ? 16 : 32;
+        return op->reg < 16;
+    }
+    return 0;
+}
+
+// [base + index*scale + disp], [base disp] or [rel symbol + disp]
+static void parse_memory(char* text, Operand* op) {
+    op->kind = OPERAND_MEM;
+    op->base = -1;
+    op->index = -1;
+    op->scale = 1;
+    op->disp = 0;
+    op->symbol[0] = '\0';
+
+    char* p = skip_space(text);
+    int rel = 0;
+    if (strncmp(p, "rel ", 4) == 0) {
+        rel = 1;
+        p = skip_space(p + 4);
+    }
+
+    int sign = 1;
+    while (*p) {
+        p = skip_space(p);
+        if (*p == '+') {
+            sign = 1;
+            p++;
+            continue;
+        }
+        if (*p == '-') {
+            sign = -1;
+            p++;
+            continue;
+        }
+        if (!*p) break;
+
+        char term[MAX_NAME];
+        int len = 0;
+        while (*p && *p != '+' && *p != '-' && *p != ' ' && len < MAX_NAME - 1) {
+            term[len++] = *p++;
+        }
+        term[len] = '\0';
+
+        int64_t value;
+        int num;
+        int size;
+        char* star = strchr(term, '*');
+        if (star) {
+            *star = '\0';
+            if (!find_gpr(term, &num, &size) || size != 8 || sign < 0) {
+                asm_error("bad index register", term);
+            }
+            op->index = num;
+            op->scale = atoi(star + 1);
+        } else if (find_gpr(term, &num, &size)) {
+            if (size != 8 || sign < 0) {
+                asm_error("bad base register", term);
+            }
+            if (op->base < 0) {
+                op->base = num;
+            } else {
+                op->index = num;
+            }
+        } else if (parse_number(term, &value)) {
+            op->disp += sign * value;
+        } else if (rel && !op->symbol[0]) {
+            snprintf(op->symbol, sizeof(op->symbol), "%s", term);
+        } else {
+            asm_error("bad memory operand term", term);
+        }
+        sign = 1;
+    }
+    if (rel != (op->symbol[0] != '\0') || (!rel && op->base < 0)) {
+        asm_error("unsupported addressing mode", text);
+    }
+}
+
+static void parse_operand(char* text, Operand* op) {
+    memset(op, 0, sizeof(*op));
+    char* p = skip_space(text);
+    trim_end(p);
+    // Size keywords only matter where no register fixes the size
+    if (strncmp(p, "qword ", 6) == 0) {
+        p = skip_space(p + 6);
+    }
+    if (*p == '[') {
+        char* close = strrchr(p, ']');
+        if (!close) {
+            asm_error("missing ']' in", p);
+        }
+        *close = '\0';
+        parse_memory(p + 1, op);
+        return;
+    }
+    if (parse_register(p, op)) {
+        return;
+    }
+    if (parse_number(p, &op->imm)) {
+        op->kind = OPERAND_IMM;
+        return;
+    }
+    for (char* c = p; *c; c++) {
+        if (!is_name_char(*c)) {
+            asm_error("bad operand", p);
+        }
+    }
+    op->kind = OPERAND_LABEL;
+    snprintf(op->symbol, sizeof(op->symbol), "%s", p);
+}
+
+// Encoding helpers
+
+static void put(Insn* in, uint8_t byte) {
+    in->bytes[in->len++] = byte;
+}
+
+static void put32(Insn* in, int64_t value) {
+    uint32_t v = (uint32_t)value;
+    for (int i = 0; i < 4; i++) {
+        put(in, (uint8_t)(v >> (8 * i)));
+    }
+}
+
+static int fits8(int64_t value) {
+    return value >= -128 && value <= 127;
+}
+
+static int fits32(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static int rm_ext(const Operand* rm) {
+    return rm->kind == OPERAND_REG ? rm->reg >> 3 : (rm->base >= 0 ? rm->base >> 3 : 0);
+}
+
+static int index_ext(const Operand* rm) {
+    return rm->kind == OPERAND_MEM && rm->index >= 0 ? rm->index >> 3 : 0;
+}
+
+static void emit_rex(Insn* in, int w, int reg, const Operand* rm) {
+    int rex = (w << 3) | (((reg >> 3) & 1) << 2) | (index_ext(rm) << 1) | rm_ext(rm);
+    if (rex) {
+        put(in, 0x40 | rex);
+    }
+}
+
+static void emit_modrm(Insn* in, int reg, const Operand* rm) {
+    reg &= 7;
+    if (rm->kind == OPERAND_REG) {
+        put(in, 0xC0 | (reg << 3) | (rm->reg & 7));
+        return;
+    }
+    if (rm->symbol[0]) {
+        // rip-relative; the field is patched once the instruction is complete
+        put(in, (reg << 3) | 5);
+        in->fixup_pos = in->len;
+        in->fixup_symbol = symbol_index(rm->symbol);
+        in->fixup_disp = rm->disp;
+        in->fixup_type = RELOC_PC32;
+        put32(in, 0);
+        return;
+    }
+    int base = rm->base & 7;
+    int mod = (rm->disp == 0 && base != 5) ? 0 : fits8(rm->disp) ? 1 : 2;
+    if (!fits32(rm->disp)) {
+        asm_error("displacement out of range", "");
+    }
+    if (rm->index >= 0 || base == 4) {
+        int ss = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2 ? 1 : 0;
+        int index = rm->index >= 0 ? rm->index & 7 : 4;
+        put(in, (mod << 6) | (reg << 3) | 4);
+        put(in, (ss << 6) | (index << 3) | base);
+    } else {
+        put(in, (mod << 6) | (reg << 3) | base);
+    }
+    if (mod == 1) {
+        put(in, (uint8_t)rm->disp);
+    } else if (mod == 2) {
+        put32(in, rm->disp);
+    }
+}
+
+// Opcode with a ModRM operand, e.g. 0F AF /r; w selects 64-bit operands
+static void emit_op_rm(Insn* in, int w, const uint8_t* opcode, int opcode_len, int reg, const Operand* rm) {
+    emit_rex(in, w, reg, rm);
+    for (int i = 0; i < opcode_len; i++) {
+        put(in, opcode[i]);
+    }
+    emit_modrm(in, reg, rm);
+}
+
+static void emit_op1(Insn* in, int w, uint8_t opcode, int reg, const Operand* rm) {
+    emit_op_rm(in, w, &opcode, 1, reg, rm);
+}
+
+// SSE2: mandatory prefix, REX, 0F opcode, ModRM
+static void emit_sse(Insn* in, uint8_t prefix, int w, uint8_t opcode, int reg, const Operand* rm) {
+    put(in, prefix);
+    uint8_t bytes[2] = {0x0F, opcode};
+    emit_op_rm(in, w, bytes, 2, reg, rm);
+}
+
+// Three-byte VEX: map 1 = 0F, 2 = 0F38; pp 1 = 66, 2 = F3
+static void emit_vex(Insn* in, int map, int pp, int l256, int w, int vvvv, uint8_t opcode,
+                     int reg, const Operand* rm) {
+    put(in, 0xC4);
+    put(in, (uint8_t)((!((reg >> 3) & 1) << 7) | (!index_ext(rm) << 6) | (!rm_ext(rm) << 5) | map));
+    put(in, (uint8_t)((w << 7) | ((~vvvv & 15) << 3) | (l256 << 2) | pp));
+    put(in, opcode);
+    emit_modrm(in, reg, rm);
+}
+
+static void emit_rel32(Insn* in, const Operand* target, AsmRelocType type) {
+    in->fixup_pos = in->len;
+    in->fixup_symbol = symbol_index(target->symbol);
+    in->fixup_disp = 0;
+    in->fixup_type = type;
+    put32(in, 0);
+}
+
+static int cond_code(const char* cc) {
+    for (int i = 0; cond_codes[i].cc; i++) {
+        if (strcmp(cond_codes[i].cc, cc) == 0) {
+            return cond_codes[i].code;
+        }
+    }
+    return -1;
+}
+
+static int alu_op(const char* m) {
+    static const char* names[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp", NULL};
+    for (int i = 0; names[i]; i++) {
+        if (strcmp(names[i], m) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int is_gpr(const Operand* op) {
+    return op->kind == OPERAND_REG && op->reg_class == REG_GPR;
+}
+
+static int is_rm(const Operand* op) {
+    return is_gpr(op) || op->kind == OPERAND_MEM;
+}
+
+static void bad_instruction(const char* mnemonic) {
+    asm_error("unsupported instruction or operands:", mnemonic);
+}
+
+// Encode one instruction into in
+static void encode(Insn* in, const char* m, Operand* ops, int count) {
+    Operand* a = &ops[0];
+    Operand* b = &ops[1];
+    int w = count > 0 && is_gpr(a) ? a->size == 8 : 1;
+    int alu = alu_op(m);
+    int cc;
+
+    if (count == 0) {
+        if (strcmp(m, "ret") == 0) {
+            put(in, 0xC3);
+        } else if (strcmp(m, "cqo") == 0) {
+            put(in, 0x48);
+            put(in, 0x99);
+        } else if (strcmp(m, "vzeroupper") == 0) {
+            put(in, 0xC5);
+            put(in, 0xF8);
+            put(in, 0x77);
+        } else if (strcmp(m, "nop") == 0) {
+            put(in, 0x90);
+        } else {
+            bad_instruction(m);
+        }
+        return;
+    }
+
+    if (alu >= 0 && count == 2) {
+        if (is_rm(a) && b->kind == OPERAND_IMM) {
+            if (fits8(b->imm)) {
+                emit_op1(in, w, 0x83, alu, a);
+                put(in, (uint8_t)b->imm);
+            } else if (fits32(b->imm)) {
+                emit_op1(in, w, 0x81, alu, a);
+                put32(in, b->imm);
+            } else {
+                bad_instruction(m);
+            }
+        } else if (is_rm(a) && is_gpr(b)) {
+            emit_op1(in, b->size == 8, (uint8_t)(alu * 8 + 1), b->reg, a);
+        } else if (is_gpr(a) && b->kind == OPERAND_MEM) {
+            emit_op1(in, w, (uint8_t)(alu * 8 + 3), a->reg, b);
+        } else {
+            bad_instruction(m);
+        }
+        return;
+    }
+
+    if (strcmp(m, "mov") == 0 && count == 2) {
+        if (is_gpr(a) && b->kind == OPERAND_IMM) {
+            if (a->size == 4) {
+                emit_rex(in, 0, 0, a);
+                put(in, (uint8_t)(0xB8 + (a->reg & 7)));
+                put32(in, b->imm);
+            } else if (fits32(b->imm)) {
+                emit_op1(in, 1, 0xC7, 0, a);
+                put32(in, b->imm);
+            } else {
+                emit_rex(in, 1, 0, a);
+                put(in, (uint8_t)(0xB8 + (a->reg & 7)));
+                put32(in, b->imm);
+                put32(in, b->imm >> 32);
+            }
+        } else if (a->kind == OPERAND_MEM && b->kind == OPERAND_IMM && fits32(b->imm)) {
+            emit_op1(in, 1, 0xC7, 0, a);
+            put32(in, b->imm);
+        } else if (is_rm(a) && is_gpr(b)) {
+            emit_op1(in, b->size == 8, 0x89, b->reg, a);
+        } else if (is_gpr(a) && b->kind == OPERAND_MEM) {
+            emit_op1(in, w, 0x8B, a->reg, b);
+        } else {
+            bad_instruction(m);
+        }
+        return;
+    }
+
+    if (strcmp(m, "test") == 0 && count == 2 && is_rm(a) && is_gpr(b)) {
+        emit_op1(in, b->size == 8, 0x85, b->reg, a);
+    } else if (strcmp(m, "lea") == 0 && count == 2 && is_gpr(a) && b->kind == OPERAND_MEM) {
+        emit_op1(in, 1, 0x8D, a->reg, b);
+    } else if (strcmp(m, "push") == 0 && count == 1) {
+        if (is_gpr(a)) {
+            if (a->reg >= 8) put(in, 0x41);
+            put(in, (uint8_t)(0x50 + (a->reg & 7)));
+        } else if (a->kind == OPERAND_IMM && fits8(a->imm)) {
+            put(in, 0x6A);
+            put(in, (uint8_t)a->imm);
+        } else if (a->kind == OPERAND_IMM && fits32(a->imm)) {
+            put(in, 0x68);
+            put32(in, a->imm);
+        } else {
+            bad_instruction(m);
+        }
+    } else if (strcmp(m, "pop") == 0 && count == 1 && is_gpr(a)) {
+        if (a->reg >= 8) put(in, 0x41);
+        put(in, (uint8_t)(0x58 + (a->reg & 7)));
+    } else if ((strcmp(m, "inc") == 0 || strcmp(m, "dec") == 0) && count == 1 && is_rm(a)) {
+        emit_op1(in, w, 0xFF, m[0] == 'i' ? 0 : 1, a);
+    } else if (strcmp(m, "neg") == 0 && count == 1 && is_rm(a)) {
+        emit_op1(in, w, 0xF7, 3, a);
+    } else if (strcmp(m, "idiv") == 0 && count == 1 && is_rm(a)) {
+        emit_op1(in, w, 0xF7, 7, a);
+    } else if (strcmp(m, "imul") == 0 && count == 1 && is_rm(a)) {
+        emit_op1(in, w, 0xF7, 5, a);
+    } else if (strcmp(m, "imul") == 0 && count == 2 && is_gpr(a) && is_rm(b)) {
+        static const uint8_t op[] = {0x0F, 0xAF};
+        emit_op_rm(in, w, op, 2, a->reg, b);
+    } else if (strcmp(m, "imul") == 0 && count == 3 && is_gpr(a) && is_rm(b) &&
+               ops[2].kind == OPERAND_IMM && fits32(ops[2].imm)) {
+        if (fits8(ops[2].imm)) {
+            emit_op1(in, w, 0x6B, a->reg, b);
+            put(in, (uint8_t)ops[2].imm);
+        } else {
+            emit_op1(in, w, 0x69, a->reg, b);
+            put32(in, ops[2].imm);
+        }
+    } else if ((strcmp(m, "shl") == 0 || strcmp(m, "shr") == 0 || strcmp(m, "sar") == 0) &&
+               count == 2 && is_rm(a) && b->kind == OPERAND_IMM) {
+        int ext = m[1] == 'h' ? (m[2] == 'l' ? 4 : 5) : 7;
+        if (b->imm == 1) {
+            emit_op1(in, w, 0xD1, ext, a);  // Shift by one has its own opcode
+        } else {
+            emit_op1(in, w, 0xC1, ext, a);
+            put(in, (uint8_t)b->imm);
+        }
+    } else if (strncmp(m, "cmov", 4) == 0 && (cc = cond_code(m + 4)) >= 0 && count == 2 &&
+               is_gpr(a) && is_rm(b)) {
+        uint8_t op[] = {0x0F, (uint8_t)(0x40 + cc)};
+        emit_op_rm(in, w, op, 2, a->reg, b);
+    } else if (strncmp(m, "set", 3) == 0 && (cc = cond_code(m + 3)) >= 0 && count == 1 &&
+               is_gpr(a) && a->size == 1) {
+        uint8_t op[] = {0x0F, (uint8_t)(0x90 + cc)};
+        emit_op_rm(in, 0, op, 2, 0, a);
+    } else if (strcmp(m, "movzx") == 0 && count == 2 && is_gpr(a) && is_gpr(b) && b->size == 1) {
+        static const uint8_t op[] = {0x0F, 0xB6};
+        emit_op_rm(in, a->size == 8, op, 2, a->reg, b);
+    } else if (strcmp(m, "jmp") == 0 && count == 1 && a->kind == OPERAND_LABEL) {
+        put(in, 0xE9);
+        emit_rel32(in, a, RELOC_PLT32);
+    } else if (strcmp(m, "call") == 0 && count == 1 && a->kind == OPERAND_LABEL) {
+        put(in, 0xE8);
+        emit_rel32(in, a, RELOC_PLT32);
+    } else if (m[0] == 'j' && (cc = cond_code(m + 1)) >= 0 && count == 1 && a->kind == OPERAND_LABEL) {
+        put(in, 0x0F);
+        put(in, (uint8_t)(0x80 + cc));
+        emit_rel32(in, a, RELOC_PC32);
+    } else if (strcmp(m, "movdqu") == 0 && count == 2 && a->reg_class == REG_XMM && a->kind == OPERAND_REG) {
+        emit_sse(in, 0xF3, 0, 0x6F, a->reg, b);
+    } else if (strcmp(m, "movdqu") == 0 && count == 2 && a->kind == OPERAND_MEM && b->reg_class == REG_XMM) {
+        emit_sse(in, 0xF3, 0, 0x7F, b->reg, a);
+    } else if (strcmp(m, "movq") == 0 && count == 2 && a->reg_class == REG_XMM && is_gpr(b)) {
+        emit_sse(in, 0x66, 1, 0x6E, a->reg, b);
+    } else if ((strcmp(m, "punpcklqdq") == 0 || strcmp(m, "paddq") == 0 || strcmp(m, "psubq") == 0) &&
+               count == 2 && a->reg_class == REG_XMM && a->kind == OPERAND_REG) {
+        uint8_t op = m[1] == 'u' ? 0x6C : m[1] == 'a' ? 0xD4 : 0xFB;
+        emit_sse(in, 0x66, 0, op, a->reg, b);
+    } else if (strcmp(m, "vmovdqu") == 0 && count == 2 && a->kind == OPERAND_REG && a->reg_class == REG_YMM) {
+        emit_vex(in, 1, 2, 1, 0, 0, 0x6F, a->reg, b);
+    } else if (strcmp(m, "vmovdqu") == 0 && count == 2 && a->kind == OPERAND_MEM && b->reg_class == REG_YMM) {
+        emit_vex(in, 1, 2, 1, 0, 0, 0x7F, b->reg, a);
+    } else if (strcmp(m, "vmovq") == 0 && count == 2 && a->reg_class == REG_XMM && is_gpr(b)) {
+        emit_vex(in, 1, 1, 0, 1, 0, 0x6E, a->reg, b);
+    } else if (strcmp(m, "vpbroadcastq") == 0 && count == 2 && a->reg_class == REG_YMM &&
+               b->kind == OPERAND_REG && b->reg_class == REG_XMM) {
+        emit_vex(in, 2, 1, 1, 0, 0, 0x59, a->reg, b);
+    } else if ((strcmp(m, "vpaddq") == 0 || strcmp(m, "vpsubq") == 0) && count == 3 &&
+               a->reg_class == REG_YMM && b->kind == OPERAND_REG && b->reg_class == REG_YMM) {
+        emit_vex(in, 1, 1, 1, 0, b->reg, m[2] == 'a' ? 0xD4 : 0xFB, a->reg, &ops[2]);
+    } else {
+        bad_instruction(m);
+    }
+}
+
+// Split "a, b, c" at top-level commas (not inside brackets or quotes)
+static int split_operands(char* text, char** parts, int max) {
+    int count = 0;
+    int depth = 0;
+    int quoted = 0;
+    char* start = text;
+    for (char* p = text;; p++) {
+        if (*p == '"') quoted = !quoted;
+        if (!quoted && *p == '[') depth++;
+        if (!quoted && *p == ']') depth--;
+        if (*p == '\0' || (*p == ',' && !depth && !quoted)) {
+            int end = *p == '\0';
+            *p = '\0';
+            if (*skip_space(start)) {
+                if (count >= max) {
+                    asm_error("too many operands in", text);
+                }
+                parts[count++] = skip_space(start);
+            }
+            if (end) break;
+            start = p + 1;
+        }
+    }
+    return count;
+}
+
+static void assemble_instruction(char* mnemonic, char* rest) {
+    if (current_section != SECTION_TEXT && current_section != SECTION_TEXT_UNLIKELY) {
+        asm_error("instruction outside .text:", mnemonic);
+    }
+    char* parts[MAX_OPERANDS];
+    Operand ops[MAX_OPERANDS];
+    int count = split_operands(rest, parts, MAX_OPERANDS);
+    for (int i = 0; i < count; i++) {
+        parse_operand(parts[i], &ops[i]);
+    }
+
+    Insn in;
+    in.len = 0;
+    in.fixup_pos = -1;
+    encode(&in, mnemonic, ops, count);
+
+    size_t start = obj->sections[current_section].size;
+    section_emit(in.bytes, in.len);
+    if (in.fixup_pos >= 0) {
+        // The CPU adds the field to the address of the next instruction
+        add_reloc(current_section, start + in.fixup_pos, in.fixup_type, in.fixup_symbol,
+                  in.fixup_disp - (in.len - in.fixup_pos));
+    }
+}
+
+static void assemble_db(char* rest) {
+    char* parts[4096];
+    int count = split_operands(rest, parts, 4096);
+    for (int i = 0; i < count; i++) {
+        char* item = parts[i];
+        trim_end(item);
+        int64_t value;
+        if (item[0] == '"') {
+            size_t len = strlen(item);
+            if (len < 2 || item[len - 1] != '"') {
+                asm_error("unterminated string", item);
+            }
+            section_emit(item + 1, len - 2);
+        } else if (parse_number(item, &value)) {
+            uint8_t byte = (uint8_t)value;
+            section_emit(&byte, 1);
+        } else {
+            asm_error("bad db item", item);
+        }
+    }
+}
+
+static void assemble_dq(char* rest) {
+    char* parts[64];
+    int count = split_operands(rest, parts, 64);
+    for (int i = 0; i < count; i++) {
+        char* item = parts[i];
+        trim_end(item);
+        int64_t value = 0;
+        if (!parse_number(item, &value)) {
+            add_reloc(current_section, obj->sections[current_section].size, RELOC_ABS64,
+                      symbol_index(item), 0);
+        }
+        section_emit(&value, 8);
+    }
+}
+
+// global name, or global name:function (end - name) on ELF
+static void assemble_global(char* rest) {
+    char name[MAX_NAME];
+    int len = 0;
+    while (is_name_char(rest[len]) && len < MAX_NAME - 1) {
+        name[len] = rest[len];
+        len++;
+    }
+    name[len] = '\0';
+    int index = symbol_index(name);
+    obj->symbols[index].global = 1;
+
+    char* p = skip_space(rest + len);
+    if (strncmp(p, ":function", 9) != 0) {
+        return;
+    }
+    obj->symbols[index].function = 1;
+    p = strchr(p, '(');
+    if (p) {
+        PendingSize* size = malloc(sizeof(PendingSize));
+        size->symbol = index;
+        sscanf(p + 1, "%255[^ )]", size->end);
+        size->next = pending_sizes;
+        pending_sizes = size;
+    }
+}
+
+// "%line N+0 file" (-g). Only code has lines; a line with no code after it
+// is replaced by the next one.
+static void add_source_line(char* rest) {
+    char* end;
+    long line = strtol(rest, &end, 10);
+    if (end == rest || line <= 0 || strncmp(end, "+0", 2) != 0 || !isspace((unsigned char)end[2])) {
+        asm_error("bad %line directive", rest);
+    }
+    const char* file = skip_space(end + 2);
+    if (!obj->source_file) {
+        obj->source_file = strdup(file);
+    } else if (strcmp(obj->source_file, file) != 0) {
+        asm_error("%line for a second file", file);
+    }
+    if (current_section > SECTION_TEXT_UNLIKELY) {
+        return;
+    }
+    size_t offset = obj->sections[current_section].size;
+    AsmLine* last = obj->line_count ? &obj->lines[obj->line_count - 1] : NULL;
+    if (last && last->section == current_section && last->offset == offset) {
+        last->line = (int)line;
+        return;
+    }
+    if (obj->line_count == obj->line_capacity) {
+        obj->line_capacity = obj->line_capacity ? obj->line_capacity * 2 : 256;
+        obj->lines = realloc(obj->lines, obj->line_capacity * sizeof(AsmLine));
+    }
+    obj->lines[obj->line_count].section = current_section;
+    obj->lines[obj->line_count].offset = offset;
+    obj->lines[obj->line_count].line = (int)line;
+    obj->line_count++;
+}
+
+static int assemble_directive(char* word, char* rest) {
+    int64_t value;
+    if (strcmp(word, "section") == 0) {
+        static const char* names[SECTION_COUNT] = {".text", ".text.unlikely", ".rodata", ".data", ".bss"};
+        // Section attributes after the name are the ones this section has anyway
+        size_t len = strcspn(rest, " \t");
+        for (int i = 0; i < SECTION_COUNT; i++) {
+            if (strlen(names[i]) == len && strncmp(rest, names[i], len) == 0) {
+                current_section = i;
+                return 1;
+            }
+        }
+        asm_error("unknown section", rest);
+    } else if (strcmp(word, "global") == 0) {
+        assemble_global(rest);
+    } else if (strcmp(word, "extern") == 0) {
+        obj->symbols[symbol_index(rest)].global = 1;
+    } else if (strcmp(word, "align") == 0 || strcmp(word, "alignb") == 0) {
+        if (!parse_number(rest, &value) || value <= 0 || (value & (value - 1))) {
+            asm_error("bad alignment", rest);
+        }
+        section_align((int)value);
+    } else if (strcmp(word, "db") == 0) {
+        assemble_db(rest);
+    } else if (strcmp(word, "dq") == 0) {
+        assemble_dq(rest);
+    } else if (strcmp(word, "resq") == 0 || strcmp(word, "resb") == 0) {
+        if (!parse_number(rest, &value) || value < 0) {
+            asm_error("bad reservation", rest);
+        }
+        section_fill((size_t)value * (word[3] == 'q' ? 8 : 1));
+    } else if (strcmp(word, "%line") == 0) {
+        add_source_line(rest);
+    } else if (strcmp(word, "default") == 0) {
+        // rip-relative addressing is the only mode the backend uses
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static void assemble_line(char* line) {
+    // Strip the comment, unless the ';' is inside a string
+    int quoted = 0;
+    for (char* p = line; *p; p++) {
+        if (*p == '"') quoted = !quoted;
+        if (*p == ';' && !quoted) {
+            *p = '\0';
+            break;
+        }
+    }
+    trim_end(line);
+    char* p = skip_space(line);
+    if (!*p) return;
+
+    // Leading "name:" defines a label
+    char* word_end = p;
+    while (*word_end && !isspace((unsigned char)*word_end)) word_end++;
+    if (word_end > p && word_end[-1] == ':' && *p != '%') {
+        word_end[-1] = '\0';
+        define_label(p);
+        p = skip_space(word_end);
+        if (!*p) return;
+        word_end = p;
+        while (*word_end && !isspace((unsigned char)*word_end)) word_end++;
+    }
+
+    char word[MAX_NAME];
+    size_t len = word_end - p;
+    if (len >= sizeof(word)) {
+        asm_error("unknown directive", p);
+    }
+    memcpy(word, p, len);
+    word[len] = '\0';
+    char* rest = skip_space(word_end);
+
+    if (!assemble_directive(word, rest)) {
+        assemble_instruction(word, rest);
+    }
+}
+
+// Patch references that stay within their section; keep the rest for the
+// linker or loader
+static void resolve_fixups(void) {
+    int kept = 0;
+    for (int i = 0; i < obj->reloc_count; i++) {
+        AsmReloc* r = &obj->relocs[i];
+        AsmSymbol* sym = &obj->symbols[r->symbol];
+        if (sym->section < 0 && !sym->global) {
+            line_number = 0;
+            asm_error("undefined symbol", sym->name);
+        }
+        if (r->type != RELOC_ABS64 && sym->section == r->section) {
+            int64_t value = (int64_t)sym->value + r->addend - (int64_t)r->offset;
+            uint8_t* field = obj->sections[r->section].bytes + r->offset;
+            for (int b = 0; b < 4; b++) {
+                field[b] = (uint8_t)((uint64_t)value >> (8 * b));
+            }
+            continue;
+        }
+        obj->relocs[kept++] = *r;
+    }
+    obj->reloc_count = kept;
+
+    while (pending_sizes) {
+        PendingSize* size = pending_sizes;
+        AsmSymbol* sym = &obj->symbols[size->symbol];
+        int end = find_asm_symbol(obj, size->end);
+        if (end >= 0 && obj->symbols[end].section == sym->section && sym->section >= 0) {
+            sym->size = obj->symbols[end].value - sym->value;
+        }
+        pending_sizes = size->next;
+        free(size);
+    }
+}
+
+AsmObject* assemble(const char* source) {
+    obj = calloc(1, sizeof(AsmObject));
+    obj->symbol_capacity = 256;
+    obj->symbols = malloc(obj->symbol_capacity * sizeof(AsmSymbol));
+    obj->reloc_capacity = 256;
+    obj->relocs = malloc(obj->reloc_capacity * sizeof(AsmReloc));
+    obj->bucket_count = 512;
+    obj->buckets = calloc(obj->bucket_count, sizeof(int));
+    obj->sections[SECTION_TEXT].align = 16;
+    obj->sections[SECTION_TEXT_UNLIKELY].align = 16;
+    obj->sections[SECTION_RODATA].align = 8;
+    obj->sections[SECTION_DATA].align = 8;
+    obj->sections[SECTION_BSS].align = 8;
+    current_section = SECTION_TEXT;
+    scope[0] = '\0';
+    line_number = 0;
+    pending_sizes = NULL;
+
+    const char* p = source;
+    char* line = NULL;
+    size_t line_capacity = 0;
+    while (*p) {
+        const char* end = strchr(p, '\n');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len + 1 > line_capacity) {
+            line_capacity = len + 1;
+            line = realloc(line, line_capacity);
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        line_number++;
+        assemble_line(line);
+        p += len + (end ? 1 : 0);
+    }
+    free(line);
+
+    resolve_fixups();
+    return obj;
+}
+
+void free_asm_object(AsmObject* o) {
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        free(o->sections[i].bytes);
+    }
+    for (int i = 0; i < o->symbol_count; i++) {
+        free(o->symbols[i].name);
+    }
+    free(o->symbols);
+    free(o->relocs);
+    free(o->buckets);
+    free(o->lines);
+    free(o->source_file);
+    free(o);
+}
@@ -0,0 +1,79 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sections of an assembled object, in ELF section header order
+typedef enum {
+    SECTION_TEXT,
+    SECTION_TEXT_UNLIKELY,  // Cold code, gathered apart from .text by the linker
+    SECTION_RODATA,
+    SECTION_DATA,
+    SECTION_BSS,
+    SECTION_COUNT
+} AsmSectionId;
+
+typedef struct {
+    uint8_t* bytes;   // Contents; NULL for .bss, which only has a size
+    size_t size;
+    size_t capacity;
+    int align;
+} AsmSection;
+
+typedef enum {
+    RELOC_PC32,   // S + A - P, 32-bit (rip-relative data)
+    RELOC_PLT32,  // Same, for calls and jumps to functions
+    RELOC_ABS64   // S + A, 64-bit (pointers in data)
+} AsmRelocType;
+
+typedef struct {
+    int section;      // Section being patched
+    size_t offset;    // Offset of the field in that section
+    AsmRelocType type;
+    int symbol;       // Index into AsmObject.symbols
+    int64_t addend;
+} AsmReloc;
+
+// "%line N+0 file": code from offset on in section comes from source line N
+typedef struct {
+    int section;
+    size_t offset;
+    int line;
+} AsmLine;
+
+typedef struct {
+    char* name;
+    int section;      // AsmSectionId, or -1 if undefined (extern)
+    size_t value;     // Offset in its section
+    size_t size;      // From "global name:function (end - name)", else 0
+    int global;
+    int function;
+} AsmSymbol;
+
+// Machine code and data with the relocations still to be applied. References
+// within one section are resolved by the assembler; everything else (other
+// sections, externs, absolute pointers) is left to the linker or JIT loader.
+typedef struct {
+    AsmSection sections[SECTION_COUNT];
+    AsmSymbol* symbols;
+    int symbol_count;
+    int symbol_capacity;
+    AsmReloc* relocs;
+    int reloc_count;
+    int reloc_capacity;
+    int* buckets;     // Symbol hash table, indices + 1
+    int bucket_count;
+    AsmLine* lines;   // Source lines in the text sections, in order per section
+    int line_count;
+    int line_capacity;
+    char* source_file;  // File named by the %line directives (-g), else NULL
+} AsmObject;
+
+// Assemble the NASM subset that generate_assembly() writes. Exits with an
+// error on anything outside it.
+AsmObject* assemble(const char* source);
+int find_asm_symbol(AsmObject* obj, const char* name);  // -1 if absent
+void free_asm_object(AsmObject* obj);
+
+#endif // ASSEMBLER_H
@@ -0,0 +1,124 @@
+// Allocation throughput: glibc malloc/free against the Jive pool allocator,
+// both through jive_alloc/jive_free and through the inline fast path that
+// -fpool-alloc emits for constant sizes.
+//
+//   gcc -O2 -I. bench/alloc_bench.c runtime_pool.c runtime.c -o alloc_bench
+//   ./alloc_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "runtime.h"
+
+#define PAIR_COUNT  20000000
+#define BATCH_COUNT 1000000
+#define BATCH_ROUNDS 10
+
+static void* live[BATCH_COUNT];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// What the compiler emits for malloc(constant) and free(p)
+static inline void* inline_alloc(int size_class) {
+    void* obj = jive_pool_heads[size_class];
+    if (__builtin_expect(obj == NULL, 0)) {
+        return jive_pool_refill(size_class);
+    }
+    jive_pool_heads[size_class] = *(void**)obj;
+    return obj;
+}
+
+static inline void inline_free(void* ptr) {
+    if (!ptr) return;
+    long size_class = *(long*)((uintptr_t)ptr & ~(uintptr_t)(JIVE_POOL_SLAB_SIZE - 1));
+    if (size_class >= JIVE_POOL_CLASSES) {
+        jive_free(ptr);
+        return;
+    }
+    *(void**)ptr = jive_pool_heads[size_class];
+    jive_pool_heads[size_class] = ptr;
+}
+
+static long batch_size(int i) {
+    return 16 + ((long)i * 7919 % 15) * 16;  // Mix of the 16..256 byte classes
+}
+
+static void report(const char* name, double seconds, long ops) {
+    printf("  %-22s %8.2f ns/op  %8.1f M ops/s\n", name, seconds * 1e9 / ops, ops / seconds / 1e6);
+}
+
+int main(void) {
+    volatile long sink = 0;
+    double start;
+
+    printf("alloc/free pairs of 32 bytes (%d)\n", PAIR_COUNT);
+    start = now();
+    for (int i = 0; i < PAIR_COUNT; i++) {
+        long* p = malloc(32);
+        p[0] = i;
+        sink += p[0];
+        free(p);
+    }
+    report("glibc malloc/free", now() - start, PAIR_COUNT);
+
+    start = now();
+    for (int i = 0; i < PAIR_COUNT; i++) {
+        long* p = jive_alloc(32);
+        p[0] = i;
+        sink += p[0];
+        jive_free(p);
+    }
+    report("jive_alloc/jive_free", now() - start, PAIR_COUNT);
+
+    int size_class = jive_pool_class(32);
+    start = now();
+    for (int i = 0; i < PAIR_COUNT; i++) {
+        long* p = inline_alloc(size_class);
+        p[0] = i;
+        sink += p[0];
+        inline_free(p);
+    }
+    report("inline fast path", now() - start, PAIR_COUNT);
+
+    long batch_ops = (long)BATCH_COUNT * BATCH_ROUNDS;
+    printf("batches of %d mixed 16..256 byte objects, %d rounds\n", BATCH_COUNT, BATCH_ROUNDS);
+    start = now();
+    for (int round = 0; round < BATCH_ROUNDS; round++) {
+        for (int i = 0; i < BATCH_COUNT; i++) {
+            live[i] = malloc(batch_size(i));
+            *(long*)live[i] = i;
+        }
+        for (int i = 0; i < BATCH_COUNT; i++) {
+            sink += *(long*)live[i];
+            free(live[i]);
+        }
+    }
+    report("glibc malloc/free", now() - start, batch_ops);
+
+    start = now();
+    for (int round = 0; round < BATCH_ROUNDS; round++) {
+        for (int i = 0; i < BATCH_COUNT; i++) {
+            live[i] = jive_alloc(batch_size(i));
+            *(long*)live[i] = i;
+        }
+        for (int i = 0; i < BATCH_COUNT; i++) {
+            sink += *(long*)live[i];
+            jive_free(live[i]);
+        }
+    }
+    report("jive_alloc/jive_free", now() - start, batch_ops);
+
+    // The values written must survive until they are read back
+    long expected = 3 * ((long)PAIR_COUNT * (PAIR_COUNT - 1) / 2) +
+                    2L * BATCH_ROUNDS * ((long)BATCH_COUNT * (BATCH_COUNT - 1) / 2);
+    if (sink != expected) {
+        printf("checksum mismatch\n");
+        return 1;
+    }
+    return 0;
+}
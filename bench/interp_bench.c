@@ -0,0 +1,159 @@
+// Threaded-code interpreter against native code. Each workload is compiled
+// once, then run through --run's in-process JIT and through the interpreter;
+// the table shows the best of a few runs of each and the time to get from
+// IR to something runnable.
+//
+//   gcc -O2 -rdynamic -I. bench/interp_bench.c $(ls *.c | grep -v '^main.c$\|^runtime_freestanding.c$') -ldl -o interp_bench
+//   ./interp_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "inliner.h"
+#include "fold.h"
+#include "escape.h"
+#include "loop_opt.h"
+#include "vectorize.h"
+#include "jit.h"
+#include "interp.h"
+#include "options.h"
+
+#define RUNS 3
+
+CompilerOptions options = {
+    .inline_limit = DEFAULT_INLINE_LIMIT,
+    .tail_calls = 1,
+    .loop_optimize = 1,
+    .stack_alloc = 1,
+    .bounds_check = 1,
+    .vectorize = 1,
+    .block_layout = 1,
+    .slot_reuse = 1,
+};
+
+typedef struct {
+    const char* name;
+    const char* source;
+} Workload;
+
+static const Workload workloads[] = {
+    {"fib(30)",
+     "fn fib(n: int) -> int {\n"
+     "    if (n < 2) { return n; }\n"
+     "    return fib(n - 1) + fib(n - 2);\n"
+     "}\n"
+     "fn main() -> int { return fib(30); }\n"},
+    {"nested loops",
+     "fn main() -> int {\n"
+     "    let s: int = 0;\n"
+     "    let i: int = 0;\n"
+     "    let j: int = 0;\n"
+     "    while (i < 3000) {\n"
+     "        j = 0;\n"
+     "        while (j < 3000) {\n"
+     "            s = s + i * j - j / 3;\n"
+     "            j = j + 1;\n"
+     "        }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return s;\n"
+     "}\n"},
+    {"sieve 2M",
+     "fn main() -> int {\n"
+     "    let n: int = 2000000;\n"
+     "    let composite: array = new_array(n);\n"
+     "    let count: int = 0;\n"
+     "    let i: int = 2;\n"
+     "    while (i < n) {\n"
+     "        if (composite[i] == 0) {\n"
+     "            count = count + 1;\n"
+     "            let j: int = i + i;\n"
+     "            while (j < n) {\n"
+     "                composite[j] = 1;\n"
+     "                j = j + i;\n"
+     "            }\n"
+     "        }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return count;\n"
+     "}\n"},
+    {"collatz 300k",
+     "fn steps(x: int) -> int {\n"
+     "    let n: int = 0;\n"
+     "    while (x != 1) {\n"
+     "        if (x / 2 * 2 == x) { x = x / 2; } else { x = 3 * x + 1; }\n"
+     "        n = n + 1;\n"
+     "    }\n"
+     "    return n;\n"
+     "}\n"
+     "fn main() -> int {\n"
+     "    let total: int = 0;\n"
+     "    let i: int = 1;\n"
+     "    while (i < 300000) {\n"
+     "        total = total + steps(i);\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return total;\n"
+     "}\n"},
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static IRProgram* compile(const char* source) {
+    init_lexer(source);
+    ASTNode* ast = parse_program();
+    cleanup_lexer();
+    inline_functions(ast);
+    fold_constants(ast);
+    stack_allocate(ast);
+    optimize_loops(ast);
+    vectorize_loops(ast);
+    return generate_code(ast);
+}
+
+int main(void) {
+    printf("%-14s %16s %10s %10s %9s %12s %13s\n",
+           "workload", "result", "native ms", "interp ms", "slowdown", "jit load ms", "translate ms");
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        IRProgram* ir = compile(workloads[w].source);
+
+        double start = now();
+        JitFunction native = jit_compile(ir, 0);
+        double load_time = now() - start;
+        start = now();
+        InterpProgram* code = interp_translate(ir);
+        double translate_time = now() - start;
+
+        double native_best = 1e30, interp_best = 1e30;
+        long native_result = 0, interp_result = 0;
+        for (int run = 0; run < RUNS; run++) {
+            start = now();
+            native_result = native();
+            double t = now() - start;
+            if (t < native_best) native_best = t;
+
+            start = now();
+            interp_result = interp_run(code);
+            t = now() - start;
+            if (t < interp_best) interp_best = t;
+        }
+        if (native_result != interp_result) {
+            fprintf(stderr, "%s: native returned %ld, interpreter %ld\n",
+                    workloads[w].name, native_result, interp_result);
+            return 1;
+        }
+        printf("%-14s %16ld %10.2f %10.2f %8.1fx %12.3f %13.3f\n",
+               workloads[w].name, native_result, native_best * 1e3, interp_best * 1e3,
+               interp_best / native_best, load_time * 1e3, translate_time * 1e3);
+        interp_free(code);
+        free_ir_program(ir);
+    }
+    return 0;
+}
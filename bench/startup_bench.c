@@ -0,0 +1,146 @@
+// Process startup latency: a small Jive program linked against libc as
+// usual, and statically against the freestanding runtime. Each binary is
+// spawned many times with its output going to /dev/null; the table shows
+// the wall time from spawn to exit and the size of the stripped binary.
+// Run from the repository root, with gcc on the PATH for linking.
+//
+//   gcc -O2 -rdynamic -I. bench/startup_bench.c $(ls *.c | grep -v '^main.c$\|^runtime_freestanding.c$') -ldl -o startup_bench
+//   ./startup_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "inliner.h"
+#include "fold.h"
+#include "escape.h"
+#include "loop_opt.h"
+#include "vectorize.h"
+#include "stack_machine.h"
+#include "options.h"
+
+#define RUNS 2000
+
+extern char** environ;
+
+CompilerOptions options = {
+    .inline_limit = DEFAULT_INLINE_LIMIT,
+    .tail_calls = 1,
+    .loop_optimize = 1,
+    .stack_alloc = 1,
+    .bounds_check = 1,
+    .vectorize = 1,
+    .block_layout = 1,
+    .slot_reuse = 1,
+};
+
+// Prints, builds a string and allocates an array: enough to touch every
+// part of the runtime a short-lived tool needs
+static const char* source =
+    "fn main() -> int {\n"
+    "    let sb: builder = new_builder();\n"
+    "    append(sb, \"jive \");\n"
+    "    append(sb, 42);\n"
+    "    print(sb);\n"
+    "    let a: array = new_array(100);\n"
+    "    a[7] = 7;\n"
+    "    print(a[7]);\n"
+    "    return 0;\n"
+    "}\n";
+
+typedef struct {
+    const char* name;
+    int freestanding;
+    const char* link;
+} Variant;
+
+static const Variant variants[] = {
+    {"libc, dynamic", 0,
+     "gcc -O2 -nostartfiles -no-pie -s %s runtime.c runtime_pool.c runtime_region.c "
+     "runtime_string.c -o %s"},
+    {"freestanding, static", 1,
+     "gcc -O2 -static -nostdlib -fno-stack-protector -ffunction-sections -fdata-sections "
+     "-Wl,--gc-sections,-z,noseparate-code -s -DJIVE_FREESTANDING %s runtime.c runtime_pool.c "
+     "runtime_region.c runtime_string.c runtime_freestanding.c -o %s"},
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void build(const Variant* v, const char* object, const char* binary) {
+    options.freestanding = v->freestanding;
+    options.pool_alloc = v->freestanding;
+    init_lexer(source);
+    ASTNode* ast = parse_program();
+    cleanup_lexer();
+    inline_functions(ast);
+    fold_constants(ast);
+    stack_allocate(ast);
+    optimize_loops(ast);
+    vectorize_loops(ast);
+    IRProgram* ir = generate_code(ast);
+    generate_object(ir, object);
+    free_ir_program(ir);
+    free_ast(ast);
+
+    char command[1024];
+    snprintf(command, sizeof(command), v->link, object, binary);
+    if (system(command) != 0) {
+        fprintf(stderr, "link failed: %s\n", command);
+        exit(1);
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(void) {
+    static double times[RUNS];
+    posix_spawn_file_actions_t quiet;
+    posix_spawn_file_actions_init(&quiet);
+    posix_spawn_file_actions_addopen(&quiet, 1, "/dev/null", O_WRONLY, 0);
+
+    printf("%-22s %10s %10s %10s %10s\n", "runtime", "bytes", "min us", "median us", "mean us");
+    for (size_t v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+        char object[64], binary[64];
+        snprintf(object, sizeof(object), "/tmp/startup_bench_%zu.o", v);
+        snprintf(binary, sizeof(binary), "/tmp/startup_bench_%zu", v);
+        build(&variants[v], object, binary);
+        struct stat st;
+        stat(binary, &st);
+
+        char* argv[] = {binary, NULL};
+        double total = 0;
+        for (int run = 0; run < RUNS; run++) {
+            double start = now();
+            pid_t pid;
+            int status;
+            if (posix_spawn(&pid, binary, &quiet, NULL, argv, environ) != 0 ||
+                waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "%s: run failed\n", variants[v].name);
+                return 1;
+            }
+            times[run] = now() - start;
+            total += times[run];
+        }
+        qsort(times, RUNS, sizeof(double), compare_doubles);
+        printf("%-22s %10lld %10.1f %10.1f %10.1f\n", variants[v].name, (long long)st.st_size,
+               times[0] * 1e6, times[RUNS / 2] * 1e6, total / RUNS * 1e6);
+        remove(object);
+        remove(binary);
+    }
+    posix_spawn_file_actions_destroy(&quiet);
+    return 0;
+}
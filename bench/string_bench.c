@@ -0,0 +1,85 @@
+// String kernel throughput for each SIMD level the CPU supports, over
+// string lengths from 8 B to 1 MiB. Every kernel is run on its worst case:
+// equal strings for eq, the match in the last position for the searches.
+//
+//   gcc -O2 -I. bench/string_bench.c runtime_string.c runtime.c -o string_bench
+//   ./string_bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "runtime.h"
+
+#define TOTAL_BYTES (64L * 1024 * 1024)  // Work per measurement
+
+static const char* level_names[] = {"scalar", "sse2", "avx2"};
+static const long lengths[] = {8, 64, 512, 4096, 65536, 1048576};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// A Jive string of n bytes: 'a's followed by the given tail
+static char* make_string(long n, const char* tail) {
+    char* str = jive_str_new(n);
+    memset(str, 'a', n);
+    memcpy(str + n - strlen(tail), tail, strlen(tail));
+    str[n] = '\0';
+    jive_str_header(str)->length = n;
+    return str;
+}
+
+int main(void) {
+    int max_level = jive_str_simd_level();
+    long checksum[sizeof(lengths) / sizeof(lengths[0])][4];
+    volatile long sink = 0;
+
+    printf("%-10s %-8s %10s %10s %10s %10s   (GB/s)\n", "length", "isa", "eq", "find_byte", "find", "cstrlen");
+    for (size_t li = 0; li < sizeof(lengths) / sizeof(lengths[0]); li++) {
+        long n = lengths[li];
+        char* a = make_string(n, "z");
+        char* b = make_string(n, "z");
+        char* needle = make_string(4, "abz");
+        long reps = TOTAL_BYTES / n;
+
+        for (int level = JIVE_SIMD_SCALAR; level <= max_level; level++) {
+            jive_str_use_simd(level);
+            double gbps[4];
+            long results[4] = {0, 0, 0, 0};
+            for (int kernel = 0; kernel < 4; kernel++) {
+                double start = now();
+                for (long r = 0; r < reps; r++) {
+                    long result = 0;
+                    switch (kernel) {
+                        case 0: result = jive_str_eq(a, b); break;
+                        case 1: result = jive_str_find_byte(a, 'z'); break;
+                        case 2: result = jive_str_find(a, needle); break;
+                        case 3: result = jive_cstr_len(a + (r & 7)); break;
+                    }
+                    results[kernel] += result;
+                }
+                gbps[kernel] = (double)reps * n / (now() - start) / 1e9;
+                sink += results[kernel];
+            }
+
+            // Every level must agree with the scalar results
+            for (int kernel = 0; kernel < 4; kernel++) {
+                if (level == JIVE_SIMD_SCALAR) {
+                    checksum[li][kernel] = results[kernel];
+                } else if (checksum[li][kernel] != results[kernel]) {
+                    printf("mismatch: length %ld, %s, kernel %d\n", n, level_names[level], kernel);
+                    return 1;
+                }
+            }
+            printf("%-10ld %-8s %10.2f %10.2f %10.2f %10.2f\n", n, level_names[level],
+                   gbps[0], gbps[1], gbps[2], gbps[3]);
+        }
+        jive_str_free(a);
+        jive_str_free(b);
+        jive_str_free(needle);
+    }
+    return sink == 0;
+}
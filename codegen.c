@@ -2,12 +2,39 @@
 #include <stdlib.h>
 #include <string.h>
 #include "codegen.h"
+#include "options.h"
+#include "profile.h"
+#include "slot_alloc.h"
 
 static IRProgram* current_program;
 static Scope* current_scope;
 static Scope* global_scope;
+static ASTNode* program_ast;
 static int label_counter = 0;
 
+// Exit label and result slot of the inlined body being generated, if any
+static char* inline_exit_label = NULL;
+static int inline_result_offset;
+
+// Region blocks open around the statement being generated, and how many of
+// them were already open when the current inlined body started
+static int region_depth = 0;
+static int inline_region_base = 0;
+
+// Whether the program has region blocks; frees then check region ownership
+static int uses_regions = 0;
+
+// Loops around the statement being generated within the current function or
+// inlined body, and cold branches around it (block layout)
+static int loop_depth = 0;
+static int cold_depth = 0;
+
+// Function being generated and the label just past its prologue, which
+// self tail calls jump back to
+static ASTNode* current_function = NULL;
+static const char* site_function;  // Function whose source is being generated
+static char* current_body_label = NULL;
+
 static char* generate_label(const char* prefix) {
     char* label = malloc(32);
     snprintf(label, 32, "%s_%d", prefix, label_counter++);
@@ -18,6 +45,482 @@ static void gen_expression(ASTNode* node);
 static void gen_statement(ASTNode* node);
 static void gen_block(ASTNode* block);
 
+// Name the counter of the instruction just emitted; only -fprofile-generate
+// builds count anything
+static void profile_point(const char* key, const char* suffix) {
+    if (options.profile_generate && key) {
+        set_profile_key(current_program, key, suffix);
+    }
+}
+
+// -fprofile-use: the else branch ran more often than the then branch, so it
+// should be the fall-through path
+static int else_is_hot(ASTNode* node) {
+    if (!options.profile_use || options.profile_generate || !node->else_block) {
+        return 0;
+    }
+    long then_count = profile_count(node->profile_key, "fallthrough");
+    long else_count = profile_count(node->profile_key, "taken");
+    return then_count >= 0 && else_count > then_count;
+}
+
+// Block layout: the branch of an if that is unlikely to run moves to
+// .text.unlikely and the other one falls through
+typedef enum {
+    COLD_NONE,
+    COLD_THEN,
+    COLD_ELSE
+} ColdBranch;
+
+// The block always leaves the function: it ends in a return, or in an if
+// whose branches both do
+static int block_returns(ASTNode* block) {
+    if (!block || block->type != AST_BLOCK || !block->statements) {
+        return 0;
+    }
+    ASTNode* last = block->statements;
+    while (last->right) {
+        last = last->right;
+    }
+    if (last->type == AST_RETURN) {
+        return 1;
+    }
+    if (last->type == AST_IF) {
+        return block_returns(last->then_block) && block_returns(last->else_block);
+    }
+    return last->type == AST_BLOCK && block_returns(last);
+}
+
+static ASTNode* find_function(const char* name);
+
+// Calls the C library's exit or abort, which end the program
+static int calls_exit(ASTNode* node) {
+    if (!node) return 0;
+    if ((node->type == AST_CALL_STMT || node->type == AST_CALL_EXPR) && node->call_name &&
+        (strcmp(node->call_name, "exit") == 0 || strcmp(node->call_name, "abort") == 0) &&
+        !find_function(node->call_name)) {
+        return 1;
+    }
+    return calls_exit(node->left) || calls_exit(node->right) || calls_exit(node->condition) ||
+           calls_exit(node->then_block) || calls_exit(node->else_block) ||
+           calls_exit(node->body) || calls_exit(node->args) || calls_exit(node->next_arg) ||
+           calls_exit(node->statements);
+}
+
+// Static guess: leaving through exit/abort, or returning from inside a loop,
+// happens at most once while the other branch may run every iteration
+static int block_is_exit(ASTNode* block, const char** reason) {
+    if (calls_exit(block)) {
+        *reason = "calls exit";
+        return 1;
+    }
+    if (loop_depth > 0 && block_returns(block)) {
+        *reason = "returns from a loop";
+        return 1;
+    }
+    return 0;
+}
+
+// With counts for the if in the profile, a branch that never ran while the
+// other did is cold. Without them the static guess decides. Instrumented
+// builds keep the plain layout so the branch counters keep their meaning.
+static ColdBranch cold_branch(ASTNode* node, const char** reason) {
+    if (!options.block_layout || options.profile_generate || cold_depth > 0) {
+        return COLD_NONE;
+    }
+    if (options.profile_use) {
+        long then_count = profile_count(node->profile_key, "fallthrough");
+        long else_count = profile_count(node->profile_key, "taken");
+        if (then_count >= 0 && else_count >= 0) {
+            *reason = "never ran in the profile";
+            if (then_count == 0 && else_count > 0) {
+                return COLD_THEN;
+            }
+            if (then_count > 0 && else_count == 0 && node->else_block) {
+                return COLD_ELSE;
+            }
+            return COLD_NONE;
+        }
+    }
+    const char* then_reason;
+    const char* else_reason;
+    int then_exits = block_is_exit(node->then_block, &then_reason);
+    int else_exits = block_is_exit(node->else_block, &else_reason);
+    if (then_exits && !else_exits) {
+        *reason = then_reason;
+        return COLD_THEN;
+    }
+    if (else_exits && !then_exits) {
+        *reason = else_reason;
+        return COLD_ELSE;
+    }
+    return COLD_NONE;
+}
+
+// Loop heads are branch targets on every iteration, so start them on a
+// 16-byte boundary; loops in cold code or that never ran stay unaligned
+static int loop_alignment(ASTNode* node, const char* key_suffix) {
+    if (!options.block_layout || cold_depth > 0 ||
+        (options.profile_use && profile_count(node->profile_key, key_suffix) == 0)) {
+        return 0;
+    }
+    return 16;
+}
+
+// Leaving the function (or inlined body) from inside region blocks releases
+// the regions opened since it started
+static void emit_region_exits(void) {
+    int count = region_depth - (inline_exit_label ? inline_region_base : 0);
+    for (int i = 0; i < count; i++) {
+        emit_ir(current_program, IR_REGION_EXIT, 0, NULL);
+    }
+}
+
+static int has_region(ASTNode* node) {
+    if (!node) return 0;
+    return node->type == AST_REGION || has_region(node->left) || has_region(node->right) ||
+           has_region(node->condition) || has_region(node->then_block) ||
+           has_region(node->else_block) || has_region(node->body) ||
+           has_region(node->body_nodes) || has_region(node->params) ||
+           has_region(node->args) || has_region(node->next_arg) ||
+           has_region(node->statements);
+}
+
+// Evaluate arguments right-to-left so the first argument ends up on top of
+// the stack; the backend pops the first six into rdi..r9 and leaves the rest
+// in System V order for the callee.
+static int gen_args_reversed(ASTNode* arg) {
+    if (!arg) return 0;
+    int count = gen_args_reversed(arg->next_arg);
+    gen_expression(arg);
+    return count + 1;
+}
+
+static int count_args(ASTNode* arg) {
+    int count = 0;
+    while (arg) {
+        count++;
+        arg = arg->next_arg;
+    }
+    return count;
+}
+
+// Inlined call: bind the arguments to the renamed parameters, run the callee
+// body in the caller's frame and leave the result in a dedicated slot
+// (want_result: 1 = push it, 0 = discard it, -1 = return it from the caller)
+static void gen_inline(ASTNode* node, int want_result) {
+    ASTNode* bind = node->params;
+    while (bind) {
+        gen_statement(bind);
+        bind = bind->right;
+    }
+    
+    const char* saved_site_function = site_function;
+    site_function = node->call_name;
+    
+    if (want_result < 0) {
+        // return f(...) with f inlined: the callee's returns are our returns,
+        // so calls it makes in return position stay tail calls
+        gen_block(node->body);
+        site_function = saved_site_function;
+        emit_ir(current_program, IR_PUSH, 0, NULL);
+        emit_region_exits();
+        emit_ir(current_program, IR_RET, 0, NULL);
+        return;
+    }
+    
+    char result_name[48];
+    snprintf(result_name, sizeof(result_name), "%s.ret%d", node->call_name, label_counter);
+    Symbol* result = declare_var(current_scope, result_name, SYM_VAR);
+    result->value_type = node->int_value;
+    
+    char* saved_label = inline_exit_label;
+    int saved_offset = inline_result_offset;
+    int saved_region_base = inline_region_base;
+    int saved_loop_depth = loop_depth;
+    inline_exit_label = generate_label("inline_end");
+    inline_result_offset = result->offset;
+    inline_region_base = region_depth;
+    loop_depth = 0;  // Its returns only leave the inlined body
+    
+    gen_block(node->body);
+    site_function = saved_site_function;
+    loop_depth = saved_loop_depth;
+    
+    // Falling off the end returns 0, like a real call
+    emit_ir(current_program, IR_PUSH, 0, NULL);
+    emit_ir(current_program, IR_STORE, result->offset, NULL);
+    emit_ir(current_program, IR_LABEL, 0, inline_exit_label);
+    
+    free(inline_exit_label);
+    inline_exit_label = saved_label;
+    inline_result_offset = saved_offset;
+    inline_region_base = saved_region_base;
+    
+    if (want_result) {
+        emit_ir(current_program, IR_LOAD, result->offset, NULL);
+    }
+}
+
+static ASTNode* find_function(const char* name) {
+    ASTNode* stmt = program_ast ? program_ast->statements : NULL;
+    while (stmt) {
+        if (stmt->type == AST_FN_DEF && strcmp(stmt->fn_name, name) == 0) {
+            return stmt;
+        }
+        stmt = stmt->right;
+    }
+    return NULL;
+}
+
+// String, builder and array builtins, called like functions. A Jive function
+// with the same name takes precedence. len reads the header inline; the
+// others call the runtime (runtime.c, runtime_string.c).
+typedef struct {
+    const char* name;
+    const char* runtime;      // NULL: generated inline
+    const char* int_runtime;  // Variant used when the last argument is an int
+    int arg_count;
+    ValueType result_type;
+} Builtin;
+
+static const Builtin builtins[] = {
+    {"len",         NULL,                   NULL,                  1, TYPE_INT},
+    {"concat",      "jive_str_concat",      NULL,                  2, TYPE_STRING},
+    {"substr",      "jive_str_substr",      NULL,                  3, TYPE_STRING},
+    {"eq",          "jive_str_eq",          NULL,                  2, TYPE_INT},
+    {"starts_with", "jive_str_starts_with", NULL,                  2, TYPE_INT},
+    {"find",        "jive_str_find",        NULL,                  2, TYPE_INT},
+    {"find_byte",   "jive_str_find_byte",   NULL,                  2, TYPE_INT},
+    {"cstrlen",     "jive_cstr_len",        NULL,                  1, TYPE_INT},
+    {"from_cstr",   "jive_str_from_cstr",   NULL,                  1, TYPE_STRING},
+    {"new_builder", "jive_sb_new",          NULL,                  0, TYPE_BUILDER},
+    {"append",      "jive_sb_append_str",   "jive_sb_append_int",  2, TYPE_BUILDER},
+    {"finish",      "jive_sb_finish",       NULL,                  1, TYPE_STRING},
+    {"new_array",   "jive_array_new",       NULL,                  1, TYPE_ARRAY},
+    {NULL, NULL, NULL, 0, TYPE_INT}
+};
+
+static const Builtin* find_builtin(const char* name) {
+    if (find_function(name)) {
+        return NULL;
+    }
+    for (int i = 0; builtins[i].name; i++) {
+        if (strcmp(builtins[i].name, name) == 0) {
+            return &builtins[i];
+        }
+    }
+    return NULL;
+}
+
+// Static type of an expression. Only literals, variables and calls carry a
+// type other than int.
+static ValueType expr_type(ASTNode* node) {
+    switch (node->type) {
+        case AST_STRING_LIT:
+            return TYPE_STRING;
+        case AST_VAR: {
+            Symbol* sym = lookup(current_scope, node->var_name);
+            return sym ? (ValueType)sym->value_type : TYPE_INT;
+        }
+        case AST_CALL_EXPR: {
+            const Builtin* builtin = find_builtin(node->call_name);
+            if (builtin) {
+                return builtin->result_type;
+            }
+            ASTNode* fn = find_function(node->call_name);
+            return fn ? (ValueType)fn->int_value : TYPE_INT;
+        }
+        case AST_INLINE:
+            return (ValueType)node->int_value;
+        case AST_BINOP:
+            // + with a string on either side concatenates
+            if (node->binop == BINOP_PLUS &&
+                (expr_type(node->left) == TYPE_STRING || expr_type(node->right) == TYPE_STRING)) {
+                return TYPE_STRING;
+            }
+            return TYPE_INT;
+        default:
+            return TYPE_INT;
+    }
+}
+
+// "function:line" of a malloc or free for the heap profiler, NULL when not
+// profiling. Inlined code is attributed to the function it was written in.
+static const char* heap_site(ASTNode* node) {
+    static char site[160];
+    if (!options.heap_profile) {
+        return NULL;
+    }
+    snprintf(site, sizeof(site), "%s:%d", site_function, node->line);
+    return site;
+}
+
+// Under --heap-profile, the runtime call emitted next allocates or frees on
+// behalf of node's line. Emitted after the arguments, whose own calls would
+// overwrite it.
+static void heap_site_for_call(ASTNode* node) {
+    const char* site = heap_site(node);
+    if (site) {
+        emit_ir(current_program, IR_HEAP_SITE, 0, site);
+    }
+}
+
+// s + t at run time, into a new string like concat(s, t). An int operand
+// contributes its decimal text, the same result fold.c gives for literals.
+static void gen_string_concat(ASTNode* node) {
+    ValueType left = expr_type(node->left);
+    ValueType right = expr_type(node->right);
+    const char* label = "_jive_str_concat";
+    if (left == TYPE_INT) {
+        label = "_jive_int_concat_str";
+    } else if (right == TYPE_INT) {
+        label = "_jive_str_concat_int";
+    } else if (left != TYPE_STRING || right != TYPE_STRING) {
+        fprintf(stderr, "Error: + can only join a string with a string or an int\n");
+        exit(1);
+    }
+    emit_ir(current_program, IR_ARGS, 2, NULL);
+    gen_expression(node->right);
+    gen_expression(node->left);
+    heap_site_for_call(node);
+    emit_ir(current_program, IR_CALL, 2, label);
+}
+
+// Statement-level call of a one-argument runtime routine, result discarded.
+// site is the node to record it under when it allocates or frees, else NULL.
+static void gen_runtime_call(const char* label, ASTNode* arg, ASTNode* site) {
+    emit_ir(current_program, IR_ARGS, 1, NULL);
+    gen_expression(arg);
+    if (site) {
+        heap_site_for_call(site);
+    }
+    emit_ir(current_program, IR_CALL, 1, label);
+    emit_ir(current_program, IR_POP, 0, NULL);
+}
+
+static int count_params(ASTNode* param) {
+    int count = 0;
+    while (param) {
+        count++;
+        param = param->right;
+    }
+    return count;
+}
+
+static int is_self_tail_call(ASTNode* ret) {
+    ASTNode* call = ret->left;
+    return options.tail_calls && call && call->type == AST_CALL_EXPR && current_function &&
+           strcmp(call->call_name, current_function->fn_name) == 0 &&
+           count_args(call->args) == count_params(current_function->params);
+}
+
+static int has_self_tail_call(ASTNode* node) {
+    if (!node) return 0;
+    if (node->type == AST_RETURN && is_self_tail_call(node)) return 1;
+    if (node->type == AST_RETURN && node->left && node->left->type == AST_INLINE &&
+        has_self_tail_call(node->left->body)) return 1;
+    return has_self_tail_call(node->statements) || has_self_tail_call(node->right) ||
+           has_self_tail_call(node->then_block) || has_self_tail_call(node->else_block) ||
+           has_self_tail_call(node->body);
+}
+
+// return f(...) in tail position. Self recursion overwrites the parameters
+// and loops back to the top of the body; a sibling call with register-only
+// arguments tears down the frame and jumps to the callee.
+static int gen_tail_call(ASTNode* ret) {
+    ASTNode* call = ret->left;
+    // Inside a region the regions must be released after the call returns
+    if (!options.tail_calls || inline_exit_label || region_depth > 0 || !call ||
+        call->type != AST_CALL_EXPR || find_builtin(call->call_name)) {
+        return 0;
+    }
+
+    if (is_self_tail_call(ret)) {
+        // Evaluate every argument before overwriting any parameter
+        gen_args_reversed(call->args);
+        ASTNode* param = current_function->params;
+        while (param) {
+            Symbol* sym = lookup(current_scope, param->var_name);
+            emit_ir(current_program, IR_STORE, sym->offset, NULL);
+            param = param->right;
+        }
+        emit_ir(current_program, IR_JMP, 0, current_body_label);
+        return 1;
+    }
+
+    int arg_count = count_args(call->args);
+    if (arg_count > MAX_REG_PARAMS) {
+        // Stack arguments would have to overwrite our caller's frame
+        return 0;
+    }
+    gen_args_reversed(call->args);
+    char* label = malloc(strlen(call->call_name) + 2);
+    sprintf(label, "_%s", call->call_name);
+    emit_ir(current_program, IR_TAILCALL, arg_count, label);
+    profile_point(call->profile_key, NULL);
+    free(label);
+    return 1;
+}
+
+static void gen_call(ASTNode* node) {
+    int arg_count = count_args(node->args);
+    const char* name = node->call_name;
+    const Builtin* builtin = find_builtin(name);
+    if (builtin) {
+        if (arg_count != builtin->arg_count) {
+            fprintf(stderr, "Error: %s expects %d argument(s), got %d\n",
+                    builtin->name, builtin->arg_count, arg_count);
+            exit(1);
+        }
+        if (!builtin->runtime) {
+            gen_expression(node->args);
+            emit_ir(current_program, IR_STR_LEN, 0, NULL);
+            return;
+        }
+        name = builtin->runtime;
+        if (builtin->int_runtime) {
+            ASTNode* last = node->args;
+            while (last->next_arg) last = last->next_arg;
+            if (expr_type(last) == TYPE_INT) {
+                name = builtin->int_runtime;
+            }
+        }
+    }
+    
+    emit_ir(current_program, IR_ARGS, arg_count, NULL);
+    gen_args_reversed(node->args);
+    // Builtins returning a string, builder or array allocate (append may
+    // grow its builder)
+    if (builtin && builtin->result_type != TYPE_INT) {
+        heap_site_for_call(node);
+    }
+    
+    char* label = malloc(strlen(name) + 2);
+    sprintf(label, "_%s", name);
+    emit_ir(current_program, IR_CALL, arg_count, label);
+    profile_point(node->profile_key, NULL);
+    free(label);
+}
+
+// Push the base pointer and the index of a[i]. Any variable can be indexed;
+// int variables act as raw pointers to 8-byte elements.
+static void gen_element_address(ASTNode* node, ASTNode* index) {
+    Symbol* sym = lookup(current_scope, node->var_name);
+    if (!sym) {
+        fprintf(stderr, "Error: undefined variable '%s'\n", node->var_name);
+        exit(1);
+    }
+    emit_ir(current_program, IR_LOAD, sym->offset, NULL);
+    gen_expression(index);
+}
+
+// Only arrays know their length; loop_opt marks indices it proved in range
+static int needs_bounds_check(ASTNode* node) {
+    Symbol* sym = lookup(current_scope, node->var_name);
+    return options.bounds_check && sym->value_type == TYPE_ARRAY && !node->int_value;
+}
+
 static void gen_expression(ASTNode* node) {
     if (!node) return;
     
@@ -30,11 +533,25 @@ static void gen_expression(ASTNode* node) {
             emit_ir_str(current_program, IR_PUSH_STR, node->string_value);
             break;
             
-        case AST_MALLOC:
-            gen_expression(node->left);  // Size argument
-            emit_ir(current_program, IR_MALLOC, 0, NULL);
+        case AST_MALLOC: {
+            // Constant sizes travel in the operand so the backend can pick
+            // a pool size class or inline the bump at compile time
+            IROp op = node->int_value ? IR_REGION_ALLOC : IR_MALLOC;
+            const char* site = op == IR_MALLOC ? heap_site(node) : NULL;
+            if (node->left->type == AST_INT_LIT && node->left->int_value >= 0) {
+                emit_ir(current_program, op, node->left->int_value, site);
+            } else {
+                gen_expression(node->left);  // Size argument
+                emit_ir(current_program, op, -1, site);
+            }
             break;
-            
+        }
+
+        case AST_STACK_ALLOC:
+            emit_ir(current_program, IR_FRAME_ADDR,
+                    reserve_stack(current_scope, node->int_value), NULL);
+            break;
+
         case AST_VAR: {
             Symbol* sym = lookup(current_scope, node->var_name);
             if (!sym) {
@@ -45,7 +562,34 @@ static void gen_expression(ASTNode* node) {
             break;
         }
         
+        case AST_INDEX:
+            gen_element_address(node, node->left);
+            emit_ir(current_program, IR_INDEX_LOAD, needs_bounds_check(node), NULL);
+            break;
+        
         case AST_BINOP:
+            if (node->binop == BINOP_PLUS && expr_type(node) == TYPE_STRING) {
+                gen_string_concat(node);
+                break;
+            }
+            // Multiplication/division by a literal is lowered to shifts, lea
+            // and magic-number multiplies by the backend
+            if (node->binop == BINOP_MULT && node->left->type == AST_INT_LIT) {
+                gen_expression(node->right);
+                emit_ir(current_program, IR_MULI, node->left->int_value, NULL);
+                break;
+            }
+            if (node->binop == BINOP_MULT && node->right->type == AST_INT_LIT) {
+                gen_expression(node->left);
+                emit_ir(current_program, IR_MULI, node->right->int_value, NULL);
+                break;
+            }
+            if (node->binop == BINOP_DIV && node->right->type == AST_INT_LIT &&
+                node->right->int_value != 0) {
+                gen_expression(node->left);
+                emit_ir(current_program, IR_DIVI, node->right->int_value, NULL);
+                break;
+            }
             gen_expression(node->left);
             gen_expression(node->right);
             switch (node->binop) {
@@ -71,25 +615,14 @@ static void gen_expression(ASTNode* node) {
             emit_ir(current_program, IR_CMP, node->compare_op, NULL);
             break;
             
-        case AST_CALL_EXPR: {
-            // Push arguments right-to-left (or left-to-right, depending on convention)
-            ASTNode* arg = node->args;
-            int arg_count = 0;
-            while (arg) {
-                gen_expression(arg);
-                arg = arg->right;
-                arg_count++;
-            }
-            
-            // Call function
-            char* label = malloc(strlen(node->call_name) + 2);
-            sprintf(label, "_%s", node->call_name);
-            emit_ir(current_program, IR_CALL, arg_count, label);
-            free(label);
-            
+        case AST_CALL_EXPR:
             // Result is on stack
+            gen_call(node);
+            break;
+            
+        case AST_INLINE:
+            gen_inline(node, 1);
             break;
-        }
         
         default:
             fprintf(stderr, "Error: unexpected node type in expression: %d\n", node->type);
@@ -97,8 +630,146 @@ static void gen_expression(ASTNode* node) {
     }
 }
 
+// Vector value of an element-wise expression from the vectorizer: a[i] loads
+// a vector, literals and invariants are broadcast
+static void gen_vector_expression(ASTNode* node, int lanes) {
+    switch (node->type) {
+        case AST_INDEX:
+            gen_element_address(node, node->left);
+            emit_ir(current_program, IR_VEC_LOAD, lanes, NULL);
+            break;
+        case AST_BINOP:
+            gen_vector_expression(node->left, lanes);
+            gen_vector_expression(node->right, lanes);
+            emit_ir(current_program, node->binop == BINOP_PLUS ? IR_VEC_ADD : IR_VEC_SUB, lanes, NULL);
+            break;
+        default:
+            gen_expression(node);
+            emit_ir(current_program, IR_VEC_SPLAT, lanes, NULL);
+            break;
+    }
+}
+
+// Lower the last vector start in end to len(array) - lanes for each checked
+// array the store touches; returns how many there are
+static int gen_vector_clamp(ASTNode* node, Symbol* end, int lanes) {
+    int count = 0;
+    if ((node->type == AST_INDEX || node->type == AST_INDEX_ASSIGN) && needs_bounds_check(node)) {
+        Symbol* array = lookup(current_scope, node->var_name);
+        char* skip_label = generate_label("vecclamp");
+        emit_ir(current_program, IR_LOAD, array->offset, NULL);
+        emit_ir(current_program, IR_STR_LEN, 0, NULL);
+        emit_ir(current_program, IR_PUSH, lanes, NULL);
+        emit_ir(current_program, IR_SUB, 0, NULL);
+        emit_ir(current_program, IR_LOAD, end->offset, NULL);
+        emit_ir(current_program, IR_CMP, COMPARE_LT, NULL);
+        emit_ir(current_program, IR_JZ, 0, skip_label);
+        emit_ir(current_program, IR_LOAD, array->offset, NULL);
+        emit_ir(current_program, IR_STR_LEN, 0, NULL);
+        emit_ir(current_program, IR_PUSH, lanes, NULL);
+        emit_ir(current_program, IR_SUB, 0, NULL);
+        emit_ir(current_program, IR_STORE, end->offset, NULL);
+        emit_ir(current_program, IR_LABEL, 0, skip_label);
+        free(skip_label);
+        count++;
+    }
+    if (node->type == AST_BINOP) {
+        count += gen_vector_clamp(node->left, end, lanes);
+        count += gen_vector_clamp(node->right, end, lanes);
+    } else if (node->type == AST_INDEX_ASSIGN) {
+        count += gen_vector_clamp(node->left, end, lanes);
+    }
+    return count;
+}
+
+// Runs while i + lanes <= limit and every checked array has i + lanes
+// elements, leaving the rest of the iterations (and any bounds error) to
+// the scalar loop that follows. The limit and the array lengths are
+// invariant, so the last vector start is computed once up front.
+static void gen_vector_loop(ASTNode* node) {
+    int lanes = node->int_value;
+    Symbol* iv = lookup(current_scope, node->var_name);
+    if (!iv) {
+        fprintf(stderr, "Error: undefined variable '%s'\n", node->var_name);
+        exit(1);
+    }
+    char* loop_label = generate_label("vecloop");
+    char* end_label = generate_label("endvec");
+    char end_name[32];
+    snprintf(end_name, sizeof(end_name), "vec.end%d", label_counter);
+    Symbol* end = declare_var(current_scope, end_name, SYM_VAR);
+
+    for (ASTNode* check = node->params; check; check = check->next_arg) {
+        gen_expression(check->left);
+        gen_expression(check->right);
+        emit_ir(current_program, IR_VEC_ALIAS, lanes * 8, NULL);
+        emit_ir(current_program, IR_JZ, 0, end_label);
+    }
+
+    gen_expression(node->left);
+    emit_ir(current_program, IR_PUSH, lanes, NULL);
+    emit_ir(current_program, IR_SUB, 0, NULL);
+    emit_ir(current_program, IR_STORE, end->offset, NULL);
+    int checked = 0;
+    for (ASTNode* stmt = node->statements; stmt; stmt = stmt->right) {
+        checked += gen_vector_clamp(stmt, end, lanes);
+    }
+    if (checked) {
+        // A negative start goes to the scalar loop, which reports it
+        emit_ir(current_program, IR_LOAD, iv->offset, NULL);
+        emit_ir(current_program, IR_PUSH, 0, NULL);
+        emit_ir(current_program, IR_CMP, COMPARE_GE, NULL);
+        emit_ir(current_program, IR_JZ, 0, end_label);
+    }
+
+    emit_ir(current_program, IR_LABEL, loop_alignment(node, NULL), loop_label);
+    emit_ir(current_program, IR_LOAD, iv->offset, NULL);
+    emit_ir(current_program, IR_LOAD, end->offset, NULL);
+    emit_ir(current_program, IR_CMP, COMPARE_LE, NULL);
+    emit_ir(current_program, IR_JZ, 0, end_label);
+    for (ASTNode* stmt = node->statements; stmt; stmt = stmt->right) {
+        gen_element_address(stmt, stmt->condition);
+        gen_vector_expression(stmt->left, lanes);
+        emit_ir(current_program, IR_VEC_STORE, lanes, NULL);
+    }
+    emit_ir(current_program, IR_LOAD, iv->offset, NULL);
+    emit_ir(current_program, IR_PUSH, lanes, NULL);
+    emit_ir(current_program, IR_ADD, 0, NULL);
+    emit_ir(current_program, IR_STORE, iv->offset, NULL);
+    emit_ir(current_program, IR_JMP, 0, loop_label);
+    emit_ir(current_program, IR_LABEL, 0, end_label);
+    emit_ir(current_program, IR_VEC_END, lanes, NULL);
+
+    free(loop_label);
+    free(end_label);
+}
+
+// if with a cold branch: the condition jumps to it, the hot branch falls
+// through, and the cold one is emitted between COLD_BEGIN and COLD_END, which
+// the backend moves to .text.unlikely
+static void gen_split_if(ASTNode* node, ColdBranch cold) {
+    char* cold_label = generate_label("cold");
+    char* end_label = generate_label("endif");
+    gen_expression(node->condition);
+    emit_ir(current_program, cold == COLD_THEN ? IR_JNZ : IR_JZ, 0, cold_label);
+    gen_block(cold == COLD_THEN ? node->else_block : node->then_block);
+    emit_ir(current_program, IR_COLD_BEGIN, 0, NULL);
+    cold_depth++;
+    emit_ir(current_program, IR_LABEL, 0, cold_label);
+    gen_block(cold == COLD_THEN ? node->then_block : node->else_block);
+    emit_ir(current_program, IR_JMP, 0, end_label);
+    cold_depth--;
+    emit_ir(current_program, IR_COLD_END, 0, NULL);
+    emit_ir(current_program, IR_LABEL, 0, end_label);
+    free(cold_label);
+    free(end_label);
+}
+
 static void gen_statement(ASTNode* node) {
     if (!node) return;
+    if (node->line) {
+        ir_set_line(node->line);
+    }
     
     switch (node->type) {
         case AST_VAR_DECL:
@@ -109,6 +780,7 @@ static void gen_statement(ASTNode* node) {
                 if (!sym) {
                     sym = declare_var(current_scope, node->var_name, SYM_VAR);
                 }
+                sym->value_type = node->int_value;
                 emit_ir(current_program, IR_STORE, sym->offset, NULL);
             }
             break;
@@ -125,32 +797,70 @@ static void gen_statement(ASTNode* node) {
             }
             break;
             
-        case AST_RETURN:
+        case AST_INDEX_ASSIGN:
+            gen_element_address(node, node->condition);
             gen_expression(node->left);
-            emit_ir(current_program, IR_RET, 0, NULL);
+            emit_ir(current_program, IR_INDEX_STORE, needs_bounds_check(node), NULL);
             break;
             
-        case AST_CALL_STMT: {
-            // Generate function call
-            ASTNode* arg = node->args;
-            int arg_count = 0;
-            while (arg) {
-                gen_expression(arg);
-                arg = arg->right;
-                arg_count++;
+        case AST_RETURN:
+            if (gen_tail_call(node)) {
+                break;
             }
+            if (node->left && node->left->type == AST_INLINE && !inline_exit_label) {
+                gen_inline(node->left, -1);
+                break;
+            }
+            gen_expression(node->left);
+            emit_region_exits();
+            if (inline_exit_label) {
+                // Return from an inlined body: store the result and leave the body
+                emit_ir(current_program, IR_STORE, inline_result_offset, NULL);
+                emit_ir(current_program, IR_JMP, 0, inline_exit_label);
+            } else {
+                emit_ir(current_program, IR_RET, 0, NULL);
+            }
+            break;
             
-            char* label = malloc(strlen(node->call_name) + 2);
-            sprintf(label, "_%s", node->call_name);
-            emit_ir(current_program, IR_CALL, arg_count, label);
-            free(label);
-            
+        case AST_CALL_STMT:
+            gen_call(node);
             // Discard return value
             emit_ir(current_program, IR_POP, 0, NULL);
             break;
-        }
+            
+        case AST_INLINE:
+            gen_inline(node, 0);
+            break;
             
         case AST_IF: {
+            const char* reason;
+            ColdBranch cold = cold_branch(node, &reason);
+            if (cold != COLD_NONE) {
+                if (options.layout_report) {
+                    printf("layout: %s: line %d: %s branch moved to .text.unlikely (%s)\n",
+                           current_function ? current_function->fn_name : "<top level>", node->line,
+                           cold == COLD_THEN ? "then" : "else", reason);
+                }
+                gen_split_if(node, cold);
+                break;
+            }
+            if (else_is_hot(node)) {
+                // Profiled layout: the hot else branch falls through and the
+                // then branch moves below it
+                char* then_label = generate_label("then");
+                char* end_label = generate_label("endif");
+                gen_expression(node->condition);
+                emit_ir(current_program, IR_JNZ, 0, then_label);
+                gen_block(node->else_block);
+                emit_ir(current_program, IR_JMP, 0, end_label);
+                emit_ir(current_program, IR_LABEL, 0, then_label);
+                gen_block(node->then_block);
+                emit_ir(current_program, IR_LABEL, 0, end_label);
+                free(then_label);
+                free(end_label);
+                break;
+            }
+            
             char* else_label = generate_label("else");
             char* end_label = generate_label("endif");
             
@@ -159,6 +869,7 @@ static void gen_statement(ASTNode* node) {
             
             // Jump to else if condition is false (zero)
             emit_ir(current_program, IR_JZ, 0, else_label);
+            profile_point(node->profile_key, NULL);
             
             // Generate then block
             gen_block(node->then_block);
@@ -171,11 +882,14 @@ static void gen_statement(ASTNode* node) {
             // Else block label
             if (node->else_block) {
                 emit_ir(current_program, IR_LABEL, 0, else_label);
+                profile_point(node->profile_key, "else");
                 gen_block(node->else_block);
                 emit_ir(current_program, IR_LABEL, 0, end_label);
+                profile_point(node->profile_key, "end");
                 free(end_label);
             } else {
                 emit_ir(current_program, IR_LABEL, 0, else_label);
+                profile_point(node->profile_key, "end");
             }
             
             free(else_label);
@@ -186,23 +900,50 @@ static void gen_statement(ASTNode* node) {
             char* loop_label = generate_label("loop");
             char* end_label = generate_label("endloop");
             
+            if (options.loop_optimize) {
+                // Rotated loop: test once on entry, then at the bottom so each
+                // iteration takes a single conditional branch
+                gen_expression(node->condition);
+                emit_ir(current_program, IR_JZ, 0, end_label);
+                profile_point(node->profile_key, "enter");
+                emit_ir(current_program, IR_LABEL, loop_alignment(node, "body"), loop_label);
+                profile_point(node->profile_key, "body");
+                loop_depth++;
+                gen_block(node->body);
+                loop_depth--;
+                gen_expression(node->condition);
+                emit_ir(current_program, IR_JNZ, 0, loop_label);
+                profile_point(node->profile_key, "latch");
+                emit_ir(current_program, IR_LABEL, 0, end_label);
+                profile_point(node->profile_key, "exit");
+                
+                free(loop_label);
+                free(end_label);
+                break;
+            }
+            
             // Loop start label
-            emit_ir(current_program, IR_LABEL, 0, loop_label);
+            emit_ir(current_program, IR_LABEL, loop_alignment(node, "head"), loop_label);
+            profile_point(node->profile_key, "head");
             
             // Generate condition
             gen_expression(node->condition);
             
             // Jump to end if condition is false
             emit_ir(current_program, IR_JZ, 0, end_label);
+            profile_point(node->profile_key, "test");
             
             // Generate body
+            loop_depth++;
             gen_block(node->body);
+            loop_depth--;
             
             // Jump back to loop start
             emit_ir(current_program, IR_JMP, 0, loop_label);
             
             // End label
             emit_ir(current_program, IR_LABEL, 0, end_label);
+            profile_point(node->profile_key, "exit");
             
             free(loop_label);
             free(end_label);
@@ -214,13 +955,50 @@ static void gen_statement(ASTNode* node) {
             break;
             
         case AST_PRINT:
+            // Pick the formatter from the static type; no runtime check
+            if (expr_type(node->left) == TYPE_BUILDER) {
+                // Copies the builder's contents into the print buffer and empties it
+                gen_runtime_call("_jive_sb_print", node->left, NULL);
+                break;
+            }
             gen_expression(node->left);
-            emit_ir(current_program, IR_PRINT, 0, NULL);
+            if (node->left->type == AST_STRING_LIT) {
+                emit_ir(current_program, IR_PRINT_STR, (int)strlen(node->left->string_value), NULL);
+            } else if (expr_type(node->left) == TYPE_STRING) {
+                emit_ir(current_program, IR_PRINT_STR, -1, NULL);
+            } else {
+                emit_ir(current_program, IR_PRINT_INT, 0, NULL);
+            }
             break;
             
         case AST_FREE:
+            if (expr_type(node->left) == TYPE_STRING) {
+                // Runtime strings start below the pointer, at their header
+                gen_runtime_call("_jive_str_free", node->left, node);
+                break;
+            }
+            if (expr_type(node->left) == TYPE_BUILDER) {
+                gen_runtime_call("_jive_sb_free", node->left, node);
+                break;
+            }
+            if (expr_type(node->left) == TYPE_ARRAY) {
+                gen_runtime_call("_jive_array_free", node->left, node);
+                break;
+            }
             gen_expression(node->left);
-            emit_ir(current_program, IR_FREE, 0, NULL);
+            emit_ir(current_program, IR_FREE, uses_regions, heap_site(node));
+            break;
+            
+        case AST_VECTOR_LOOP:
+            gen_vector_loop(node);
+            break;
+            
+        case AST_REGION:
+            emit_ir(current_program, IR_REGION_ENTER, 0, NULL);
+            region_depth++;
+            gen_block(node->body);
+            region_depth--;
+            emit_ir(current_program, IR_REGION_EXIT, 0, NULL);
             break;
             
         default:
@@ -242,6 +1020,9 @@ static void gen_block(ASTNode* block) {
 IRProgram* generate_code(ASTNode* ast) {
     current_program = create_ir_program();
     label_counter = 0;
+    ir_set_line(0);
+    program_ast = ast;
+    uses_regions = has_region(ast);
     
     // Create global scope
     global_scope = create_scope(NULL);
@@ -262,24 +1043,65 @@ IRProgram* generate_code(ASTNode* ast) {
             // Declare parameters
             ASTNode* param = stmt->params;
             while (param) {
-                declare_param(current_scope, param->var_name);
+                Symbol* sym = declare_param(current_scope, param->var_name);
+                sym->value_type = param->int_value;
                 param = param->right;
             }
             
             // Function label
+            ir_set_line(stmt->line);
             char* fn_label = malloc(strlen(stmt->fn_name) + 2);
             sprintf(fn_label, "_%s", stmt->fn_name);
             emit_ir(current_program, IR_LABEL, 0, fn_label);
+            IRInstruction* fn_start = current_program->tail;
+            profile_point(stmt->profile_key, "entry");
             free(fn_label);
             
+            // Prologue; the frame size is patched once the body is generated
+            emit_ir(current_program, IR_ENTER, 0, NULL);
+            IRInstruction* enter = current_program->tail;
+            
+            // Spill register parameters into their local slots
+            Symbol* sym;
+            param = stmt->params;
+            for (int i = 0; param && i < MAX_REG_PARAMS; i++) {
+                sym = lookup(current_scope, param->var_name);
+                emit_ir(current_program, IR_PARAM, sym->offset, NULL);
+                param = param->right;
+            }
+            
+            current_function = stmt;
+            site_function = stmt->fn_name;
+            current_body_label = NULL;
+            if (has_self_tail_call(stmt->body_nodes)) {
+                current_body_label = generate_label("body");
+                emit_ir(current_program, IR_LABEL, 0, current_body_label);
+            }
+            
             // Generate function body
             if (stmt->body_nodes) {
                 gen_block(stmt->body_nodes);
             }
             
-            // If no return statement, add implicit return
+            // If no return statement, add implicit return 0
+            emit_ir(current_program, IR_PUSH, 0, NULL);
             emit_ir(current_program, IR_RET, 0, NULL);
             
+            int slots = current_scope->local_count;
+            if (options.slot_reuse) {
+                slots = allocate_slots(fn_start, slots);
+            }
+            if (options.frame_report) {
+                // Frame bytes as the prologue reserves them, rounded to 16
+                printf("frame: %s: %d bytes -> %d bytes (%d slots -> %d)\n", stmt->fn_name,
+                       (current_scope->local_count + 1) / 2 * 16, (slots + 1) / 2 * 16,
+                       current_scope->local_count, slots);
+            }
+            enter->operand = slots;
+            free(current_body_label);
+            current_body_label = NULL;
+            current_function = NULL;
+            
             // Restore scope
             current_scope = old_scope;
             // Note: fn_scope cleanup would be done after code generation
@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "elf64.h"
+
+// ELF64 structures and constants, spelled out so the compiler also builds
+// where <elf.h> is missing
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t phoff;
+    uint64_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} ElfHeader;
+
+typedef struct {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t addralign;
+    uint64_t entsize;
+} ElfSectionHeader;
+
+typedef struct {
+    uint32_t name;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+    uint64_t value;
+    uint64_t size;
+} ElfSymbol;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t info;
+    int64_t addend;
+} ElfRela;
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_FUNC 2
+#define STT_SECTION 3
+#define R_X86_64_64 1
+#define R_X86_64_PC32 2
+#define R_X86_64_PLT32 4
+#define R_X86_64_32 10
+#define EM_X86_64 62
+#define ET_REL 1
+
+// Section header order: null, the AsmObject sections, the DWARF sections
+// with -g, one .rela per section with relocations, then the tables
+#define FIRST_CONTENT_SECTION 1
+#define MAX_SECTIONS (2 * SECTION_COUNT + 2 * DEBUG_COUNT + 6)
+
+// DWARF 3 sections for -g, built from the assembler's %line records: a
+// compile unit covering both text sections and its line table
+typedef enum {
+    DEBUG_INFO,
+    DEBUG_ABBREV,
+    DEBUG_LINE,
+    DEBUG_RANGES,
+    DEBUG_COUNT
+} DebugSectionId;
+
+#define DW_TAG_compile_unit 0x11
+#define DW_AT_name 0x03
+#define DW_AT_stmt_list 0x10
+#define DW_AT_low_pc 0x11
+#define DW_AT_language 0x13
+#define DW_AT_comp_dir 0x1b
+#define DW_AT_producer 0x25
+#define DW_AT_ranges 0x55
+#define DW_FORM_addr 0x01
+#define DW_FORM_data2 0x05
+#define DW_FORM_data4 0x06
+#define DW_FORM_string 0x08
+#define DW_LANG_Mips_Assembler 0x8001  // What nasm -F dwarf reports
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define LINE_BASE (-5)
+#define LINE_RANGE 14
+#define OPCODE_BASE 13
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct {
+    const char* name;
+    uint32_t type;
+    uint64_t flags;
+    const void* data;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t align;
+    uint64_t entsize;
+} OutSection;
+
+static size_t buffer_add(Buffer* buf, const void* data, size_t n) {
+    if (buf->size + n > buf->capacity) {
+        while (buf->size + n > buf->capacity) {
+            buf->capacity = buf->capacity ? buf->capacity * 2 : 1024;
+        }
+        buf->data = realloc(buf->data, buf->capacity);
+    }
+    size_t offset = buf->size;
+    memcpy(buf->data + offset, data, n);
+    buf->size += n;
+    return offset;
+}
+
+static uint32_t add_string(Buffer* strtab, const char* s) {
+    return (uint32_t)buffer_add(strtab, s, strlen(s) + 1);
+}
+
+static void put_u8(Buffer* buf, uint8_t value) {
+    buffer_add(buf, &value, 1);
+}
+
+static void put_u16(Buffer* buf, uint16_t value) {
+    buffer_add(buf, &value, 2);
+}
+
+static void put_u32(Buffer* buf, uint32_t value) {
+    buffer_add(buf, &value, 4);
+}
+
+static void put_u64(Buffer* buf, uint64_t value) {
+    buffer_add(buf, &value, 8);
+}
+
+static void put_uleb(Buffer* buf, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        put_u8(buf, value ? byte | 0x80 : byte);
+    } while (value);
+}
+
+static void put_sleb(Buffer* buf, int64_t value) {
+    for (;;) {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+            put_u8(buf, byte);
+            return;
+        }
+        put_u8(buf, byte | 0x80);
+    }
+}
+
+static void put_string(Buffer* buf, const char* s) {
+    buffer_add(buf, s, strlen(s) + 1);
+}
+
+static void patch_u32(Buffer* buf, size_t offset, uint32_t value) {
+    memcpy(buf->data + offset, &value, 4);
+}
+
+// Symbol table index of the section symbol for a content or DWARF section
+static uint32_t content_symbol(int section) {
+    return 1 + section;
+}
+
+static uint32_t debug_symbol(int section) {
+    return 1 + SECTION_COUNT + section;
+}
+
+// A field at the current end of buf, filled in by the linker: symbol + addend
+static void put_reloc(Buffer* buf, Buffer* rela_buf, uint32_t type, uint32_t symbol, int64_t addend) {
+    ElfRela rela;
+    rela.offset = buf->size;
+    rela.info = ((uint64_t)symbol << 32) | type;
+    rela.addend = addend;
+    buffer_add(rela_buf, &rela, sizeof(rela));
+    if (type == R_X86_64_64) {
+        put_u64(buf, 0);
+    } else {
+        put_u32(buf, 0);
+    }
+}
+
+static void build_debug_info(AsmObject* obj, Buffer* debug, Buffer* relas) {
+    Buffer* abbrev = &debug[DEBUG_ABBREV];
+    put_uleb(abbrev, 1);
+    put_uleb(abbrev, DW_TAG_compile_unit);
+    put_u8(abbrev, 0);  // No children
+    static const uint16_t attributes[][2] = {
+        {DW_AT_producer, DW_FORM_string}, {DW_AT_language, DW_FORM_data2},
+        {DW_AT_name, DW_FORM_string}, {DW_AT_comp_dir, DW_FORM_string},
+        {DW_AT_stmt_list, DW_FORM_data4}, {DW_AT_low_pc, DW_FORM_addr},
+        {DW_AT_ranges, DW_FORM_data4}, {0, 0}
+    };
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++) {
+        put_uleb(abbrev, attributes[i][0]);
+        put_uleb(abbrev, attributes[i][1]);
+    }
+    put_u8(abbrev, 0);
+
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) {
+        cwd[0] = '\0';
+    }
+    Buffer* info = &debug[DEBUG_INFO];
+    put_u32(info, 0);  // Unit length, patched below
+    put_u16(info, 3);
+    put_reloc(info, &relas[DEBUG_INFO], R_X86_64_32, debug_symbol(DEBUG_ABBREV), 0);
+    put_u8(info, 8);  // Address size
+    put_uleb(info, 1);
+    put_string(info, "Jive compiler");
+    put_u16(info, DW_LANG_Mips_Assembler);
+    put_string(info, obj->source_file);
+    put_string(info, cwd);
+    put_reloc(info, &relas[DEBUG_INFO], R_X86_64_32, debug_symbol(DEBUG_LINE), 0);
+    put_u64(info, 0);  // Base address for the ranges, which are absolute
+    put_reloc(info, &relas[DEBUG_INFO], R_X86_64_32, debug_symbol(DEBUG_RANGES), 0);
+    patch_u32(info, 0, (uint32_t)(info->size - 4));
+
+    Buffer* ranges = &debug[DEBUG_RANGES];
+    for (int s = SECTION_TEXT; s <= SECTION_TEXT_UNLIKELY; s++) {
+        if (obj->sections[s].size) {
+            put_reloc(ranges, &relas[DEBUG_RANGES], R_X86_64_64, content_symbol(s), 0);
+            put_reloc(ranges, &relas[DEBUG_RANGES], R_X86_64_64, content_symbol(s),
+                      (int64_t)obj->sections[s].size);
+        }
+    }
+    put_u64(ranges, 0);
+    put_u64(ranges, 0);
+}
+
+// One sequence per text section, one row per %line record
+static void build_debug_line(AsmObject* obj, Buffer* line, Buffer* rela) {
+    static const uint8_t opcode_lengths[OPCODE_BASE - 1] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1};
+    put_u32(line, 0);  // Unit length, patched below
+    put_u16(line, 3);
+    put_u32(line, 0);  // Header length, patched below
+    size_t header_start = line->size;
+    put_u8(line, 1);   // Minimum instruction length
+    put_u8(line, 1);   // Rows are statements
+    put_u8(line, (uint8_t)LINE_BASE);
+    put_u8(line, LINE_RANGE);
+    put_u8(line, OPCODE_BASE);
+    buffer_add(line, opcode_lengths, sizeof(opcode_lengths));
+    put_u8(line, 0);   // No include directories
+    put_string(line, obj->source_file);
+    put_uleb(line, 0); // Directory, modification time, length
+    put_uleb(line, 0);
+    put_uleb(line, 0);
+    put_u8(line, 0);
+    patch_u32(line, 6, (uint32_t)(line->size - header_start));
+
+    for (int s = SECTION_TEXT; s <= SECTION_TEXT_UNLIKELY; s++) {
+        size_t address = 0;
+        int row = 1;
+        int started = 0;
+        for (int i = 0; i < obj->line_count; i++) {
+            AsmLine* l = &obj->lines[i];
+            if (l->section != s) continue;
+            if (!started) {
+                put_u8(line, 0);
+                put_uleb(line, 9);
+                put_u8(line, DW_LNE_set_address);
+                put_reloc(line, rela, R_X86_64_64, content_symbol(s), 0);
+                started = 1;
+            }
+            if (l->offset > address) {
+                put_u8(line, DW_LNS_advance_pc);
+                put_uleb(line, l->offset - address);
+                address = l->offset;
+            }
+            if (l->line != row) {
+                put_u8(line, DW_LNS_advance_line);
+                put_sleb(line, l->line - row);
+                row = l->line;
+            }
+            put_u8(line, DW_LNS_copy);
+        }
+        if (started) {
+            if (obj->sections[s].size > address) {
+                put_u8(line, DW_LNS_advance_pc);
+                put_uleb(line, obj->sections[s].size - address);
+            }
+            put_u8(line, 0);
+            put_uleb(line, 1);
+            put_u8(line, DW_LNE_end_sequence);
+        }
+    }
+    patch_u32(line, 0, (uint32_t)(line->size - 4));
+}
+
+static void write_padding(FILE* f, long* offset, uint64_t align) {
+    static const char zeros[16] = {0};
+    while (*offset % align) {
+        fwrite(zeros, 1, 1, f);
+        (*offset)++;
+    }
+}
+
+void write_elf_object(AsmObject* obj, const char* output_file) {
+    static const char* content_names[SECTION_COUNT] = {
+        ".text", ".text.unlikely", ".rodata", ".data", ".bss"
+    };
+    static const char* rela_names[SECTION_COUNT] = {
+        ".rela.text", ".rela.text.unlikely", ".rela.rodata", ".rela.data", ".rela.bss"
+    };
+    static const uint64_t content_flags[SECTION_COUNT] = {
+        SHF_ALLOC | SHF_EXECINSTR, SHF_ALLOC | SHF_EXECINSTR, SHF_ALLOC, SHF_ALLOC | SHF_WRITE,
+        SHF_ALLOC | SHF_WRITE
+    };
+    static const char* debug_names[DEBUG_COUNT] = {
+        ".debug_info", ".debug_abbrev", ".debug_line", ".debug_ranges"
+    };
+    static const char* debug_rela_names[DEBUG_COUNT] = {
+        ".rela.debug_info", ".rela.debug_abbrev", ".rela.debug_line", ".rela.debug_ranges"
+    };
+
+    Buffer debug[DEBUG_COUNT];
+    Buffer debug_relas[DEBUG_COUNT];
+    memset(debug, 0, sizeof(debug));
+    memset(debug_relas, 0, sizeof(debug_relas));
+    int debug_count = obj->line_count ? DEBUG_COUNT : 0;
+    if (debug_count) {
+        build_debug_info(obj, debug, debug_relas);
+        build_debug_line(obj, &debug[DEBUG_LINE], &debug_relas[DEBUG_LINE]);
+    }
+
+    // Symbols: null, one per content and DWARF section, locals, then globals
+    Buffer strtab = {0};
+    Buffer symtab = {0};
+    int* elf_index = malloc((obj->symbol_count + 1) * sizeof(int));
+    ElfSymbol sym;
+    add_string(&strtab, "");
+    memset(&sym, 0, sizeof(sym));
+    buffer_add(&symtab, &sym, sizeof(sym));
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        memset(&sym, 0, sizeof(sym));
+        sym.info = STT_SECTION;
+        sym.shndx = (uint16_t)(FIRST_CONTENT_SECTION + s);
+        buffer_add(&symtab, &sym, sizeof(sym));
+    }
+    for (int d = 0; d < debug_count; d++) {
+        memset(&sym, 0, sizeof(sym));
+        sym.info = STT_SECTION;
+        sym.shndx = (uint16_t)(FIRST_CONTENT_SECTION + SECTION_COUNT + d);
+        buffer_add(&symtab, &sym, sizeof(sym));
+    }
+    int next_index = 1 + SECTION_COUNT + debug_count;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < obj->symbol_count; i++) {
+            AsmSymbol* s = &obj->symbols[i];
+            if (s->global != pass || (!s->global && s->section < 0)) {
+                continue;
+            }
+            memset(&sym, 0, sizeof(sym));
+            sym.name = add_string(&strtab, s->name);
+            sym.info = (uint8_t)(((s->global ? STB_GLOBAL : STB_LOCAL) << 4) |
+                                 (s->function ? STT_FUNC : STT_NOTYPE));
+            sym.shndx = s->section >= 0 ? (uint16_t)(FIRST_CONTENT_SECTION + s->section) : 0;
+            sym.value = s->section >= 0 ? s->value : 0;
+            sym.size = s->size;
+            buffer_add(&symtab, &sym, sizeof(sym));
+            elf_index[i] = next_index++;
+        }
+    }
+    int first_global = 1 + SECTION_COUNT + debug_count;
+    for (int i = 0; i < obj->symbol_count; i++) {
+        if (!obj->symbols[i].global && obj->symbols[i].section >= 0) {
+            first_global++;
+        }
+    }
+
+    // Relocations against local labels go through their section symbol
+    Buffer relas[SECTION_COUNT];
+    memset(relas, 0, sizeof(relas));
+    for (int i = 0; i < obj->reloc_count; i++) {
+        AsmReloc* r = &obj->relocs[i];
+        AsmSymbol* s = &obj->symbols[r->symbol];
+        ElfRela rela;
+        uint64_t target;
+        rela.offset = r->offset;
+        rela.addend = r->addend;
+        if (!s->global) {
+            target = content_symbol(s->section);
+            rela.addend += (int64_t)s->value;
+        } else {
+            target = elf_index[r->symbol];
+        }
+        uint32_t type = r->type == RELOC_ABS64 ? R_X86_64_64 :
+                        r->type == RELOC_PLT32 ? R_X86_64_PLT32 : R_X86_64_PC32;
+        rela.info = (target << 32) | type;
+        buffer_add(&relas[r->section], &rela, sizeof(rela));
+    }
+
+    // Section table
+    OutSection sections[MAX_SECTIONS];
+    int count = 0;
+    memset(sections, 0, sizeof(sections));
+    count++;  // Null section
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        OutSection* out = &sections[count++];
+        out->name = content_names[s];
+        out->type = s == SECTION_BSS ? SHT_NOBITS : SHT_PROGBITS;
+        out->flags = content_flags[s];
+        out->data = obj->sections[s].bytes;
+        out->size = obj->sections[s].size;
+        out->align = obj->sections[s].align;
+    }
+    for (int d = 0; d < debug_count; d++) {
+        OutSection* out = &sections[count++];
+        out->name = debug_names[d];
+        out->type = SHT_PROGBITS;
+        out->data = debug[d].data;
+        out->size = debug[d].size;
+        out->align = 1;
+    }
+    int symtab_index = count;
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        if (relas[s].size) symtab_index++;
+    }
+    for (int d = 0; d < debug_count; d++) {
+        if (debug_relas[d].size) symtab_index++;
+    }
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        if (!relas[s].size) continue;
+        OutSection* out = &sections[count++];
+        out->name = rela_names[s];
+        out->type = SHT_RELA;
+        out->flags = SHF_INFO_LINK;
+        out->data = relas[s].data;
+        out->size = relas[s].size;
+        out->link = symtab_index;
+        out->info = FIRST_CONTENT_SECTION + s;
+        out->align = 8;
+        out->entsize = sizeof(ElfRela);
+    }
+    for (int d = 0; d < debug_count; d++) {
+        if (!debug_relas[d].size) continue;
+        OutSection* out = &sections[count++];
+        out->name = debug_rela_names[d];
+        out->type = SHT_RELA;
+        out->flags = SHF_INFO_LINK;
+        out->data = debug_relas[d].data;
+        out->size = debug_relas[d].size;
+        out->link = symtab_index;
+        out->info = FIRST_CONTENT_SECTION + SECTION_COUNT + d;
+        out->align = 8;
+        out->entsize = sizeof(ElfRela);
+    }
+    OutSection* out = &sections[count++];
+    out->name = ".symtab";
+    out->type = SHT_SYMTAB;
+    out->data = symtab.data;
+    out->size = symtab.size;
+    out->link = symtab_index + 1;
+    out->info = first_global;
+    out->align = 8;
+    out->entsize = sizeof(ElfSymbol);
+
+    out = &sections[count++];
+    out->name = ".strtab";
+    out->type = SHT_STRTAB;
+    out->data = strtab.data;
+    out->size = strtab.size;
+    out->align = 1;
+
+    // Empty: the stack does not need to be executable
+    out = &sections[count++];
+    out->name = ".note.GNU-stack";
+    out->type = SHT_PROGBITS;
+    out->align = 1;
+
+    int shstrtab_index = count;
+    out = &sections[count++];
+    out->name = ".shstrtab";
+    out->type = SHT_STRTAB;
+    out->align = 1;
+
+    Buffer shstrtab = {0};
+    add_string(&shstrtab, "");
+    uint32_t name_offsets[MAX_SECTIONS];
+    for (int i = 1; i < count; i++) {
+        name_offsets[i] = add_string(&shstrtab, sections[i].name);
+    }
+    sections[shstrtab_index].data = shstrtab.data;
+    sections[shstrtab_index].size = shstrtab.size;
+
+    FILE* f = fopen(output_file, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open output file '%s'\n", output_file);
+        exit(1);
+    }
+
+    ElfHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.ident, "\177ELF", 4);
+    header.ident[4] = 2;  // 64-bit
+    header.ident[5] = 1;  // Little endian
+    header.ident[6] = 1;  // Version
+    header.type = ET_REL;
+    header.machine = EM_X86_64;
+    header.version = 1;
+    header.ehsize = sizeof(ElfHeader);
+    header.shentsize = sizeof(ElfSectionHeader);
+    header.shnum = (uint16_t)count;
+    header.shstrndx = (uint16_t)shstrtab_index;
+    fwrite(&header, sizeof(header), 1, f);
+
+    long offset = sizeof(header);
+    ElfSectionHeader headers[MAX_SECTIONS];
+    memset(headers, 0, sizeof(headers));
+    for (int i = 1; i < count; i++) {
+        OutSection* s = &sections[i];
+        ElfSectionHeader* h = &headers[i];
+        write_padding(f, &offset, s->align ? s->align : 1);
+        h->name = name_offsets[i];
+        h->type = s->type;
+        h->flags = s->flags;
+        h->offset = offset;
+        h->size = s->size;
+        h->link = s->link;
+        h->info = s->info;
+        h->addralign = s->align;
+        h->entsize = s->entsize;
+        if (s->type != SHT_NOBITS && s->size) {
+            fwrite(s->data, 1, s->size, f);
+            offset += (long)s->size;
+        }
+    }
+    write_padding(f, &offset, 8);
+    header.shoff = offset;
+    fwrite(headers, sizeof(ElfSectionHeader), count, f);
+    fseek(f, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, f);
+    fclose(f);
+
+    free(elf_index);
+    free(strtab.data);
+    free(symtab.data);
+    free(shstrtab.data);
+    for (int s = 0; s < SECTION_COUNT; s++) {
+        free(relas[s].data);
+    }
+    for (int d = 0; d < DEBUG_COUNT; d++) {
+        free(debug[d].data);
+        free(debug_relas[d].data);
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef ELF64_H
+#define ELF64_H
+
+#include "assembler.h"
+
+// Write obj as a relocatable x86-64 ELF object (what nasm -f elf64 makes)
+void write_elf_object(AsmObject* obj, const char* output_file);
+
+#endif // ELF64_H
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "escape.h"
+#include "options.h"
+
+#define MAX_ALIASES 64
+
+// A constant-size malloc and the variables that hold its pointer
+typedef struct {
+    const char* names[MAX_ALIASES];
+    int count;
+} AliasSet;
+
+static int in_set(AliasSet* set, const char* name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Number of declarations/assignments of name in a subtree
+static int count_writes(ASTNode* node, const char* name) {
+    if (!node) return 0;
+    int count = 0;
+    if ((node->type == AST_ASSIGN || node->type == AST_VAR_DECL) &&
+        strcmp(node->var_name, name) == 0) {
+        count = 1;
+    }
+    return count + count_writes(node->left, name) + count_writes(node->right, name) +
+           count_writes(node->condition, name) + count_writes(node->then_block, name) +
+           count_writes(node->else_block, name) + count_writes(node->body, name) +
+           count_writes(node->params, name) + count_writes(node->args, name) +
+           count_writes(node->next_arg, name) + count_writes(node->statements, name);
+}
+
+// Add every `let q = p` with p in the set and q written nowhere else
+static void collect_aliases(ASTNode* node, ASTNode* body, AliasSet* set) {
+    if (!node) return;
+    if (node->type == AST_VAR_DECL && node->left && node->left->type == AST_VAR &&
+        in_set(set, node->left->var_name) && !in_set(set, node->var_name) &&
+        count_writes(body, node->var_name) == 1 && set->count < MAX_ALIASES) {
+        set->names[set->count++] = node->var_name;
+    }
+    collect_aliases(node->left, body, set);
+    collect_aliases(node->right, body, set);
+    collect_aliases(node->condition, body, set);
+    collect_aliases(node->then_block, body, set);
+    collect_aliases(node->else_block, body, set);
+    collect_aliases(node->body, body, set);
+    collect_aliases(node->params, body, set);
+    collect_aliases(node->args, body, set);
+    collect_aliases(node->next_arg, body, set);
+    collect_aliases(node->statements, body, set);
+}
+
+// A pointer read is harmless when it is freed, compared, printed or copied
+// into another alias; anything else (return, call argument, arithmetic,
+// assignment to another variable) lets it escape
+static int escapes(ASTNode* node, ASTNode* parent, AliasSet* set) {
+    if (!node) return 0;
+    if (node->type == AST_VAR && in_set(set, node->var_name)) {
+        if (!parent) return 1;
+        switch (parent->type) {
+            case AST_FREE:
+            case AST_COMPARE:
+            case AST_PRINT:
+                break;
+            case AST_VAR_DECL:
+                if (!in_set(set, parent->var_name)) return 1;
+                break;
+            default:
+                return 1;
+        }
+    }
+
+    // right and next_arg link siblings, except for binary operands
+    ASTNode* right_parent = (node->type == AST_BINOP || node->type == AST_COMPARE) ? node : parent;
+    return escapes(node->left, node, set) || escapes(node->right, right_parent, set) ||
+           escapes(node->condition, node, set) || escapes(node->then_block, node, set) ||
+           escapes(node->else_block, node, set) || escapes(node->body, node, set) ||
+           escapes(node->params, node, set) || escapes(node->args, node, set) ||
+           escapes(node->next_arg, parent, set) || escapes(node->statements, node, set);
+}
+
+// free() of a stack allocation does nothing; leave an empty block in its place
+static void remove_frees(ASTNode* node, AliasSet* set) {
+    if (!node) return;
+    if (node->type == AST_FREE && node->left->type == AST_VAR &&
+        in_set(set, node->left->var_name)) {
+        free_ast(node->left);
+        node->left = NULL;
+        node->type = AST_BLOCK;
+        node->statements = NULL;
+        node->stmt_count = 0;
+    }
+    remove_frees(node->left, set);
+    remove_frees(node->right, set);
+    remove_frees(node->condition, set);
+    remove_frees(node->then_block, set);
+    remove_frees(node->else_block, set);
+    remove_frees(node->body, set);
+    remove_frees(node->params, set);
+    remove_frees(node->args, set);
+    remove_frees(node->next_arg, set);
+    remove_frees(node->statements, set);
+}
+
+typedef struct {
+    int allocations;
+    int bytes;
+} EscapeStats;
+
+static void visit_decls(ASTNode* node, ASTNode* body, EscapeStats* stats) {
+    if (!node) return;
+    if (node->type == AST_VAR_DECL && node->left && node->left->type == AST_MALLOC &&
+        node->left->left->type == AST_INT_LIT) {
+        int size = node->left->left->int_value;
+        AliasSet set;
+        set.names[0] = node->var_name;
+        set.count = 1;
+        if (size >= 0 && size <= MAX_STACK_ALLOC && count_writes(body, node->var_name) == 1) {
+            collect_aliases(body, body, &set);
+            if (!escapes(body, NULL, &set)) {
+                ASTNode* malloc_node = node->left;
+                free_ast(malloc_node->left);
+                malloc_node->left = NULL;
+                malloc_node->type = AST_STACK_ALLOC;
+                malloc_node->int_value = size;
+                remove_frees(body, &set);
+                stats->allocations++;
+                stats->bytes += size;
+            }
+        }
+    }
+    visit_decls(node->left, body, stats);
+    visit_decls(node->right, body, stats);
+    visit_decls(node->condition, body, stats);
+    visit_decls(node->then_block, body, stats);
+    visit_decls(node->else_block, body, stats);
+    visit_decls(node->body, body, stats);
+    visit_decls(node->params, body, stats);
+    visit_decls(node->statements, body, stats);
+}
+
+void stack_allocate(ASTNode* program) {
+    if (!program || program->type != AST_PROGRAM || !options.stack_alloc) {
+        return;
+    }
+
+    ASTNode* stmt = program->statements;
+    while (stmt) {
+        if (stmt->type == AST_FN_DEF) {
+            EscapeStats stats = {0, 0};
+            visit_decls(stmt->body_nodes, stmt->body_nodes, &stats);
+            if (options.escape_report) {
+                printf("escape: %s: %d allocation(s) moved to the stack (%d bytes)\n",
+                       stmt->fn_name, stats.allocations, stats.bytes);
+            }
+        }
+        stmt = stmt->right;
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include "parser.h"
+
+// Largest malloc (in bytes) that may be moved into a stack frame
+#define MAX_STACK_ALLOC 4096
+
+void stack_allocate(ASTNode* program);
+
+#endif // ESCAPE_H
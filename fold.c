@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "fold.h"
+#include "options.h"
+
+static int prints_saved = 0;
+
+static void make_int_lit(ASTNode* node, long long value) {
+    free_ast(node->left);
+    free_ast(node->right);
+    node->left = NULL;
+    node->right = NULL;
+    node->type = AST_INT_LIT;
+    node->int_value = (int)value;
+}
+
+static void make_string_lit(ASTNode* node, char* value) {
+    free_ast(node->left);
+    free_ast(node->right);
+    node->left = NULL;
+    node->right = NULL;
+    node->type = AST_STRING_LIT;
+    node->string_value = value;
+}
+
+static int is_constant(ASTNode* node) {
+    return node->type == AST_INT_LIT || node->type == AST_STRING_LIT;
+}
+
+// Text of a constant as it appears inside a concatenation
+static char* constant_text(ASTNode* node) {
+    if (node->type == AST_STRING_LIT) {
+        return strdup(node->string_value);
+    }
+    char* text = malloc(16);
+    snprintf(text, 16, "%d", node->int_value);
+    return text;
+}
+
+static char* concat(const char* a, const char* b) {
+    char* result = malloc(strlen(a) + strlen(b) + 1);
+    strcpy(result, a);
+    strcat(result, b);
+    return result;
+}
+
+static void fold_binop(ASTNode* node) {
+    ASTNode* left = node->left;
+    ASTNode* right = node->right;
+
+    // "a" + "b" and "n = " + 5 become one pooled literal, the text the
+    // runtime + (jive_str_concat, jive_str_concat_int) would build
+    if (node->binop == BINOP_PLUS && is_constant(left) && is_constant(right) &&
+        (left->type == AST_STRING_LIT || right->type == AST_STRING_LIT)) {
+        char* a = constant_text(left);
+        char* b = constant_text(right);
+        make_string_lit(node, concat(a, b));
+        free(a);
+        free(b);
+        return;
+    }
+
+    if (left->type != AST_INT_LIT || right->type != AST_INT_LIT) {
+        return;
+    }
+    long long a = left->int_value;
+    long long b = right->int_value;
+    long long value;
+    switch (node->binop) {
+        case BINOP_PLUS:  value = a + b; break;
+        case BINOP_MINUS: value = a - b; break;
+        case BINOP_MULT:  value = a * b; break;
+        case BINOP_DIV:
+            // Leave the runtime trap in place for division by zero
+            if (b == 0) return;
+            value = a / b;
+            break;
+        default:
+            return;
+    }
+    // Literals are ints; larger results are computed at run time
+    if (value < INT_MIN || value > INT_MAX) {
+        return;
+    }
+    make_int_lit(node, value);
+}
+
+static void fold_compare(ASTNode* node) {
+    if (node->left->type != AST_INT_LIT || node->right->type != AST_INT_LIT) {
+        return;
+    }
+    int a = node->left->int_value;
+    int b = node->right->int_value;
+    int value = 0;
+    switch (node->compare_op) {
+        case COMPARE_EQ: value = a == b; break;
+        case COMPARE_NE: value = a != b; break;
+        case COMPARE_LT: value = a < b; break;
+        case COMPARE_GT: value = a > b; break;
+        case COMPARE_LE: value = a <= b; break;
+        case COMPARE_GE: value = a >= b; break;
+    }
+    make_int_lit(node, value);
+}
+
+// What a print of this constant writes: strings verbatim, ints with the
+// newline the runtime appends
+static char* print_text(ASTNode* node) {
+    if (node->type == AST_STRING_LIT) {
+        return strdup(node->string_value);
+    }
+    char* text = malloc(16);
+    snprintf(text, 16, "%d\n", node->int_value);
+    return text;
+}
+
+// Merge runs of prints of constants into the first print of the run
+static void coalesce_prints(ASTNode* stmt) {
+    while (stmt) {
+        if (stmt->type == AST_PRINT && is_constant(stmt->left) &&
+            stmt->right && stmt->right->type == AST_PRINT && is_constant(stmt->right->left)) {
+            char* text = print_text(stmt->left);
+            while (stmt->right && stmt->right->type == AST_PRINT && is_constant(stmt->right->left)) {
+                ASTNode* next = stmt->right;
+                char* more = print_text(next->left);
+                char* joined = concat(text, more);
+                free(text);
+                free(more);
+                text = joined;
+
+                stmt->right = next->right;
+                next->right = NULL;
+                free_ast(next);
+                prints_saved++;
+            }
+            free_ast(stmt->left);
+            stmt->left = create_ast_node(AST_STRING_LIT);
+            stmt->left->string_value = text;
+        }
+        stmt = stmt->right;
+    }
+}
+
+static void fold_node(ASTNode* node) {
+    if (!node) return;
+
+    fold_node(node->left);
+    fold_node(node->condition);
+    fold_node(node->then_block);
+    fold_node(node->else_block);
+    fold_node(node->body);
+    fold_node(node->params);
+    fold_node(node->args);
+    fold_node(node->next_arg);
+    fold_node(node->body_nodes);
+    fold_node(node->statements);
+
+    if (node->type == AST_BINOP || node->type == AST_COMPARE) {
+        fold_node(node->right);
+        if (node->type == AST_BINOP) {
+            fold_binop(node);
+        } else {
+            fold_compare(node);
+        }
+        return;
+    }
+
+    if (node->type == AST_BLOCK || node->type == AST_PROGRAM) {
+        coalesce_prints(node->statements);
+        // Recount after merged prints were unlinked
+        node->stmt_count = 0;
+        for (ASTNode* stmt = node->statements; stmt; stmt = stmt->right) {
+            node->stmt_count++;
+        }
+    }
+
+    // Statement lists continue through right
+    fold_node(node->right);
+}
+
+void fold_constants(ASTNode* program) {
+    prints_saved = 0;
+    fold_node(program);
+    if (options.print_report) {
+        printf("print: %d runtime print call(s) saved\n", prints_saved);
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "parser.h"
+
+void fold_constants(ASTNode* program);
+
+#endif // FOLD_H
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "inliner.h"
+#include "options.h"
+#include "profile.h"
+
+#define MAX_INLINE_DEPTH 16
+
+static ASTNode* program_ast;
+static int inline_counter = 0;
+static int inlined_calls = 0;
+
+// Functions currently being expanded, outermost first (recursion guard)
+static const char* inline_stack[MAX_INLINE_DEPTH];
+static int inline_depth;
+
+static ASTNode* find_function(const char* name) {
+    ASTNode* stmt = program_ast->statements;
+    while (stmt) {
+        if (stmt->type == AST_FN_DEF && strcmp(stmt->fn_name, name) == 0) {
+            return stmt;
+        }
+        stmt = stmt->right;
+    }
+    return NULL;
+}
+
+static int count_nodes(ASTNode* node) {
+    if (!node) return 0;
+    return 1 + count_nodes(node->left) + count_nodes(node->right) +
+           count_nodes(node->condition) + count_nodes(node->then_block) +
+           count_nodes(node->else_block) + count_nodes(node->body) +
+           count_nodes(node->params) + count_nodes(node->args) +
+           count_nodes(node->next_arg) + count_nodes(node->statements);
+}
+
+static int count_call_sites(ASTNode* node, const char* name) {
+    if (!node) return 0;
+    int count = 0;
+    if ((node->type == AST_CALL_EXPR || node->type == AST_CALL_STMT) &&
+        strcmp(node->call_name, name) == 0) {
+        count = 1;
+    }
+    return count + count_call_sites(node->left, name) + count_call_sites(node->right, name) +
+           count_call_sites(node->condition, name) + count_call_sites(node->then_block, name) +
+           count_call_sites(node->else_block, name) + count_call_sites(node->body, name) +
+           count_call_sites(node->body_nodes, name) + count_call_sites(node->args, name) +
+           count_call_sites(node->next_arg, name) + count_call_sites(node->statements, name);
+}
+
+static int count_list(ASTNode* node, int use_next_arg) {
+    int count = 0;
+    while (node) {
+        count++;
+        node = use_next_arg ? node->next_arg : node->right;
+    }
+    return count;
+}
+
+// Inlined locals get a name that cannot appear in Jive source, so they never
+// collide with the caller's variables once declared in the caller's scope
+static char* inline_name(const char* name, int id) {
+    char* renamed = malloc(strlen(name) + 16);
+    sprintf(renamed, "%s.inl%d", name, id);
+    return renamed;
+}
+
+static void rename_vars(ASTNode* node, int id) {
+    if (!node) return;
+    if (node->var_name) {
+        char* renamed = inline_name(node->var_name, id);
+        free(node->var_name);
+        node->var_name = renamed;
+    }
+    rename_vars(node->left, id);
+    rename_vars(node->right, id);
+    rename_vars(node->condition, id);
+    rename_vars(node->then_block, id);
+    rename_vars(node->else_block, id);
+    rename_vars(node->body, id);
+    rename_vars(node->params, id);
+    rename_vars(node->args, id);
+    rename_vars(node->next_arg, id);
+    rename_vars(node->statements, id);
+}
+
+static int on_inline_stack(const char* name) {
+    for (int i = 0; i < inline_depth; i++) {
+        if (strcmp(inline_stack[i], name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void inline_calls(ASTNode* node, const char* caller);
+
+static void try_inline(ASTNode* node, const char* caller) {
+    ASTNode* callee = find_function(node->call_name);
+    const char* reason = NULL;
+    int size = 0;
+    long calls = profile_count(node->profile_key, NULL);
+    int hot = profile_is_hot(calls);
+
+    if (!callee) {
+        reason = "external function";
+    } else if (strcmp(callee->fn_name, "main") == 0) {
+        reason = "entry point";
+    } else if (on_inline_stack(callee->fn_name)) {
+        reason = "recursive";
+    } else if (inline_depth >= MAX_INLINE_DEPTH) {
+        reason = "inline depth limit";
+    } else if (count_list(callee->params, 0) != count_list(node->args, 1)) {
+        reason = "argument count mismatch";
+    } else {
+        // With a profile, hot call sites get a larger budget and call sites
+        // that never ran are left alone unless inlining removes the callee
+        size = count_nodes(callee->body_nodes);
+        int limit = hot ? options.inline_limit * PGO_HOT_INLINE_FACTOR : options.inline_limit;
+        int single_site = count_call_sites(program_ast, callee->fn_name) == 1;
+        if (calls == 0 && !single_site) {
+            reason = "cold call site";
+        } else if (size > limit && !single_site) {
+            reason = "too large";
+        }
+    }
+
+    if (reason) {
+        if (options.inline_report) {
+            printf("inline: %s -> %s: not inlined (%s)\n", caller, node->call_name, reason);
+        }
+        return;
+    }
+
+    int id = ++inline_counter;
+    ASTNode* body = clone_ast(callee->body_nodes);
+    rename_vars(body, id);
+
+    // Bind parameters right-to-left, matching the evaluation order of a real call
+    ASTNode* bindings = NULL;
+    ASTNode* param = callee->params;
+    ASTNode* arg = node->args;
+    while (param) {
+        ASTNode* next = arg->next_arg;
+        ASTNode* bind = create_ast_node(AST_VAR_DECL);
+        bind->var_name = inline_name(param->var_name, id);
+        bind->int_value = param->int_value;
+        bind->left = arg;
+        arg->next_arg = NULL;
+        bind->right = bindings;
+        bindings = bind;
+        param = param->right;
+        arg = next;
+    }
+
+    // Expand calls inside the inlined body with the callee on the guard stack
+    inline_stack[inline_depth++] = callee->fn_name;
+    inline_calls(body, callee->fn_name);
+    inline_depth--;
+
+    // Rewrite the call node in place so statement/argument links stay intact
+    node->type = AST_INLINE;
+    node->int_value = callee->int_value;  // Result type of the call
+    node->args = NULL;
+    node->params = bindings;
+    node->body = body;
+    inlined_calls++;
+
+    if (options.inline_report) {
+        printf("inline: %s -> %s: inlined (size %d%s)\n", caller, node->call_name, size,
+               hot ? ", hot" : "");
+    }
+}
+
+static void inline_calls(ASTNode* node, const char* caller) {
+    if (!node) return;
+
+    // Arguments first, so nested calls are expanded before their parent call
+    inline_calls(node->args, caller);
+    inline_calls(node->next_arg, caller);
+    inline_calls(node->left, caller);
+    inline_calls(node->condition, caller);
+    inline_calls(node->then_block, caller);
+    inline_calls(node->else_block, caller);
+    inline_calls(node->body, caller);
+    inline_calls(node->statements, caller);
+
+    if (node->type == AST_CALL_EXPR || node->type == AST_CALL_STMT) {
+        try_inline(node, caller);
+    }
+
+    inline_calls(node->right, caller);
+}
+
+void inline_functions(ASTNode* program) {
+    if (!program || program->type != AST_PROGRAM || options.inline_limit <= 0) {
+        return;
+    }
+    program_ast = program;
+    inlined_calls = 0;
+
+    ASTNode* stmt = program->statements;
+    while (stmt) {
+        if (stmt->type == AST_FN_DEF) {
+            inline_stack[0] = stmt->fn_name;
+            inline_depth = 1;
+            inline_calls(stmt->body_nodes, stmt->fn_name);
+        }
+        stmt = stmt->right;
+    }
+
+    if (options.inline_report) {
+        printf("inline: %d call(s) inlined\n", inlined_calls);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "parser.h"
+
+#define DEFAULT_INLINE_LIMIT 20
+
+void inline_functions(ASTNode* program);
+
+#endif // INLINER_H
@@ -0,0 +1,849 @@
+#define _GNU_SOURCE  // RTLD_DEFAULT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include "interp.h"
+#include "options.h"
+#include "symbol_table.h"
+#include "runtime.h"
+
+#define INTERP_STACK_SLOTS (1 << 20)  // 8 MiB, the usual native stack limit
+#define INTERP_STACK_RESERVE 4096     // Operand slots kept free below the deepest frame
+#define INTERP_VEC_REGS 16
+#define INTERP_MAX_C_ARGS 6           // C functions get register arguments only
+#define LABEL_BUCKETS 1024
+
+typedef enum {
+    OP_PUSH,
+    OP_POP,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MULI,
+    OP_DIVI,
+    OP_LOAD,
+    OP_STORE,
+    OP_ENTER,
+    OP_PARAM,
+    OP_CALL,
+    OP_CALL_C,
+    OP_TAILCALL,
+    OP_TAILCALL_C,
+    OP_RET,
+    OP_HALT,
+    OP_JMP,
+    OP_JZ,
+    OP_JNZ,
+    // Comparisons, in CompareOp order: push the result, branch on it, or
+    // branch on a comparison with an immediate
+    OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE,
+    OP_BR_EQ, OP_BR_NE, OP_BR_LT, OP_BR_GT, OP_BR_LE, OP_BR_GE,
+    OP_BRI_EQ, OP_BRI_NE, OP_BRI_LT, OP_BRI_GT, OP_BRI_LE, OP_BRI_GE,
+    OP_PRINT_INT,
+    OP_PRINT_STR,
+    OP_STR_LEN,
+    OP_INDEX_LOAD,
+    OP_INDEX_STORE,
+    OP_VEC_LOAD,
+    OP_VEC_SPLAT,
+    OP_VEC_ADD,
+    OP_VEC_SUB,
+    OP_VEC_STORE,
+    OP_VEC_ALIAS,
+    OP_MALLOC,
+    OP_PROF_ALLOC,
+    OP_FRAME_ADDR,
+    OP_REGION_ENTER,
+    OP_REGION_EXIT,
+    OP_REGION_ALLOC,
+    OP_FREE,
+    OP_PROF_FREE,
+    OP_HEAP_SITE,
+    // Superinstructions
+    OP_ADDI,    // PUSH k; ADD (or SUB with -k)
+    OP_LOAD2,   // LOAD x; LOAD y
+    OP_STOREI,  // PUSH k; STORE x
+    OP_INC,     // LOAD x; PUSH k; ADD; STORE x
+    OP_COUNT
+} InterpOp;
+
+typedef struct InterpInsn {
+    const void* handler;        // Address of the op's code in execute()
+    InterpOp op;
+    long a;                     // Immediate, frame slot, byte offset, count or size
+    long b;                     // Second operand
+    struct InterpInsn* target;  // Jump or call target
+    void* ptr;                  // C function, or heap profiler site
+} InterpInsn;
+
+typedef struct InterpBlock {
+    struct InterpBlock* next;
+    long data[];
+} InterpBlock;
+
+struct InterpProgram {
+    InterpInsn* code;
+    int count;
+    int capacity;
+    InterpBlock* blocks;  // String literals and heap profiler site names
+};
+
+typedef struct LabelEntry {
+    const char* name;
+    int index;     // Instruction the label stands before, -1 until seen
+    int function;  // Starts a Jive function
+    struct LabelEntry* next;
+} LabelEntry;
+
+// Translation state
+static LabelEntry* labels[LABEL_BUCKETS];
+static LabelEntry* sites[LABEL_BUCKETS];  // Heap profiler site names
+static const char** target_labels;  // Per instruction: label its target names
+static int param_index;
+
+typedef long (*CFunction)(long, long, long, long, long, long);
+
+static void interp_error(const char* message, const char* detail) {
+    fprintf(stderr, "Error: interp: %s '%s'\n", message, detail);
+    exit(1);
+}
+
+static unsigned hash_label(const char* name) {
+    unsigned hash = 5381;
+    for (; *name; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash % LABEL_BUCKETS;
+}
+
+static LabelEntry* find_entry(LabelEntry** table, const char* name, int create) {
+    unsigned bucket = hash_label(name);
+    for (LabelEntry* e = table[bucket]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    LabelEntry* e = calloc(1, sizeof(LabelEntry));
+    e->name = name;
+    e->index = -1;
+    e->next = table[bucket];
+    table[bucket] = e;
+    return e;
+}
+
+static LabelEntry* find_label(const char* name, int create) {
+    return find_entry(labels, name, create);
+}
+
+static void free_entries(LabelEntry** table) {
+    for (int i = 0; i < LABEL_BUCKETS; i++) {
+        while (table[i]) {
+            LabelEntry* next = table[i]->next;
+            free(table[i]);
+            table[i] = next;
+        }
+    }
+}
+
+static InterpInsn* emit(InterpProgram* p, InterpOp op, long a) {
+    if (p->count == p->capacity) {
+        p->capacity = p->capacity ? p->capacity * 2 : 1024;
+        p->code = realloc(p->code, p->capacity * sizeof(InterpInsn));
+        target_labels = realloc(target_labels, p->capacity * sizeof(const char*));
+    }
+    InterpInsn* insn = &p->code[p->count];
+    memset(insn, 0, sizeof(*insn));
+    insn->op = op;
+    insn->a = a;
+    target_labels[p->count] = NULL;
+    p->count++;
+    return insn;
+}
+
+static void emit_jump(InterpProgram* p, InterpOp op, long a, const char* label) {
+    emit(p, op, a);
+    target_labels[p->count - 1] = label;
+}
+
+static void* new_block(InterpProgram* p, size_t size) {
+    InterpBlock* block = calloc(1, sizeof(InterpBlock) + size);
+    block->next = p->blocks;
+    p->blocks = block;
+    return block->data;
+}
+
+// A literal gets the same header as in the native data section
+static char* string_literal(InterpProgram* p, const char* value) {
+    size_t len = strlen(value);
+    long* header = new_block(p, 2 * sizeof(long) + len + 1);
+    header[0] = (long)len;
+    header[1] = (long)len;
+    char* str = (char*)(header + 2);
+    memcpy(str, value, len + 1);
+    return str;
+}
+
+// The heap profiler keys sites by address, so every instruction of one site
+// must pass the same string
+static const char* heap_site(InterpProgram* p, const char* site) {
+    LabelEntry* e = find_entry(sites, site, 0);
+    if (e) {
+        return e->name;
+    }
+    char* copy = new_block(p, strlen(site) + 1);
+    strcpy(copy, site);
+    find_entry(sites, copy, 1);
+    return copy;
+}
+
+static int is(IRInstruction* instr, IROp op) {
+    return instr && instr->op == op;
+}
+
+static InterpOp inverse_compare(int compare) {
+    static const InterpOp inverse[] = {OP_NE, OP_EQ, OP_GE, OP_LE, OP_GT, OP_LT};
+    return inverse[compare];
+}
+
+// Translate one IR instruction, or a run of them that forms a
+// superinstruction; returns the next instruction to translate
+static IRInstruction* translate(InterpProgram* p, IRInstruction* instr) {
+    IRInstruction* n1 = instr->next;
+    IRInstruction* n2 = n1 ? n1->next : NULL;
+    IRInstruction* n3 = n2 ? n2->next : NULL;
+
+    // Superinstructions, longest first. Labels are IR instructions, so a
+    // jump target never ends up inside one.
+    if (is(instr, IR_LOAD) && is(n1, IR_PUSH) && (is(n2, IR_ADD) || is(n2, IR_SUB)) &&
+        is(n3, IR_STORE) && n3->operand == instr->operand) {
+        InterpInsn* insn = emit(p, OP_INC, instr->operand / 8);
+        insn->b = n2->op == IR_ADD ? (long)n1->operand : -(long)n1->operand;
+        return n3->next;
+    }
+    if (is(instr, IR_PUSH) && is(n1, IR_CMP) && (is(n2, IR_JZ) || is(n2, IR_JNZ)) && n2->label) {
+        InterpOp compare = is(n2, IR_JZ) ? inverse_compare(n1->operand) : (InterpOp)(OP_EQ + n1->operand);
+        emit_jump(p, OP_BRI_EQ + (compare - OP_EQ), instr->operand, n2->label);
+        return n3;
+    }
+    if (is(instr, IR_CMP) && (is(n1, IR_JZ) || is(n1, IR_JNZ)) && n1->label) {
+        InterpOp compare = is(n1, IR_JZ) ? inverse_compare(instr->operand) : (InterpOp)(OP_EQ + instr->operand);
+        emit_jump(p, OP_BR_EQ + (compare - OP_EQ), 0, n1->label);
+        return n2;
+    }
+    if (is(instr, IR_PUSH) && (is(n1, IR_ADD) || is(n1, IR_SUB))) {
+        emit(p, OP_ADDI, is(n1, IR_ADD) ? (long)instr->operand : -(long)instr->operand);
+        return n2;
+    }
+    if (is(instr, IR_PUSH) && is(n1, IR_STORE)) {
+        InterpInsn* insn = emit(p, OP_STOREI, instr->operand);
+        insn->b = n1->operand / 8;
+        return n2;
+    }
+    if (is(instr, IR_LOAD) && is(n1, IR_LOAD)) {
+        InterpInsn* insn = emit(p, OP_LOAD2, instr->operand / 8);
+        insn->b = n1->operand / 8;
+        return n2;
+    }
+
+    switch (instr->op) {
+        case IR_LABEL:
+            if (instr->label) {
+                find_label(instr->label, 1)->index = p->count;
+            }
+            break;
+        case IR_COLD_BEGIN:
+        case IR_COLD_END:
+            // interp_translate moves cold code out of line itself
+            break;
+        case IR_PUSH:
+            emit(p, OP_PUSH, instr->operand);
+            break;
+        case IR_PUSH_STR:
+            emit(p, OP_PUSH, instr->str_value ? (long)string_literal(p, instr->str_value) : 0);
+            break;
+        case IR_POP:
+            emit(p, OP_POP, 0);
+            break;
+        case IR_ADD:
+            emit(p, OP_ADD, 0);
+            break;
+        case IR_SUB:
+            emit(p, OP_SUB, 0);
+            break;
+        case IR_MUL:
+            emit(p, OP_MUL, 0);
+            break;
+        case IR_DIV:
+            emit(p, OP_DIV, 0);
+            break;
+        case IR_MULI:
+            emit(p, OP_MULI, instr->operand);
+            break;
+        case IR_DIVI:
+            emit(p, OP_DIVI, instr->operand);
+            break;
+        case IR_LOAD:
+            emit(p, OP_LOAD, instr->operand / 8);
+            break;
+        case IR_STORE:
+            emit(p, OP_STORE, instr->operand / 8);
+            break;
+        case IR_ENTER:
+            // Same frame size as the native prologue
+            emit(p, OP_ENTER, ((instr->operand + 1) / 2) * 2);
+            param_index = 0;
+            break;
+        case IR_PARAM: {
+            InterpInsn* insn = emit(p, OP_PARAM, instr->operand / 8);
+            insn->b = param_index++;
+            break;
+        }
+        case IR_ARGS:
+            // Only keeps the native stack aligned
+            break;
+        case IR_CALL:
+        case IR_TAILCALL: {
+            LabelEntry* callee = find_label(instr->label, 0);
+            int tail = instr->op == IR_TAILCALL;
+            if (callee && callee->function) {
+                int reg_args = instr->operand < MAX_REG_PARAMS ? instr->operand : MAX_REG_PARAMS;
+                emit_jump(p, tail ? OP_TAILCALL : OP_CALL, reg_args, instr->label);
+                p->code[p->count - 1].b = instr->operand - reg_args;  // Stack arguments
+                break;
+            }
+            // Runtime and C library functions of the compiler process
+            if (instr->operand > INTERP_MAX_C_ARGS) {
+                interp_error("too many arguments for C function", instr->label + 1);
+            }
+            void* function = dlsym(RTLD_DEFAULT, instr->label + 1);
+            if (!function) {
+                interp_error("undefined function", instr->label + 1);
+            }
+            emit(p, tail ? OP_TAILCALL_C : OP_CALL_C, instr->operand)->ptr = function;
+            break;
+        }
+        case IR_RET:
+            emit(p, OP_RET, 0);
+            break;
+        case IR_CMP:
+            emit(p, OP_EQ + instr->operand, 0);
+            break;
+        case IR_JMP:
+            if (instr->label) {
+                emit_jump(p, OP_JMP, 0, instr->label);
+            }
+            break;
+        case IR_JZ:
+        case IR_JNZ:
+            if (instr->label) {
+                emit_jump(p, instr->op == IR_JZ ? OP_JZ : OP_JNZ, 0, instr->label);
+            } else {
+                emit(p, OP_POP, 0);
+            }
+            break;
+        case IR_PRINT_INT:
+            emit(p, OP_PRINT_INT, 0);
+            break;
+        case IR_PRINT_STR:
+            emit(p, OP_PRINT_STR, instr->operand);
+            break;
+        case IR_STR_LEN:
+            emit(p, OP_STR_LEN, 0);
+            break;
+        case IR_INDEX_LOAD:
+            emit(p, OP_INDEX_LOAD, instr->operand);
+            break;
+        case IR_INDEX_STORE:
+            emit(p, OP_INDEX_STORE, instr->operand);
+            break;
+        case IR_VEC_LOAD:
+            emit(p, OP_VEC_LOAD, instr->operand);
+            break;
+        case IR_VEC_SPLAT:
+            emit(p, OP_VEC_SPLAT, instr->operand);
+            break;
+        case IR_VEC_ADD:
+            emit(p, OP_VEC_ADD, instr->operand);
+            break;
+        case IR_VEC_SUB:
+            emit(p, OP_VEC_SUB, instr->operand);
+            break;
+        case IR_VEC_STORE:
+            emit(p, OP_VEC_STORE, instr->operand);
+            break;
+        case IR_VEC_ALIAS:
+            emit(p, OP_VEC_ALIAS, instr->operand);
+            break;
+        case IR_VEC_END:
+            break;
+        case IR_MALLOC:
+            if (options.heap_profile) {
+                emit(p, OP_PROF_ALLOC, instr->operand)->ptr = (void*)heap_site(p, instr->label);
+            } else {
+                emit(p, OP_MALLOC, instr->operand)->ptr =
+                    options.pool_alloc ? (void*)jive_alloc : (void*)malloc;
+            }
+            break;
+        case IR_FRAME_ADDR:
+            emit(p, OP_FRAME_ADDR, instr->operand);
+            break;
+        case IR_REGION_ENTER:
+            emit(p, OP_REGION_ENTER, 0);
+            break;
+        case IR_REGION_EXIT:
+            emit(p, OP_REGION_EXIT, 0);
+            break;
+        case IR_REGION_ALLOC:
+            emit(p, OP_REGION_ALLOC, instr->operand);
+            break;
+        case IR_FREE:
+            if (options.heap_profile) {
+                emit(p, OP_PROF_FREE, instr->operand)->ptr = (void*)heap_site(p, instr->label);
+            } else {
+                emit(p, OP_FREE, instr->operand)->ptr =
+                    options.pool_alloc ? (void*)jive_free : (void*)free;
+            }
+            break;
+        case IR_HEAP_SITE:
+            emit(p, OP_HEAP_SITE, 0)->ptr = (void*)heap_site(p, instr->label);
+            break;
+    }
+    return n1;
+}
+
+// Run threaded code from pc until HALT. Called with pc == NULL, it fills
+// handlers with the address of each op's code instead.
+static long execute(InterpInsn* pc, long* stack, const void** handlers) {
+    static const void* const op_handlers[OP_COUNT] = {
+        [OP_PUSH] = &&op_push, [OP_POP] = &&op_pop,
+        [OP_ADD] = &&op_add, [OP_SUB] = &&op_sub, [OP_MUL] = &&op_mul, [OP_DIV] = &&op_div,
+        [OP_MULI] = &&op_muli, [OP_DIVI] = &&op_divi,
+        [OP_LOAD] = &&op_load, [OP_STORE] = &&op_store,
+        [OP_ENTER] = &&op_enter, [OP_PARAM] = &&op_param,
+        [OP_CALL] = &&op_call, [OP_CALL_C] = &&op_call_c,
+        [OP_TAILCALL] = &&op_tailcall, [OP_TAILCALL_C] = &&op_tailcall_c,
+        [OP_RET] = &&op_ret, [OP_HALT] = &&op_halt,
+        [OP_JMP] = &&op_jmp, [OP_JZ] = &&op_jz, [OP_JNZ] = &&op_jnz,
+        [OP_EQ] = &&op_eq, [OP_NE] = &&op_ne, [OP_LT] = &&op_lt,
+        [OP_GT] = &&op_gt, [OP_LE] = &&op_le, [OP_GE] = &&op_ge,
+        [OP_BR_EQ] = &&op_br_eq, [OP_BR_NE] = &&op_br_ne, [OP_BR_LT] = &&op_br_lt,
+        [OP_BR_GT] = &&op_br_gt, [OP_BR_LE] = &&op_br_le, [OP_BR_GE] = &&op_br_ge,
+        [OP_BRI_EQ] = &&op_bri_eq, [OP_BRI_NE] = &&op_bri_ne, [OP_BRI_LT] = &&op_bri_lt,
+        [OP_BRI_GT] = &&op_bri_gt, [OP_BRI_LE] = &&op_bri_le, [OP_BRI_GE] = &&op_bri_ge,
+        [OP_PRINT_INT] = &&op_print_int, [OP_PRINT_STR] = &&op_print_str,
+        [OP_STR_LEN] = &&op_str_len,
+        [OP_INDEX_LOAD] = &&op_index_load, [OP_INDEX_STORE] = &&op_index_store,
+        [OP_VEC_LOAD] = &&op_vec_load, [OP_VEC_SPLAT] = &&op_vec_splat,
+        [OP_VEC_ADD] = &&op_vec_add, [OP_VEC_SUB] = &&op_vec_sub,
+        [OP_VEC_STORE] = &&op_vec_store, [OP_VEC_ALIAS] = &&op_vec_alias,
+        [OP_MALLOC] = &&op_malloc, [OP_PROF_ALLOC] = &&op_prof_alloc,
+        [OP_FRAME_ADDR] = &&op_frame_addr,
+        [OP_REGION_ENTER] = &&op_region_enter, [OP_REGION_EXIT] = &&op_region_exit,
+        [OP_REGION_ALLOC] = &&op_region_alloc,
+        [OP_FREE] = &&op_free, [OP_PROF_FREE] = &&op_prof_free,
+        [OP_HEAP_SITE] = &&op_heap_site,
+        [OP_ADDI] = &&op_addi, [OP_LOAD2] = &&op_load2, [OP_STOREI] = &&op_storei,
+        [OP_INC] = &&op_inc,
+    };
+    if (!pc) {
+        memcpy(handlers, op_handlers, sizeof(op_handlers));
+        return 0;
+    }
+
+    // The stack grows down like the native one, and frames have the native
+    // layout: saved frame pointer at bp[0], return address at bp[1], stack
+    // arguments from bp[2] and locals below bp. Signed overflow wraps as in
+    // the generated code, so arithmetic goes through unsigned long.
+    long* sp = stack + INTERP_STACK_SLOTS;
+    long* bp = NULL;
+    long* stack_limit = stack + INTERP_STACK_RESERVE;
+    long regs[MAX_REG_PARAMS] = {0};
+    long vec[INTERP_VEC_REGS][4];
+    int vec_top = 0;
+    long a, b;
+    InterpInsn* ret;
+
+#define PUSH(v) (*--sp = (long)(v))
+#define POP() (*sp++)
+#define NEXT() goto *(++pc)->handler
+#define JUMP(t) do { pc = (t); goto *pc->handler; } while (0)
+
+    goto *pc->handler;
+
+op_push:
+    PUSH(pc->a);
+    NEXT();
+op_pop:
+    sp++;
+    NEXT();
+op_add:
+    b = POP();
+    sp[0] = (long)((unsigned long)sp[0] + (unsigned long)b);
+    NEXT();
+op_sub:
+    b = POP();
+    sp[0] = (long)((unsigned long)sp[0] - (unsigned long)b);
+    NEXT();
+op_mul:
+    b = POP();
+    sp[0] = (long)((unsigned long)sp[0] * (unsigned long)b);
+    NEXT();
+op_div:
+    b = POP();
+    sp[0] = sp[0] / b;
+    NEXT();
+op_muli:
+    sp[0] = (long)((unsigned long)sp[0] * (unsigned long)pc->a);
+    NEXT();
+op_divi:
+    // x / -1 wraps for the most negative value, like the native sequence
+    sp[0] = pc->a == -1 ? (long)(0 - (unsigned long)sp[0]) : sp[0] / pc->a;
+    NEXT();
+op_load:
+    PUSH(bp[pc->a]);
+    NEXT();
+op_store:
+    bp[pc->a] = POP();
+    NEXT();
+op_enter:
+    PUSH(bp);
+    bp = sp;
+    sp -= pc->a;
+    if (sp < stack_limit) {
+        fprintf(stderr, "Error: interp: stack overflow\n");
+        jive_exit(1);
+    }
+    NEXT();
+op_param:
+    bp[pc->a] = regs[pc->b];
+    NEXT();
+op_call:
+    // First argument on top; the rest stay on the stack above the return address
+    for (int i = 0; i < pc->a; i++) {
+        regs[i] = POP();
+    }
+    PUSH(pc + 1);
+    JUMP(pc->target);
+op_call_c:
+    for (int i = 0; i < pc->a; i++) {
+        regs[i] = POP();
+    }
+    PUSH(((CFunction)pc->ptr)(regs[0], regs[1], regs[2], regs[3], regs[4], regs[5]));
+    NEXT();
+op_tailcall:
+    for (int i = 0; i < pc->a; i++) {
+        regs[i] = POP();
+    }
+    sp = bp;
+    bp = (long*)POP();
+    JUMP(pc->target);
+op_tailcall_c:
+    for (int i = 0; i < pc->a; i++) {
+        regs[i] = POP();
+    }
+    sp = bp;
+    bp = (long*)POP();
+    a = ((CFunction)pc->ptr)(regs[0], regs[1], regs[2], regs[3], regs[4], regs[5]);
+    goto return_value;
+op_ret:
+    a = POP();
+    sp = bp;
+    bp = (long*)POP();
+return_value:
+    // Back at the instruction after the call, which drops the stack arguments
+    ret = (InterpInsn*)POP();
+    sp += ret[-1].b;
+    PUSH(a);
+    JUMP(ret);
+op_halt:
+    return POP();
+op_jmp:
+    JUMP(pc->target);
+op_jz:
+    if (POP() == 0) JUMP(pc->target);
+    NEXT();
+op_jnz:
+    if (POP() != 0) JUMP(pc->target);
+    NEXT();
+
+#define COMPARE(name, op)                              \
+op_##name:                                             \
+    b = POP();                                         \
+    sp[0] = sp[0] op b;                                \
+    NEXT();                                            \
+op_br_##name:                                          \
+    b = POP();                                         \
+    a = POP();                                         \
+    if (a op b) JUMP(pc->target);                      \
+    NEXT();                                            \
+op_bri_##name:                                         \
+    a = POP();                                         \
+    if (a op pc->a) JUMP(pc->target);                  \
+    NEXT();
+
+    COMPARE(eq, ==)
+    COMPARE(ne, !=)
+    COMPARE(lt, <)
+    COMPARE(gt, >)
+    COMPARE(le, <=)
+    COMPARE(ge, >=)
+#undef COMPARE
+
+op_print_int:
+    jive_print_int(POP());
+    NEXT();
+op_print_str:
+    a = POP();
+    jive_print_str((const char*)a, pc->a >= 0 ? pc->a : jive_str_len((const char*)a));
+    NEXT();
+op_str_len:
+    sp[0] = jive_str_len((const char*)sp[0]);
+    NEXT();
+op_index_load: {
+    b = POP();
+    long* base = (long*)sp[0];
+    if (pc->a && (unsigned long)b >= (unsigned long)base[-1]) {
+        jive_bounds_error(b, base[-1]);
+    }
+    sp[0] = base[b];
+    NEXT();
+}
+op_index_store: {
+    a = POP();
+    b = POP();
+    long* base = (long*)POP();
+    if (pc->a && (unsigned long)b >= (unsigned long)base[-1]) {
+        jive_bounds_error(b, base[-1]);
+    }
+    base[b] = a;
+    NEXT();
+}
+op_vec_load:
+    b = POP();
+    a = POP();
+    memcpy(vec[vec_top++], (long*)a + b, pc->a * sizeof(long));
+    NEXT();
+op_vec_splat:
+    a = POP();
+    for (int i = 0; i < pc->a; i++) {
+        vec[vec_top][i] = a;
+    }
+    vec_top++;
+    NEXT();
+op_vec_add:
+    vec_top--;
+    for (int i = 0; i < pc->a; i++) {
+        vec[vec_top - 1][i] = (long)((unsigned long)vec[vec_top - 1][i] + (unsigned long)vec[vec_top][i]);
+    }
+    NEXT();
+op_vec_sub:
+    vec_top--;
+    for (int i = 0; i < pc->a; i++) {
+        vec[vec_top - 1][i] = (long)((unsigned long)vec[vec_top - 1][i] - (unsigned long)vec[vec_top][i]);
+    }
+    NEXT();
+op_vec_store:
+    vec_top--;
+    b = POP();
+    a = POP();
+    memcpy((long*)a + b, vec[vec_top], pc->a * sizeof(long));
+    NEXT();
+op_vec_alias: {
+    // Equal pointers, or at least operand bytes apart
+    b = POP();
+    unsigned long distance = (unsigned long)sp[0] - (unsigned long)b;
+    if ((long)distance < 0) {
+        distance = 0 - distance;
+    }
+    sp[0] = distance - 1 >= (unsigned long)(pc->a - 1);
+    NEXT();
+}
+op_malloc:
+    a = pc->a >= 0 ? pc->a : POP();
+    PUSH(((void* (*)(long))pc->ptr)(a));
+    NEXT();
+op_prof_alloc:
+    a = pc->a >= 0 ? pc->a : POP();
+    PUSH(jive_prof_alloc(a, pc->ptr));
+    NEXT();
+op_frame_addr:
+    PUSH((char*)bp + pc->a);
+    NEXT();
+op_region_enter:
+    jive_region_enter();
+    NEXT();
+op_region_exit:
+    jive_region_exit();
+    NEXT();
+op_region_alloc:
+    a = pc->a >= 0 ? pc->a : POP();
+    PUSH(jive_region_alloc(a));
+    NEXT();
+op_free: {
+    void* ptr = (void*)POP();
+    if (pc->a) {
+        ptr = jive_region_filter(ptr);
+    }
+    ((void (*)(void*))pc->ptr)(ptr);
+    NEXT();
+}
+op_prof_free: {
+    void* ptr = (void*)POP();
+    if (pc->a) {
+        ptr = jive_region_filter(ptr);
+    }
+    jive_prof_free(ptr, pc->ptr);
+    NEXT();
+}
+op_heap_site:
+    jive_heap_site = pc->ptr;
+    NEXT();
+op_addi:
+    sp[0] = (long)((unsigned long)sp[0] + (unsigned long)pc->a);
+    NEXT();
+op_load2:
+    sp -= 2;
+    sp[1] = bp[pc->a];
+    sp[0] = bp[pc->b];
+    NEXT();
+op_storei:
+    bp[pc->b] = pc->a;
+    NEXT();
+op_inc:
+    bp[pc->a] = (long)((unsigned long)bp[pc->a] + (unsigned long)pc->b);
+    NEXT();
+
+#undef PUSH
+#undef POP
+#undef NEXT
+#undef JUMP
+}
+
+InterpProgram* interp_translate(IRProgram* program) {
+    if (options.profile_generate) {
+        fprintf(stderr, "Error: interp: -fprofile-generate needs native code\n");
+        exit(1);
+    }
+    InterpProgram* p = calloc(1, sizeof(InterpProgram));
+
+    // Functions are labels followed by a prologue; everything else called is C
+    for (IRInstruction* instr = program->head; instr; instr = instr->next) {
+        if (instr->op == IR_LABEL && is(instr->next, IR_ENTER)) {
+            find_label(instr->label, 1)->function = 1;
+        }
+    }
+    LabelEntry* main_label = find_label("_main", 0);
+    if (!main_label || !main_label->function) {
+        fprintf(stderr, "Error: interp: program has no main function\n");
+        exit(1);
+    }
+
+    // Entry: call main and stop with its result
+    emit_jump(p, OP_CALL, 0, "_main");
+    emit(p, OP_HALT, 0);
+
+    // The hot code before a COLD_BEGIN falls through to what follows the
+    // matching COLD_END, so cold code goes after its function, as in the
+    // native backend
+    IRInstruction** cold = NULL;
+    int cold_count = 0, cold_capacity = 0;
+    for (IRInstruction* instr = program->head; ; ) {
+        if (cold_count && (!instr || (instr->op == IR_LABEL && is(instr->next, IR_ENTER)))) {
+            for (int i = 0; i < cold_count; i++) {
+                for (IRInstruction* c = cold[i]->next; c && c->op != IR_COLD_END; ) {
+                    c = translate(p, c);
+                }
+            }
+            cold_count = 0;
+        }
+        if (!instr) {
+            break;
+        }
+        if (instr->op == IR_COLD_BEGIN) {
+            if (cold_count == cold_capacity) {
+                cold_capacity = cold_capacity ? cold_capacity * 2 : 16;
+                cold = realloc(cold, cold_capacity * sizeof(IRInstruction*));
+            }
+            cold[cold_count++] = instr;
+            while (instr && instr->op != IR_COLD_END) {
+                instr = instr->next;
+            }
+            instr = instr ? instr->next : NULL;
+            continue;
+        }
+        instr = translate(p, instr);
+    }
+    free(cold);
+
+    const void* handlers[OP_COUNT];
+    execute(NULL, NULL, handlers);
+    for (int i = 0; i < p->count; i++) {
+        InterpInsn* insn = &p->code[i];
+        insn->handler = handlers[insn->op];
+        if (target_labels[i]) {
+            LabelEntry* target = find_label(target_labels[i], 0);
+            if (!target || target->index < 0 || target->index >= p->count) {
+                interp_error("undefined label", target_labels[i]);
+            }
+            insn->target = &p->code[target->index];
+        }
+    }
+    free(target_labels);
+    target_labels = NULL;
+    free_entries(labels);
+    free_entries(sites);
+    return p;
+}
+
+long interp_run(InterpProgram* code) {
+    long* stack = malloc(INTERP_STACK_SLOTS * sizeof(long));
+    if (!stack) {
+        fprintf(stderr, "Error: interp: cannot allocate the stack\n");
+        exit(1);
+    }
+    long result = execute(code->code, stack, NULL);
+    free(stack);
+    return result;
+}
+
+void interp_free(InterpProgram* code) {
+    while (code->blocks) {
+        InterpBlock* next = code->blocks->next;
+        free(code->blocks);
+        code->blocks = next;
+    }
+    free(code->code);
+    free(code);
+}
+
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+void run_interpreter(IRProgram* program, const struct timespec* compile_start) {
+    struct timespec translate_start, run_start, run_end;
+    clock_gettime(CLOCK_MONOTONIC, &translate_start);
+    InterpProgram* code = interp_translate(program);
+
+    // Compiler reports go out before the program's own output
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    long status = interp_run(code);
+    jive_flush();
+    clock_gettime(CLOCK_MONOTONIC, &run_end);
+
+    fprintf(stderr, "interp: compiled in %.3f ms (translate %.3f ms, %d instructions), ran in %.3f ms\n",
+            elapsed_ms(compile_start, &run_start), elapsed_ms(&translate_start, &run_start),
+            code->count, elapsed_ms(&run_start, &run_end));
+    // The heap profile names its sites with strings the translated code owns
+    if (options.heap_profile) {
+        jive_prof_report();
+    }
+    interp_free(code);
+    jive_exit(status);
+}
@@ -0,0 +1,20 @@
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <time.h>
+#include "stack_machine_ir.h"
+
+// Direct-threaded interpreter for the stack-machine IR. Translation resolves
+// labels to instruction addresses and fuses common op sequences into
+// superinstructions; execution dispatches with computed goto.
+typedef struct InterpProgram InterpProgram;
+
+InterpProgram* interp_translate(IRProgram* program);  // Exits with an error on failure
+long interp_run(InterpProgram* code);                 // Calls main, returns its result
+void interp_free(InterpProgram* code);
+
+// --interp: translate and run program, report translate and run time on
+// stderr, and exit with main's return value
+void run_interpreter(IRProgram* program, const struct timespec* compile_start);
+
+#endif // INTERP_H
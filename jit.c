@@ -0,0 +1,222 @@
+#define _GNU_SOURCE  // RTLD_DEFAULT
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "jit.h"
+#include "stack_machine.h"
+#include "assembler.h"
+#include "runtime.h"
+
+#define PAGE_SIZE 4096
+#define STUB_SIZE 16   // jmp [rip + 0]; dq target; padding
+#define REL32_REACH 0x7fff0000L
+
+// The loaded image: .text, .text.unlikely and the call stubs, then .rodata,
+// .data and .bss, each starting on its own page so it can get its own
+// protection
+typedef struct {
+    uint8_t* base;
+    size_t size;
+    size_t offsets[SECTION_COUNT];
+    size_t stub_offset;
+    int stub_count;
+    int* stubs;  // Stub index + 1 per symbol, 0 if it has none yet
+} JitImage;
+
+static void jit_error(const char* message, const char* detail) {
+    fprintf(stderr, "Error: jit: %s '%s'\n", message, detail);
+    exit(1);
+}
+
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static size_t page_round(size_t n) {
+    return (n + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+}
+
+static int within_rel32(uintptr_t a, uintptr_t b) {
+    return (a > b ? a - b : b - a) < (uintptr_t)REL32_REACH;
+}
+
+// rip-relative references to runtime data (pool free lists, region bump
+// pointer) need the code within 2 GiB of the compiler's own image, so try a
+// few addresses around it before taking whatever the kernel picks
+static uint8_t* map_near(size_t size, uintptr_t anchor) {
+    static const long hints[] = {-(256L << 20), 256L << 20, -(1L << 30), 1L << 30};
+    uint8_t* base = MAP_FAILED;
+    for (size_t i = 0; i < sizeof(hints) / sizeof(hints[0]); i++) {
+        uintptr_t hint = (anchor + hints[i]) & ~(uintptr_t)(PAGE_SIZE - 1);
+        base = mmap((void*)hint, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            continue;
+        }
+        if (within_rel32((uintptr_t)base, anchor) &&
+            within_rel32((uintptr_t)base + size, anchor)) {
+            return base;
+        }
+        munmap(base, size);
+    }
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Error: jit: cannot map %zu bytes\n", size);
+        exit(1);
+    }
+    return base;
+}
+
+static uintptr_t symbol_address(AsmObject* obj, JitImage* image, int index) {
+    AsmSymbol* sym = &obj->symbols[index];
+    if (sym->section >= 0) {
+        return (uintptr_t)image->base + image->offsets[sym->section] + sym->value;
+    }
+    // Runtime functions and data are exported from the compiler (-rdynamic);
+    // C library functions come from libc
+    void* address = dlsym(RTLD_DEFAULT, sym->name);
+    if (!address) {
+        jit_error("undefined symbol", sym->name);
+    }
+    return (uintptr_t)address;
+}
+
+// Calls to functions out of rel32 range (libc) go through an absolute jump
+static uintptr_t call_stub(JitImage* image, int index, uintptr_t target) {
+    if (!image->stubs[index]) {
+        uint8_t* stub = image->base + image->stub_offset + (size_t)image->stub_count * STUB_SIZE;
+        static const uint8_t jmp_indirect[] = {0xFF, 0x25, 0, 0, 0, 0};
+        memcpy(stub, jmp_indirect, sizeof(jmp_indirect));
+        memcpy(stub + sizeof(jmp_indirect), &target, sizeof(target));
+        image->stubs[index] = ++image->stub_count;
+    }
+    return (uintptr_t)image->base + image->stub_offset + (size_t)(image->stubs[index] - 1) * STUB_SIZE;
+}
+
+static void apply_relocations(AsmObject* obj, JitImage* image) {
+    for (int i = 0; i < obj->reloc_count; i++) {
+        AsmReloc* r = &obj->relocs[i];
+        uint8_t* field = image->base + image->offsets[r->section] + r->offset;
+        uintptr_t target = symbol_address(obj, image, r->symbol);
+        if (r->type == RELOC_ABS64) {
+            uint64_t value = target + r->addend;
+            memcpy(field, &value, sizeof(value));
+            continue;
+        }
+        if (r->type == RELOC_PLT32 && !within_rel32(target, (uintptr_t)field)) {
+            target = call_stub(image, r->symbol, target);
+        }
+        int64_t value = (int64_t)(target + r->addend - (uintptr_t)field);
+        if (value != (int32_t)value) {
+            jit_error("rip-relative reference out of range for", obj->symbols[r->symbol].name);
+        }
+        int32_t value32 = (int32_t)value;
+        memcpy(field, &value32, sizeof(value32));
+    }
+}
+
+static void load_image(AsmObject* obj, JitImage* image) {
+    int externs = 0;
+    for (int i = 0; i < obj->symbol_count; i++) {
+        if (obj->symbols[i].section < 0) {
+            externs++;
+        }
+    }
+    size_t offset;
+    image->offsets[SECTION_TEXT] = 0;
+    image->offsets[SECTION_TEXT_UNLIKELY] = (obj->sections[SECTION_TEXT].size + 15) & ~(size_t)15;
+    image->stub_offset = (image->offsets[SECTION_TEXT_UNLIKELY] + obj->sections[SECTION_TEXT_UNLIKELY].size +
+                          STUB_SIZE - 1) & ~(size_t)(STUB_SIZE - 1);
+    offset = page_round(image->stub_offset + (size_t)externs * STUB_SIZE);
+    for (int s = SECTION_RODATA; s < SECTION_COUNT; s++) {
+        image->offsets[s] = offset;
+        offset = page_round(offset + obj->sections[s].size);
+    }
+    image->size = offset ? offset : PAGE_SIZE;
+    image->base = map_near(image->size, (uintptr_t)&jive_exit);
+    image->stub_count = 0;
+    image->stubs = calloc(obj->symbol_count + 1, sizeof(int));
+
+    // .bss stays as the zero pages mmap gave us
+    for (int s = 0; s < SECTION_BSS; s++) {
+        if (obj->sections[s].size) {
+            memcpy(image->base + image->offsets[s], obj->sections[s].bytes, obj->sections[s].size);
+        }
+    }
+    apply_relocations(obj, image);
+
+    // W^X: code becomes executable only once it can no longer be written
+    size_t text_size = image->offsets[SECTION_RODATA];
+    size_t rodata_size = image->offsets[SECTION_DATA] - image->offsets[SECTION_RODATA];
+    if (mprotect(image->base, text_size, PROT_READ | PROT_EXEC) != 0 ||
+        (rodata_size && mprotect(image->base + image->offsets[SECTION_RODATA], rodata_size, PROT_READ) != 0)) {
+        perror("Error: jit: mprotect");
+        exit(1);
+    }
+}
+
+// perf looks up samples in anonymous executable memory by address in
+// /tmp/perf-<pid>.map: one "start size name" line per function, in hex
+static void write_perf_map(AsmObject* obj, JitImage* image) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Error: jit: cannot write '%s'\n", path);
+        return;
+    }
+    for (int i = 0; i < obj->symbol_count; i++) {
+        AsmSymbol* sym = &obj->symbols[i];
+        if (sym->function && sym->section == SECTION_TEXT) {
+            fprintf(f, "%lx %zx %s\n", (unsigned long)symbol_address(obj, image, i), sym->size, sym->name);
+        }
+    }
+    if (image->stub_count) {
+        fprintf(f, "%lx %x jit_call_stubs\n", (unsigned long)(image->base + image->stub_offset),
+                image->stub_count * STUB_SIZE);
+    }
+    fclose(f);
+}
+
+JitFunction jit_compile(IRProgram* program, int perf_map) {
+    AsmObject* obj = assemble_program(program);
+    int main_index = find_asm_symbol(obj, "_main");
+    if (main_index < 0 || obj->symbols[main_index].section != SECTION_TEXT) {
+        fprintf(stderr, "Error: jit: program has no main function\n");
+        exit(1);
+    }
+    JitImage image;
+    load_image(obj, &image);
+    JitFunction entry = (JitFunction)symbol_address(obj, &image, main_index);
+    int pgo_index = find_asm_symbol(obj, "jive_pgo_table");
+    if (pgo_index >= 0) {
+        jive_pgo_set_table((const void*)symbol_address(obj, &image, pgo_index));
+    }
+    if (perf_map) {
+        write_perf_map(obj, &image);
+    }
+    free_asm_object(obj);
+    free(image.stubs);
+    return entry;
+}
+
+void run_jit(IRProgram* program, const struct timespec* compile_start, int perf_map) {
+    struct timespec assemble_start, run_start, run_end;
+    clock_gettime(CLOCK_MONOTONIC, &assemble_start);
+    JitFunction entry = jit_compile(program, perf_map);
+
+    // Compiler reports go out before the program's own output
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    long status = entry();
+    jive_flush();
+    clock_gettime(CLOCK_MONOTONIC, &run_end);
+
+    fprintf(stderr, "jit: compiled in %.3f ms (assemble and load %.3f ms), ran in %.3f ms\n",
+            elapsed_ms(compile_start, &run_start), elapsed_ms(&assemble_start, &run_start),
+            elapsed_ms(&run_start, &run_end));
+    jive_exit(status);
+}
@@ -0,0 +1,20 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <time.h>
+#include "stack_machine_ir.h"
+
+typedef long (*JitFunction)(void);
+
+// Assemble program into executable memory and return its main. The code
+// stays mapped for the life of the process.
+JitFunction jit_compile(IRProgram* program, int perf_map);
+
+// --run: assemble program into executable memory in this process, resolve its
+// externs to the runtime linked into the compiler and to libc, call _main and
+// exit with its return value. Compile latency (measured from compile_start)
+// and run time are reported on stderr. With perf_map, the loaded functions are
+// listed in /tmp/perf-<pid>.map for perf.
+void run_jit(IRProgram* program, const struct timespec* compile_start, int perf_map);
+
+#endif // JIT_H
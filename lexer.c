@@ -150,6 +150,14 @@ Token* next_token() {
             free(value);
             return make_token(TOKEN_STRING, NULL);
         }
+        if (is_keyword(value, "builder")) {
+            free(value);
+            return make_token(TOKEN_BUILDER, NULL);
+        }
+        if (is_keyword(value, "array")) {
+            free(value);
+            return make_token(TOKEN_ARRAY, NULL);
+        }
         if (is_keyword(value, "print")) {
             free(value);
             return make_token(TOKEN_PRINT, NULL);
@@ -162,6 +170,10 @@ Token* next_token() {
             free(value);
             return make_token(TOKEN_FREE, NULL);
         }
+        if (is_keyword(value, "region")) {
+            free(value);
+            return make_token(TOKEN_REGION, NULL);
+        }
         
         return make_token(TOKEN_IDENT, value);
     }
@@ -222,6 +234,10 @@ Token* next_token() {
             return make_token(TOKEN_LBRACE, NULL);
         case '}':
             return make_token(TOKEN_RBRACE, NULL);
+        case '[':
+            return make_token(TOKEN_LBRACKET, NULL);
+        case ']':
+            return make_token(TOKEN_RBRACKET, NULL);
         case ':':
             return make_token(TOKEN_COLON, NULL);
         case ';':
@@ -17,9 +17,12 @@ typedef enum {
     TOKEN_WHILE,
     TOKEN_INT,
     TOKEN_STRING,
+    TOKEN_BUILDER,
+    TOKEN_ARRAY,
     TOKEN_PRINT,
     TOKEN_MALLOC,
     TOKEN_FREE,
+    TOKEN_REGION,
     
     // Operators
     TOKEN_PLUS,
@@ -41,6 +44,8 @@ typedef enum {
     TOKEN_RPAREN,
     TOKEN_LBRACE,
     TOKEN_RBRACE,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
     TOKEN_COLON,
     TOKEN_SEMICOLON,
     TOKEN_COMMA,
@@ -0,0 +1,592 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loop_opt.h"
+#include "options.h"
+
+#define MAX_REDUCED 16
+#define TYPE_BUCKETS 256
+#define TYPE_UNKNOWN (-1)  // Declared with different types in the function
+
+// Loop being optimized and the statements collected for its preheader
+typedef struct {
+    ASTNode* loop;
+    ASTNode* preheader;
+    ASTNode* preheader_tail;
+
+    // Strength reduction state for the current induction variable
+    const char* iv_name;
+    int reduced_factor[MAX_REDUCED];
+    char* reduced_name[MAX_REDUCED];
+    int reduced_count;
+} LoopInfo;
+
+typedef ASTNode* (*ExprRewriter)(ASTNode* expr, LoopInfo* info);
+
+// Declared type of each parameter and let of the function being optimized
+typedef struct TypeEntry {
+    const char* name;
+    int type;  // ValueType or TYPE_UNKNOWN
+    struct TypeEntry* next;
+} TypeEntry;
+
+static TypeEntry* var_types[TYPE_BUCKETS];
+
+static int temp_counter = 0;
+static ASTNode* program_ast;
+static int checks_removed;
+
+static char* temp_name(const char* prefix) {
+    char* name = malloc(32);
+    snprintf(name, 32, "%s.%d", prefix, temp_counter++);
+    return name;
+}
+
+static ASTNode* make_var(const char* name) {
+    ASTNode* node = create_ast_node(AST_VAR);
+    node->var_name = strdup(name);
+    return node;
+}
+
+static ASTNode* make_int(int value) {
+    ASTNode* node = create_ast_node(AST_INT_LIT);
+    node->int_value = value;
+    return node;
+}
+
+static ASTNode* make_binop(BinOpType op, ASTNode* left, ASTNode* right) {
+    ASTNode* node = create_ast_node(AST_BINOP);
+    node->binop = op;
+    node->left = left;
+    node->right = right;
+    return node;
+}
+
+static unsigned hash_name(const char* name) {
+    unsigned hash = 5381;
+    for (; *name; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash % TYPE_BUCKETS;
+}
+
+static TypeEntry* find_type(const char* name) {
+    for (TypeEntry* e = var_types[hash_name(name)]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void record_type(const char* name, int type) {
+    TypeEntry* e = find_type(name);
+    if (e) {
+        if (e->type != type) {
+            e->type = TYPE_UNKNOWN;
+        }
+        return;
+    }
+    e = malloc(sizeof(TypeEntry));
+    e->name = name;
+    e->type = type;
+    unsigned bucket = hash_name(name);
+    e->next = var_types[bucket];
+    var_types[bucket] = e;
+}
+
+// Every declaration in a subtree: parameters, lets and inlined bindings
+static void collect_types(ASTNode* node) {
+    if (!node) return;
+    if (node->type == AST_VAR_DECL) {
+        record_type(node->var_name, node->int_value);
+    }
+    collect_types(node->left);
+    collect_types(node->right);
+    collect_types(node->condition);
+    collect_types(node->then_block);
+    collect_types(node->else_block);
+    collect_types(node->body);
+    collect_types(node->params);
+    collect_types(node->args);
+    collect_types(node->next_arg);
+    collect_types(node->statements);
+}
+
+static void free_types(void) {
+    for (int b = 0; b < TYPE_BUCKETS; b++) {
+        while (var_types[b]) {
+            TypeEntry* next = var_types[b]->next;
+            free(var_types[b]);
+            var_types[b] = next;
+        }
+    }
+}
+
+// Static type of an expression as codegen's expr_type sees it: + with a
+// string operand is a concatenation, other arithmetic is int
+static int static_type(ASTNode* expr) {
+    switch (expr->type) {
+        case AST_INT_LIT:
+            return TYPE_INT;
+        case AST_STRING_LIT:
+            return TYPE_STRING;
+        case AST_VAR: {
+            TypeEntry* e = find_type(expr->var_name);
+            return e ? e->type : TYPE_UNKNOWN;
+        }
+        case AST_BINOP: {
+            if (expr->binop != BINOP_PLUS) {
+                return TYPE_INT;
+            }
+            int left = static_type(expr->left);
+            int right = static_type(expr->right);
+            if (left == TYPE_STRING || right == TYPE_STRING) {
+                return TYPE_STRING;
+            }
+            return left == TYPE_UNKNOWN || right == TYPE_UNKNOWN ? TYPE_UNKNOWN : TYPE_INT;
+        }
+        default:
+            return TYPE_UNKNOWN;
+    }
+}
+
+// The temp is declared with the value's type, so codegen treats it as the
+// expression it replaces
+static void add_preheader(LoopInfo* info, const char* name, ASTNode* value) {
+    ASTNode* decl = create_ast_node(AST_VAR_DECL);
+    decl->var_name = strdup(name);
+    decl->int_value = static_type(value);
+    decl->left = value;
+    record_type(decl->var_name, decl->int_value);
+    if (info->preheader_tail) {
+        info->preheader_tail->right = decl;
+    } else {
+        info->preheader = decl;
+    }
+    info->preheader_tail = decl;
+}
+
+// Number of assignments/declarations of name in a subtree. Locals can only be
+// written by name, so calls inside the loop never change them.
+static int count_assigns(ASTNode* node, const char* name) {
+    if (!node) return 0;
+    int count = 0;
+    if ((node->type == AST_ASSIGN || node->type == AST_VAR_DECL) &&
+        strcmp(node->var_name, name) == 0) {
+        count = 1;
+    }
+    return count + count_assigns(node->left, name) + count_assigns(node->right, name) +
+           count_assigns(node->condition, name) + count_assigns(node->then_block, name) +
+           count_assigns(node->else_block, name) + count_assigns(node->body, name) +
+           count_assigns(node->params, name) + count_assigns(node->args, name) +
+           count_assigns(node->next_arg, name) + count_assigns(node->statements, name);
+}
+
+static int loop_assigns(ASTNode* loop, const char* name) {
+    return count_assigns(loop->condition, name) + count_assigns(loop->body, name);
+}
+
+// Pure arithmetic over constants and variables the loop never writes. Division
+// is only moved when the divisor is a non-zero literal, since the preheader
+// runs even if the division inside the loop never would. + on strings is a
+// call that allocates a new string each time, so only int sums move.
+static int is_invariant(ASTNode* expr, ASTNode* loop) {
+    switch (expr->type) {
+        case AST_INT_LIT:
+            return 1;
+        case AST_VAR:
+            return loop_assigns(loop, expr->var_name) == 0;
+        case AST_BINOP:
+            if (expr->binop == BINOP_DIV &&
+                (expr->right->type != AST_INT_LIT || expr->right->int_value == 0)) {
+                return 0;
+            }
+            if (static_type(expr) != TYPE_INT) {
+                return 0;
+            }
+            return is_invariant(expr->left, loop) && is_invariant(expr->right, loop);
+        default:
+            return 0;
+    }
+}
+
+static int reads_var(ASTNode* expr) {
+    if (!expr) return 0;
+    if (expr->type == AST_VAR) return 1;
+    return reads_var(expr->left) || reads_var(expr->right);
+}
+
+static void rewrite_stmts(ASTNode* stmt, ExprRewriter fn, LoopInfo* info);
+
+// Offer every expression to fn, outermost first; a non-NULL result replaces
+// the expression, keeping its place in an argument list
+static void rewrite_expr(ASTNode** slot, ExprRewriter fn, LoopInfo* info) {
+    ASTNode* node = *slot;
+    if (!node) return;
+
+    ASTNode* replacement = fn(node, info);
+    if (replacement) {
+        replacement->next_arg = node->next_arg;
+        node->next_arg = NULL;
+        *slot = replacement;
+        free_ast(node);
+        return;
+    }
+
+    switch (node->type) {
+        case AST_BINOP:
+        case AST_COMPARE:
+            rewrite_expr(&node->left, fn, info);
+            rewrite_expr(&node->right, fn, info);
+            break;
+        case AST_MALLOC:
+        case AST_INDEX:
+            rewrite_expr(&node->left, fn, info);
+            break;
+        case AST_CALL_EXPR: {
+            ASTNode** arg = &node->args;
+            while (*arg) {
+                rewrite_expr(arg, fn, info);
+                arg = &(*arg)->next_arg;
+            }
+            break;
+        }
+        case AST_INLINE:
+            rewrite_stmts(node->params, fn, info);
+            rewrite_stmts(node->body, fn, info);
+            break;
+        default:
+            break;
+    }
+}
+
+static void rewrite_stmts(ASTNode* stmt, ExprRewriter fn, LoopInfo* info) {
+    while (stmt) {
+        switch (stmt->type) {
+            case AST_VAR_DECL:
+            case AST_ASSIGN:
+            case AST_RETURN:
+            case AST_PRINT:
+            case AST_FREE:
+                rewrite_expr(&stmt->left, fn, info);
+                break;
+            case AST_INDEX_ASSIGN:
+                rewrite_expr(&stmt->condition, fn, info);
+                rewrite_expr(&stmt->left, fn, info);
+                break;
+            case AST_CALL_STMT: {
+                ASTNode** arg = &stmt->args;
+                while (*arg) {
+                    rewrite_expr(arg, fn, info);
+                    arg = &(*arg)->next_arg;
+                }
+                break;
+            }
+            case AST_INLINE:
+                rewrite_stmts(stmt->params, fn, info);
+                rewrite_stmts(stmt->body, fn, info);
+                break;
+            case AST_IF:
+                rewrite_expr(&stmt->condition, fn, info);
+                rewrite_stmts(stmt->then_block, fn, info);
+                rewrite_stmts(stmt->else_block, fn, info);
+                break;
+            case AST_WHILE:
+                rewrite_expr(&stmt->condition, fn, info);
+                rewrite_stmts(stmt->body, fn, info);
+                break;
+            case AST_BLOCK:
+                rewrite_stmts(stmt->statements, fn, info);
+                break;
+            case AST_REGION:
+                rewrite_stmts(stmt->body, fn, info);
+                break;
+            default:
+                break;
+        }
+        stmt = stmt->right;
+    }
+}
+
+static ASTNode* hoist_invariant(ASTNode* expr, LoopInfo* info) {
+    if (expr->type != AST_BINOP || !reads_var(expr) || !is_invariant(expr, info->loop)) {
+        return NULL;
+    }
+    char* name = temp_name("licm");
+    add_preheader(info, name, clone_ast(expr));
+    ASTNode* var = make_var(name);
+    free(name);
+    return var;
+}
+
+static ASTNode* reduce_multiply(ASTNode* expr, LoopInfo* info) {
+    if (expr->type != AST_BINOP || expr->binop != BINOP_MULT) {
+        return NULL;
+    }
+    ASTNode* var = expr->left;
+    ASTNode* lit = expr->right;
+    if (var->type == AST_INT_LIT) {
+        var = expr->right;
+        lit = expr->left;
+    }
+    if (var->type != AST_VAR || lit->type != AST_INT_LIT ||
+        strcmp(var->var_name, info->iv_name) != 0) {
+        return NULL;
+    }
+
+    for (int i = 0; i < info->reduced_count; i++) {
+        if (info->reduced_factor[i] == lit->int_value) {
+            return make_var(info->reduced_name[i]);
+        }
+    }
+    if (info->reduced_count >= MAX_REDUCED) {
+        return NULL;
+    }
+
+    // Derived variable starts at iv * k before the loop
+    char* name = temp_name("sr");
+    add_preheader(info, name, clone_ast(expr));
+    info->reduced_factor[info->reduced_count] = lit->int_value;
+    info->reduced_name[info->reduced_count] = name;
+    info->reduced_count++;
+    return make_var(name);
+}
+
+// i = i + c or i = i - c (c a literal) is an induction step when it is the
+// only write to i in the loop and sits directly in the body, so it runs
+// exactly once per iteration
+static int induction_step(ASTNode* stmt, ASTNode* loop, int* step) {
+    if (stmt->type != AST_ASSIGN || stmt->left->type != AST_BINOP) {
+        return 0;
+    }
+    ASTNode* expr = stmt->left;
+    ASTNode* var = expr->left;
+    ASTNode* lit = expr->right;
+    if (expr->binop == BINOP_PLUS && var->type == AST_INT_LIT) {
+        var = expr->right;
+        lit = expr->left;
+    }
+    if ((expr->binop != BINOP_PLUS && expr->binop != BINOP_MINUS) ||
+        var->type != AST_VAR || lit->type != AST_INT_LIT ||
+        strcmp(var->var_name, stmt->var_name) != 0 ||
+        loop_assigns(loop, stmt->var_name) != 1) {
+        return 0;
+    }
+    *step = expr->binop == BINOP_PLUS ? lit->int_value : -lit->int_value;
+    return 1;
+}
+
+static void strength_reduce(LoopInfo* info) {
+    ASTNode* stmt = info->loop->body->statements;
+    while (stmt) {
+        int step;
+        if (induction_step(stmt, info->loop, &step)) {
+            info->iv_name = stmt->var_name;
+            info->reduced_count = 0;
+            rewrite_expr(&info->loop->condition, reduce_multiply, info);
+            rewrite_stmts(info->loop->body, reduce_multiply, info);
+
+            // Advance each derived variable right after the induction step
+            for (int i = 0; i < info->reduced_count; i++) {
+                ASTNode* update = create_ast_node(AST_ASSIGN);
+                update->var_name = strdup(info->reduced_name[i]);
+                update->left = make_binop(BINOP_PLUS, make_var(info->reduced_name[i]),
+                                          make_int(step * info->reduced_factor[i]));
+                update->right = stmt->right;
+                stmt->right = update;
+                info->loop->body->stmt_count++;
+                stmt = update;
+                free(info->reduced_name[i]);
+            }
+        }
+        stmt = stmt->right;
+    }
+}
+
+static int is_user_function(const char* name) {
+    for (ASTNode* stmt = program_ast->statements; stmt; stmt = stmt->right) {
+        if (stmt->type == AST_FN_DEF && strcmp(stmt->fn_name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// len(a) of a variable, with len still the builtin
+static const char* len_of(ASTNode* expr) {
+    if (expr->type != AST_CALL_EXPR || strcmp(expr->call_name, "len") != 0 ||
+        !expr->args || expr->args->next_arg || expr->args->type != AST_VAR ||
+        is_user_function("len")) {
+        return NULL;
+    }
+    return expr->args->var_name;
+}
+
+// Whether i holds a non-negative literal when control reaches loop: the last
+// write to i before the loop in its statement list sets it to one, and
+// nothing in between writes i again
+static int starts_non_negative(ASTNode* list, ASTNode* loop, const char* name) {
+    int known = 0;
+    for (ASTNode* stmt = list; stmt && stmt != loop; stmt = stmt->right) {
+        if ((stmt->type == AST_VAR_DECL || stmt->type == AST_ASSIGN) &&
+            strcmp(stmt->var_name, name) == 0) {
+            known = stmt->left->type == AST_INT_LIT && stmt->left->int_value >= 0 &&
+                    count_assigns(stmt->left, name) == 0;
+        } else {
+            ASTNode* next = stmt->right;
+            stmt->right = NULL;  // Keep the walk inside this statement
+            if (count_assigns(stmt, name) > 0) {
+                known = 0;
+            }
+            stmt->right = next;
+        }
+    }
+    return known;
+}
+
+// Mark every a[i] in a subtree as proven in bounds
+static void mark_in_bounds(ASTNode* node, const char* array, const char* index) {
+    if (!node) return;
+    if ((node->type == AST_INDEX || node->type == AST_INDEX_ASSIGN) &&
+        strcmp(node->var_name, array) == 0) {
+        ASTNode* idx = node->type == AST_INDEX ? node->left : node->condition;
+        if (idx->type == AST_VAR && strcmp(idx->var_name, index) == 0 && !node->int_value) {
+            node->int_value = 1;
+            checks_removed++;
+        }
+    }
+    mark_in_bounds(node->left, array, index);
+    mark_in_bounds(node->right, array, index);
+    mark_in_bounds(node->condition, array, index);
+    mark_in_bounds(node->then_block, array, index);
+    mark_in_bounds(node->else_block, array, index);
+    mark_in_bounds(node->body, array, index);
+    mark_in_bounds(node->params, array, index);
+    mark_in_bounds(node->args, array, index);
+    mark_in_bounds(node->next_arg, array, index);
+    mark_in_bounds(node->statements, array, index);
+}
+
+// For while (i < len(a)) with i starting at a non-negative literal and
+// stepping up once per iteration, 0 <= i < len(a) holds in every body
+// statement before the step, so a[i] there needs no bounds check
+static void eliminate_bounds_checks(ASTNode* loop, ASTNode* list) {
+    ASTNode* cond = loop->condition;
+    if (cond->type != AST_COMPARE) {
+        return;
+    }
+    ASTNode* var = cond->left;
+    ASTNode* limit = cond->right;
+    if (cond->compare_op == COMPARE_GT) {
+        var = cond->right;
+        limit = cond->left;
+    } else if (cond->compare_op != COMPARE_LT) {
+        return;
+    }
+    const char* array = len_of(limit);
+    if (var->type != AST_VAR || !array || loop_assigns(loop, array) != 0 ||
+        !starts_non_negative(list, loop, var->var_name)) {
+        return;
+    }
+
+    ASTNode* step_stmt = loop->body->statements;
+    int step = 0;
+    while (step_stmt && !(step_stmt->type == AST_ASSIGN &&
+                          strcmp(step_stmt->var_name, var->var_name) == 0)) {
+        step_stmt = step_stmt->right;
+    }
+    if (!step_stmt || !induction_step(step_stmt, loop, &step) || step <= 0) {
+        return;
+    }
+
+    for (ASTNode* stmt = loop->body->statements; stmt != step_stmt; stmt = stmt->right) {
+        ASTNode* next = stmt->right;
+        stmt->right = NULL;  // Keep the walk inside this statement
+        mark_in_bounds(stmt, array, var->var_name);
+        stmt->right = next;
+    }
+}
+
+static void optimize_loop(ASTNode* loop) {
+    LoopInfo info;
+    memset(&info, 0, sizeof(info));
+    info.loop = loop;
+
+    strength_reduce(&info);
+    rewrite_expr(&loop->condition, hoist_invariant, &info);
+    rewrite_stmts(loop->body, hoist_invariant, &info);
+
+    if (!info.preheader) {
+        return;
+    }
+
+    // Turn the loop node into { preheader...; while (...) {...} } in place so
+    // the enclosing statement list stays linked
+    ASTNode* inner = create_ast_node(AST_WHILE);
+    inner->condition = loop->condition;
+    inner->body = loop->body;
+    inner->profile_key = loop->profile_key;
+    loop->profile_key = NULL;
+    info.preheader_tail->right = inner;
+
+    loop->type = AST_BLOCK;
+    loop->condition = NULL;
+    loop->body = NULL;
+    loop->statements = info.preheader;
+    loop->stmt_count = 0;
+    for (ASTNode* stmt = info.preheader; stmt; stmt = stmt->right) {
+        loop->stmt_count++;
+    }
+}
+
+// Inner loops first, so their preheaders become candidates for the outer loop
+static void optimize_stmts(ASTNode* list) {
+    ASTNode* stmt = list;
+    while (stmt) {
+        switch (stmt->type) {
+            case AST_IF:
+                optimize_stmts(stmt->then_block);
+                optimize_stmts(stmt->else_block);
+                break;
+            case AST_WHILE:
+                optimize_stmts(stmt->body);
+                eliminate_bounds_checks(stmt, list);
+                optimize_loop(stmt);
+                break;
+            case AST_BLOCK:
+                optimize_stmts(stmt->statements);
+                break;
+            case AST_INLINE:
+            case AST_REGION:
+                optimize_stmts(stmt->body);
+                break;
+            default:
+                break;
+        }
+        stmt = stmt->right;
+    }
+}
+
+void optimize_loops(ASTNode* program) {
+    if (!program || program->type != AST_PROGRAM || !options.loop_optimize) {
+        return;
+    }
+
+    program_ast = program;
+
+    ASTNode* stmt = program->statements;
+    while (stmt) {
+        if (stmt->type == AST_FN_DEF) {
+            checks_removed = 0;
+            collect_types(stmt->params);
+            collect_types(stmt->body_nodes);
+            optimize_stmts(stmt->body_nodes);
+            free_types();
+            if (options.bounds_report && checks_removed > 0) {
+                printf("bounds: %s: %d check(s) removed\n", stmt->fn_name, checks_removed);
+            }
+        }
+        stmt = stmt->right;
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef LOOP_OPT_H
+#define LOOP_OPT_H
+
+#include "parser.h"
+
+void optimize_loops(ASTNode* program);
+
+#endif // LOOP_OPT_H
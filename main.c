@@ -6,6 +6,40 @@
 #include "codegen.h"
 #include "stack_machine.h"
 #include "symbol_table.h"
+#include "inliner.h"
+#include "loop_opt.h"
+#include "fold.h"
+#include "escape.h"
+#include "vectorize.h"
+#include "profile.h"
+#include "jit.h"
+#include "interp.h"
+#include "options.h"
+
+CompilerOptions options = {
+    .inline_limit = DEFAULT_INLINE_LIMIT,
+    .inline_report = 0,
+    .tail_calls = 1,
+    .loop_optimize = 1,
+    .print_report = 0,
+    .pool_alloc = 0,
+    .stack_alloc = 1,
+    .escape_report = 0,
+    .bounds_check = 1,
+    .bounds_report = 0,
+    .vectorize = 1,
+    .vectorize_report = 0,
+    .avx2 = 0,
+    .heap_profile = 0,
+    .profile_generate = 0,
+    .profile_use = NULL,
+    .debug_source = NULL,
+    .freestanding = 0,
+    .block_layout = 1,
+    .layout_report = 0,
+    .slot_reuse = 1,
+    .frame_report = 0,
+};
 
 static char* read_file(const char* filename) {
     FILE* f = fopen(filename, "r");
@@ -26,22 +60,182 @@ static char* read_file(const char* filename) {
     return content;
 }
 
+static int has_suffix(const char* name, const char* suffix) {
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] <input.jive> <output.asm|output.o>\n", prog);
+    fprintf(stderr, "       %s [options] --run|--interp <input.jive>\n", prog);
+    fprintf(stderr, "An output name ending in .o gets an ELF64 object without nasm; anything else\n"
+                    "gets NASM assembly text. --run compiles into memory and runs the program;\n"
+                    "--interp runs the IR in the built-in interpreter.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -finline-limit=N   Inline callees of at most N AST nodes (0 disables, default %d)\n",
+            DEFAULT_INLINE_LIMIT);
+    fprintf(stderr, "  --inline-report    Report which calls were inlined\n");
+    fprintf(stderr, "  -fno-optimize-sibling-calls  Keep call/ret for calls in return position\n");
+    fprintf(stderr, "  -fno-loop-optimize Disable loop rotation, invariant motion, strength reduction and\n"
+                    "                     bounds-check elimination\n");
+    fprintf(stderr, "  -fpool-alloc       Use the runtime size-class pool allocator for malloc/free\n");
+    fprintf(stderr, "  -fno-stack-alloc   Keep every malloc on the heap\n");
+    fprintf(stderr, "  --escape-report    Report the mallocs moved to the stack per function\n");
+    fprintf(stderr, "  --print-report     Report how many print calls were merged at compile time\n");
+    fprintf(stderr, "  -fno-bounds-check  Do not check array indices\n");
+    fprintf(stderr, "  --bounds-report    Report the bounds checks removed in loops per function\n");
+    fprintf(stderr, "  -fno-vectorize     Keep element-wise loops scalar\n");
+    fprintf(stderr, "  --vectorize-report Report why each loop was or was not vectorized\n");
+    fprintf(stderr, "  -mavx2             Vectorize with AVX2 (4 lanes) instead of SSE2 (2 lanes)\n");
+    fprintf(stderr, "  --heap-profile     Track malloc/free and the string, builder and array builtins\n"
+                    "                     per source site and report at exit\n");
+    fprintf(stderr, "  -fprofile-generate Count blocks, branches and calls and write them to %s at exit\n",
+            DEFAULT_PROFILE_FILE);
+    fprintf(stderr, "  -fprofile-use=FILE Guide inlining and branch layout with a recorded profile\n");
+    fprintf(stderr, "  -g                 Map the generated code to Jive source lines (DWARF in .o\n"
+                    "                     output; assemble .asm with nasm -g -F dwarf)\n");
+    fprintf(stderr, "  --run              Compile into executable memory and run, reporting compile\n"
+                    "                     and run time on stderr (Linux)\n");
+    fprintf(stderr, "  --perf-map         With --run, list the loaded functions in /tmp/perf-<pid>.map\n");
+    fprintf(stderr, "  --interp           Run the IR in the threaded-code interpreter, reporting translate\n"
+                    "                     and run time on stderr\n");
+    fprintf(stderr, "  -fno-block-layout  Keep cold branches in line and loop heads and functions unaligned\n");
+    fprintf(stderr, "  --layout-report    Report the branches moved to .text.unlikely and why\n");
+    fprintf(stderr, "  -fno-slot-reuse    Give every variable a frame slot of its own\n");
+    fprintf(stderr, "  --frame-report     Report each function's frame size before and after slot reuse\n");
+    fprintf(stderr, "  -ffreestanding     Target the libc-free runtime (runtime_freestanding.c, static\n"
+                    "                     link, Linux); implies -fpool-alloc\n");
+}
+
 int main(int argc, char** argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <input.jive> <output.asm>\n", argv[0]);
+    const char* input_file = NULL;
+    const char* output_file = NULL;
+    int debug_info = 0;
+    int run = 0;
+    int perf_map = 0;
+    int interp = 0;
+    struct timespec compile_start;
+    clock_gettime(CLOCK_MONOTONIC, &compile_start);
+    
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-finline-limit=", 15) == 0) {
+            options.inline_limit = atoi(argv[i] + 15);
+        } else if (strcmp(argv[i], "--inline-report") == 0) {
+            options.inline_report = 1;
+        } else if (strcmp(argv[i], "-fno-optimize-sibling-calls") == 0) {
+            options.tail_calls = 0;
+        } else if (strcmp(argv[i], "-fno-loop-optimize") == 0) {
+            options.loop_optimize = 0;
+        } else if (strcmp(argv[i], "-fpool-alloc") == 0) {
+            options.pool_alloc = 1;
+        } else if (strcmp(argv[i], "-fno-stack-alloc") == 0) {
+            options.stack_alloc = 0;
+        } else if (strcmp(argv[i], "--escape-report") == 0) {
+            options.escape_report = 1;
+        } else if (strcmp(argv[i], "--print-report") == 0) {
+            options.print_report = 1;
+        } else if (strcmp(argv[i], "-fno-bounds-check") == 0) {
+            options.bounds_check = 0;
+        } else if (strcmp(argv[i], "--bounds-report") == 0) {
+            options.bounds_report = 1;
+        } else if (strcmp(argv[i], "-fno-vectorize") == 0) {
+            options.vectorize = 0;
+        } else if (strcmp(argv[i], "--vectorize-report") == 0) {
+            options.vectorize_report = 1;
+        } else if (strcmp(argv[i], "-mavx2") == 0) {
+            options.avx2 = 1;
+        } else if (strcmp(argv[i], "--heap-profile") == 0) {
+            options.heap_profile = 1;
+        } else if (strcmp(argv[i], "-fprofile-generate") == 0) {
+            options.profile_generate = 1;
+        } else if (strncmp(argv[i], "-fprofile-use=", 14) == 0) {
+            options.profile_use = argv[i] + 14;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            debug_info = 1;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = 1;
+        } else if (strcmp(argv[i], "--interp") == 0) {
+            interp = 1;
+        } else if (strcmp(argv[i], "--perf-map") == 0) {
+            perf_map = 1;
+        } else if (strcmp(argv[i], "-ffreestanding") == 0) {
+            options.freestanding = 1;
+        } else if (strcmp(argv[i], "-fno-block-layout") == 0) {
+            options.block_layout = 0;
+        } else if (strcmp(argv[i], "--layout-report") == 0) {
+            options.layout_report = 1;
+        } else if (strcmp(argv[i], "-fno-slot-reuse") == 0) {
+            options.slot_reuse = 0;
+        } else if (strcmp(argv[i], "--frame-report") == 0) {
+            options.frame_report = 1;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Error: unknown option '%s'\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        } else if (!input_file) {
+            input_file = argv[i];
+        } else if (!output_file) {
+            output_file = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (!input_file || (!output_file && !run && !interp) || (output_file && (run || interp)) ||
+        (run && interp)) {
+        usage(argv[0]);
         return 1;
     }
+    if (debug_info) {
+        options.debug_source = input_file;
+    }
+    if (options.freestanding) {
+        // The profilers report through stdio, and --run and --interp use the
+        // compiler's own libc runtime
+        if (options.heap_profile || options.profile_generate || run || interp) {
+            fprintf(stderr, "Error: -ffreestanding cannot be combined with --heap-profile, "
+                            "-fprofile-generate, --run or --interp\n");
+            return 1;
+        }
+        // malloc is the pool allocator there, so call it without the wrapper
+        options.pool_alloc = 1;
+    }
     
-    char* source = read_file(argv[1]);
+    char* source = read_file(input_file);
     
     init_lexer(source);
     ASTNode* ast = parse_program();
     cleanup_lexer();
     
+    if (options.profile_generate || options.profile_use) {
+        assign_profile_keys(ast);
+    }
+    if (options.profile_use) {
+        load_profile(options.profile_use);
+    }
+    
+    inline_functions(ast);
+    fold_constants(ast);
+    stack_allocate(ast);
+    optimize_loops(ast);
+    vectorize_loops(ast);
+    
     IRProgram* ir = generate_code(ast);
+    if (ir && run) {
+        run_jit(ir, &compile_start, perf_map);  // Exits with main's status
+    }
+    if (ir && interp) {
+        run_interpreter(ir, &compile_start);  // Exits with main's status
+    }
     if (ir) {
-        generate_assembly(ir, argv[2]);
-        printf("Compilation successful. Output: %s\n", argv[2]);
+        if (has_suffix(output_file, ".o")) {
+            generate_object(ir, output_file);
+        } else {
+            generate_assembly(ir, output_file);
+        }
+        printf("Compilation successful. Output: %s\n", output_file);
         
         // Cleanup after successful generation
         if (ir) free_ir_program(ir);
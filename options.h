@@ -0,0 +1,32 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+// Command-line options shared by the compiler passes
+typedef struct {
+    int inline_limit;    // Max callee size (AST nodes) to inline, 0 disables inlining
+    int inline_report;   // Print which calls were (not) inlined
+    int tail_calls;      // Turn calls in return position into jumps
+    int loop_optimize;   // Loop rotation, invariant code motion, strength reduction
+    int stack_alloc;     // Put constant-size non-escaping mallocs in the frame
+    int escape_report;   // Print the allocations moved to the stack per function
+    int pool_alloc;      // Allocate through the runtime size-class pools
+    int print_report;    // Print how many runtime print calls were coalesced away
+    int bounds_check;    // Check array indices against the length
+    int bounds_report;   // Print the bounds checks removed per function
+    int vectorize;       // Turn element-wise counted loops into SIMD loops
+    int vectorize_report; // Print why each loop was or was not vectorized
+    int avx2;            // Vectorize with 4-lane AVX2 instead of 2-lane SSE2
+    int heap_profile;    // Route malloc/free through the profiling runtime
+    int profile_generate; // Count blocks, branch directions and calls for a profile
+    const char* profile_use; // Profile file that guides inlining and branch layout, or NULL
+    const char* debug_source; // -g: Jive source named in %line directives, NULL without
+    int freestanding;    // Link against runtime_freestanding.c instead of libc
+    int block_layout;    // Move cold branches out of line, align loop heads and functions
+    int layout_report;   // Print the branches moved to .text.unlikely per function
+    int slot_reuse;      // Share frame slots between variables whose lifetimes do not overlap
+    int frame_report;    // Print each function's frame size before and after slot reuse
+} CompilerOptions;
+
+extern CompilerOptions options;
+
+#endif // OPTIONS_H
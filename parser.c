@@ -7,6 +7,7 @@
 
 static Token* current_token;
 static Scope* current_scope;
+static int region_depth;  // Number of region blocks around the current statement
 
 static ASTNode* parse_expression();
 static ASTNode* parse_statement();
@@ -30,12 +31,31 @@ static void expect_token(TokenType expected) {
     current_token = next_token();
 }
 
-static ASTNode* create_ast_node(ASTNodeType type) {
+ASTNode* create_ast_node(ASTNodeType type) {
     ASTNode* node = calloc(1, sizeof(ASTNode));
     node->type = type;
+    node->line = current_token ? current_token->line : 0;
     return node;
 }
 
+// Parse a type keyword: int, string, builder or array
+static ValueType parse_type() {
+    if (current_token && current_token->type == TOKEN_STRING) {
+        expect_token(TOKEN_STRING);
+        return TYPE_STRING;
+    }
+    if (current_token && current_token->type == TOKEN_BUILDER) {
+        expect_token(TOKEN_BUILDER);
+        return TYPE_BUILDER;
+    }
+    if (current_token && current_token->type == TOKEN_ARRAY) {
+        expect_token(TOKEN_ARRAY);
+        return TYPE_ARRAY;
+    }
+    expect_token(TOKEN_INT);
+    return TYPE_INT;
+}
+
 static ASTNode* parse_primary() {
     ASTNode* node = NULL;
     
@@ -88,13 +108,24 @@ static ASTNode* parse_primary() {
                 while (current_token && current_token->type == TOKEN_COMMA) {
                     expect_token(TOKEN_COMMA);
                     ASTNode* next_arg = parse_expression();
-                    last_arg->right = next_arg;
+                    last_arg->next_arg = next_arg;
                     last_arg = next_arg;
                 }
             }
             
             node->args = args;
             expect_token(TOKEN_RPAREN);
+        } else if (peek_token && peek_token->type == TOKEN_LBRACKET) {
+            // Element load through an array or pointer variable
+            free(current_token->value);
+            free(current_token);
+            current_token = peek_token;
+            
+            node = create_ast_node(AST_INDEX);
+            node->var_name = ident_name;
+            expect_token(TOKEN_LBRACKET);
+            node->left = parse_expression();
+            expect_token(TOKEN_RBRACKET);
         } else {
             // Variable reference
             node = create_ast_node(AST_VAR);
@@ -113,6 +144,7 @@ static ASTNode* parse_primary() {
         expect_token(TOKEN_MALLOC);
         expect_token(TOKEN_LPAREN);
         node = create_ast_node(AST_MALLOC);
+        node->int_value = region_depth > 0;  // Allocate from the enclosing region
         node->left = parse_expression();  // Size argument
         expect_token(TOKEN_RPAREN);
     } else if (current_token && current_token->type == TOKEN_LPAREN) {
@@ -257,20 +289,13 @@ static ASTNode* parse_statement() {
         expect_token(TOKEN_IDENT);
         expect_token(TOKEN_COLON);
         
-        // Support both int and string types
-        int is_string = 0;
-        if (current_token && current_token->type == TOKEN_STRING) {
-            expect_token(TOKEN_STRING);
-            is_string = 1;
-        } else {
-            expect_token(TOKEN_INT);
-        }
+        ValueType value_type = parse_type();
         
         expect_token(TOKEN_ASSIGN);
         
         node = create_ast_node(AST_VAR_DECL);
         node->var_name = var_name;
-        node->int_value = is_string ? 1 : 0;  // Use int_value as type flag: 1 = string, 0 = int
+        node->int_value = value_type;  // Use int_value for the declared type
         node->left = parse_expression();
         expect_token(TOKEN_SEMICOLON);
         
@@ -291,6 +316,16 @@ static ASTNode* parse_statement() {
             node->var_name = name;
             node->left = parse_expression();
             expect_token(TOKEN_SEMICOLON);
+        } else if (current_token && current_token->type == TOKEN_LBRACKET) {
+            // Element store
+            expect_token(TOKEN_LBRACKET);
+            node = create_ast_node(AST_INDEX_ASSIGN);
+            node->var_name = name;
+            node->condition = parse_expression();
+            expect_token(TOKEN_RBRACKET);
+            expect_token(TOKEN_ASSIGN);
+            node->left = parse_expression();
+            expect_token(TOKEN_SEMICOLON);
         } else if (current_token && current_token->type == TOKEN_LPAREN) {
             // Function call statement
             node = create_ast_node(AST_CALL_STMT);
@@ -308,7 +343,7 @@ static ASTNode* parse_statement() {
                 while (current_token && current_token->type == TOKEN_COMMA) {
                     expect_token(TOKEN_COMMA);
                     ASTNode* next_arg = parse_expression();
-                    last_arg->right = next_arg;
+                    last_arg->next_arg = next_arg;
                     last_arg = next_arg;
                 }
             }
@@ -339,7 +374,7 @@ static ASTNode* parse_statement() {
             while (current_token && current_token->type == TOKEN_COMMA) {
                 expect_token(TOKEN_COMMA);
                 ASTNode* next_arg = parse_expression();
-                last_arg->right = next_arg;
+                last_arg->next_arg = next_arg;
                 last_arg = next_arg;
             }
         }
@@ -401,6 +436,14 @@ static ASTNode* parse_statement() {
         node->left = parse_expression();  // Pointer argument
         expect_token(TOKEN_RPAREN);
         expect_token(TOKEN_SEMICOLON);
+    } else if (current_token && current_token->type == TOKEN_REGION) {
+        // Region block: mallocs written inside it are bump-allocated and
+        // released together when the block exits
+        expect_token(TOKEN_REGION);
+        node = create_ast_node(AST_REGION);
+        region_depth++;
+        node->body = parse_block();
+        region_depth--;
     } else if (current_token && current_token->type == TOKEN_LBRACE) {
         // Block statement
         node = parse_block();
@@ -452,7 +495,7 @@ ASTNode* parse_program() {
                 ASTNode* param = create_ast_node(AST_VAR_DECL);
                 param->var_name = param_name;
                 expect_token(TOKEN_COLON);
-                expect_token(TOKEN_INT);
+                param->int_value = parse_type();  // Declared type, as for let
                 
                 declare_param(current_scope, param_name);
                 stmt->params = param;
@@ -465,7 +508,7 @@ ASTNode* parse_program() {
                     ASTNode* next_param = create_ast_node(AST_VAR_DECL);
                     next_param->var_name = next_param_name;
                     expect_token(TOKEN_COLON);
-                    expect_token(TOKEN_INT);
+                    next_param->int_value = parse_type();
                     
                     declare_param(current_scope, next_param_name);
                     last_param->right = next_param;
@@ -475,7 +518,7 @@ ASTNode* parse_program() {
             
             expect_token(TOKEN_RPAREN);
             expect_token(TOKEN_ARROW);
-            expect_token(TOKEN_INT);
+            stmt->int_value = parse_type();  // Return type
             stmt->body_nodes = parse_block();
             
             current_scope = old_scope;
@@ -494,9 +537,43 @@ ASTNode* parse_program() {
         program->stmt_count++;
     }
     
+    // Nodes created by later passes have no source line
+    if (current_token) {
+        free(current_token->value);
+        free(current_token);
+        current_token = NULL;
+    }
+    
     return program;
 }
 
+ASTNode* clone_ast(ASTNode* node) {
+    if (!node) return NULL;
+    
+    ASTNode* copy = malloc(sizeof(ASTNode));
+    *copy = *node;
+    
+    copy->left = clone_ast(node->left);
+    copy->right = clone_ast(node->right);
+    copy->condition = clone_ast(node->condition);
+    copy->then_block = clone_ast(node->then_block);
+    copy->else_block = clone_ast(node->else_block);
+    copy->body = clone_ast(node->body);
+    copy->params = clone_ast(node->params);
+    copy->body_nodes = clone_ast(node->body_nodes);
+    copy->next_arg = clone_ast(node->next_arg);
+    copy->args = clone_ast(node->args);
+    copy->statements = clone_ast(node->statements);
+    
+    copy->fn_name = node->fn_name ? strdup(node->fn_name) : NULL;
+    copy->call_name = node->call_name ? strdup(node->call_name) : NULL;
+    copy->var_name = node->var_name ? strdup(node->var_name) : NULL;
+    copy->string_value = node->string_value ? strdup(node->string_value) : NULL;
+    copy->profile_key = node->profile_key ? strdup(node->profile_key) : NULL;
+    
+    return copy;
+}
+
 void free_ast(ASTNode* node) {
     if (!node) return;
     
@@ -512,6 +589,7 @@ void free_ast(ASTNode* node) {
     free_ast(node->else_block);
     free_ast(node->body);
     free_ast(node->params);
+    free_ast(node->next_arg);
     free_ast(node->args);
     free_ast(node->body_nodes);
     
@@ -547,6 +625,10 @@ void free_ast(ASTNode* node) {
         free(node->string_value);
         node->string_value = NULL;
     }
+    if (node->profile_key) {
+        free(node->profile_key);
+        node->profile_key = NULL;
+    }
     
     // Free the node itself
     free(node);
@@ -19,7 +19,14 @@ typedef enum {
     AST_COMPARE,
     AST_PRINT,
     AST_MALLOC,
-    AST_FREE
+    AST_FREE,
+    AST_INLINE,          // Inlined call: params bind args, body is the renamed callee body
+    AST_STACK_ALLOC,     // Non-escaping malloc moved into the frame (int_value = size)
+    AST_REGION,          // region { ... }: body allocations are released on exit
+    AST_INDEX,           // a[i]: var_name is the base, left the index
+    AST_INDEX_ASSIGN,    // a[i] = v: var_name is the base, condition the index, left the value
+    AST_VECTOR_LOOP      // Vectorized part of a loop: var_name is i, left the limit, statements
+                         // the element stores, params the alias checks, int_value the lanes
 } ASTNodeType;
 
 typedef enum {
@@ -38,13 +45,21 @@ typedef enum {
     COMPARE_GE
 } CompareOpType;
 
+// Declared types of let bindings, parameters and function results
+typedef enum {
+    TYPE_INT,
+    TYPE_STRING,
+    TYPE_BUILDER,
+    TYPE_ARRAY
+} ValueType;
+
 typedef struct ASTNode ASTNode;
 
 struct ASTNode {
     ASTNodeType type;
     ASTNode* left;
     ASTNode* right;
-    ASTNode* condition;  // For if/while
+    ASTNode* condition;  // For if/while; index of a[i] = v
     ASTNode* then_block; // For if
     ASTNode* else_block; // For if/else
     ASTNode* body;       // For while
@@ -57,11 +72,14 @@ struct ASTNode {
     // For function calls
     char* call_name;
     ASTNode* args;
+    ASTNode* next_arg;   // Links call arguments (right is an operand for binops)
     
     // For variables
     char* var_name;
     
-    // For literals
+    // For literals; ValueType for let, parameters, fn return types and
+    // inlined calls; region flag for malloc; 1 on a[i] once the index is
+    // proven in bounds
     int int_value;
     char* string_value;  // For string literals
     
@@ -74,9 +92,14 @@ struct ASTNode {
     // For blocks
     ASTNode* statements;
     int stmt_count;
+    
+    int line;  // Source line of the current token when the node was parsed, 0 if synthesized
+    char* profile_key;  // Counter name for profile-guided optimization (see profile.h)
 };
 
 ASTNode* parse_program();
+ASTNode* create_ast_node(ASTNodeType type);
+ASTNode* clone_ast(ASTNode* node);
 void free_ast(ASTNode* node);
 
 #endif // PARSER_H
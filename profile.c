@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+#define PROFILE_BUCKETS 1024
+
+typedef struct ProfileEntry {
+    char* key;
+    long count;
+    struct ProfileEntry* next;
+} ProfileEntry;
+
+// Calls to one callee within the function being numbered
+typedef struct CallCount {
+    const char* callee;
+    int count;
+    struct CallCount* next;
+} CallCount;
+
+static ProfileEntry* buckets[PROFILE_BUCKETS];
+static int profile_loaded;
+static long max_count;
+
+static const char* current_fn;
+static int if_count;
+static int while_count;
+static CallCount* call_counts;
+
+static char* make_key(const char* construct, int number) {
+    char* key = malloc(strlen(current_fn) + strlen(construct) + 16);
+    sprintf(key, "%s/%s#%d", current_fn, construct, number);
+    return key;
+}
+
+static int next_call_number(const char* callee) {
+    for (CallCount* c = call_counts; c; c = c->next) {
+        if (strcmp(c->callee, callee) == 0) {
+            return ++c->count;
+        }
+    }
+    CallCount* c = malloc(sizeof(CallCount));
+    c->callee = callee;
+    c->count = 1;
+    c->next = call_counts;
+    call_counts = c;
+    return 1;
+}
+
+static void free_call_counts(void) {
+    while (call_counts) {
+        CallCount* next = call_counts->next;
+        free(call_counts);
+        call_counts = next;
+    }
+}
+
+static void assign_keys(ASTNode* node) {
+    if (!node) return;
+
+    switch (node->type) {
+        case AST_IF:
+            node->profile_key = make_key("if", ++if_count);
+            break;
+        case AST_WHILE:
+            node->profile_key = make_key("while", ++while_count);
+            break;
+        case AST_CALL_EXPR:
+        case AST_CALL_STMT: {
+            char* construct = malloc(strlen(node->call_name) + 8);
+            sprintf(construct, "call:%s", node->call_name);
+            node->profile_key = make_key(construct, next_call_number(node->call_name));
+            free(construct);
+            break;
+        }
+        default:
+            break;
+    }
+
+    assign_keys(node->args);
+    assign_keys(node->next_arg);
+    assign_keys(node->left);
+    assign_keys(node->condition);
+    assign_keys(node->then_block);
+    assign_keys(node->else_block);
+    assign_keys(node->body);
+    assign_keys(node->statements);
+    assign_keys(node->right);
+}
+
+void assign_profile_keys(ASTNode* program) {
+    if (!program || program->type != AST_PROGRAM) {
+        return;
+    }
+    for (ASTNode* stmt = program->statements; stmt; stmt = stmt->right) {
+        if (stmt->type == AST_FN_DEF) {
+            current_fn = stmt->fn_name;
+            if_count = 0;
+            while_count = 0;
+            stmt->profile_key = strdup(stmt->fn_name);
+            assign_keys(stmt->body_nodes);
+            free_call_counts();
+        }
+    }
+}
+
+static unsigned hash_key(const char* key) {
+    unsigned hash = 5381;
+    for (; *key; key++) {
+        hash = hash * 33 + (unsigned char)*key;
+    }
+    return hash % PROFILE_BUCKETS;
+}
+
+static ProfileEntry* find_entry(const char* key) {
+    for (ProfileEntry* e = buckets[hash_key(key)]; e; e = e->next) {
+        if (strcmp(e->key, key) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// One "name count" pair per line; '#' starts a comment. A name listed more
+// than once (a construct inlined into several callers) gets the sum.
+void load_profile(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open profile '%s'\n", path);
+        exit(1);
+    }
+
+    char line[512];
+    char key[512];
+    long count;
+    int line_number = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_number++;
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        if (sscanf(line, "%511s %ld", key, &count) != 2 || count < 0) {
+            fprintf(stderr, "Error: %s:%d: malformed profile line\n", path, line_number);
+            exit(1);
+        }
+        ProfileEntry* e = find_entry(key);
+        if (!e) {
+            unsigned bucket = hash_key(key);
+            e = calloc(1, sizeof(ProfileEntry));
+            e->key = strdup(key);
+            e->next = buckets[bucket];
+            buckets[bucket] = e;
+        }
+        e->count += count;
+        if (e->count > max_count) {
+            max_count = e->count;
+        }
+    }
+    fclose(f);
+    profile_loaded = 1;
+}
+
+long profile_count(const char* key, const char* suffix) {
+    if (!profile_loaded || !key) {
+        return -1;
+    }
+    if (!suffix) {
+        ProfileEntry* e = find_entry(key);
+        return e ? e->count : -1;
+    }
+    char* full = malloc(strlen(key) + strlen(suffix) + 2);
+    sprintf(full, "%s/%s", key, suffix);
+    ProfileEntry* e = find_entry(full);
+    free(full);
+    return e ? e->count : -1;
+}
+
+int profile_is_hot(long count) {
+    return count > 0 && count * 100 >= max_count;
+}
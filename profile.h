@@ -0,0 +1,28 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "parser.h"
+
+// Default output of -fprofile-generate programs; JIVE_PROFILE overrides it
+#define DEFAULT_PROFILE_FILE "jive.profile"
+
+// Inline limit multiplier for call sites that -fprofile-use finds hot
+#define PGO_HOT_INLINE_FACTOR 4
+
+// Give ifs, whiles, calls and function entries their counter names, such as
+// "main/while#2" or "main/call:fib#1". Numbers count constructs of the same
+// kind within one function in source order, so editing one function leaves
+// the names in every other function alone.
+void assign_profile_keys(ASTNode* program);
+
+// Read a profile written by a -fprofile-generate program. Exits on error.
+void load_profile(const char* path);
+
+// Count recorded for key (plus "/suffix" if given); -1 without a profile or
+// for a name the profile does not have
+long profile_count(const char* key, const char* suffix);
+
+// Executed at least 1% as often as the hottest counter
+int profile_is_hot(long count);
+
+#endif // PROFILE_H
@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "runtime.h"
+
+#define OUT_BUFFER_SIZE 65536
+
+typedef struct {
+    char data[OUT_BUFFER_SIZE];
+    size_t len;
+} OutBuffer;
+
+// No thread pointer without libc
+#ifdef JIVE_FREESTANDING
+static OutBuffer out;
+#else
+static __thread OutBuffer out;
+#endif
+
+// Two ASCII digits per entry, so formatting does one division per pair
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static void write_all(const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(1, data, len);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+}
+
+void jive_flush(void) {
+    write_all(out.data, out.len);
+    out.len = 0;
+}
+
+// Programs whose main returns through libc (macOS, or Jive code called from
+// C) flush here; generated Linux _start flushes through jive_exit instead
+__attribute__((destructor))
+static void flush_at_exit(void) {
+    jive_flush();
+}
+
+// Make sure at least n bytes are free
+static void reserve(size_t n) {
+    if (OUT_BUFFER_SIZE - out.len < n) {
+        jive_flush();
+    }
+}
+
+long jive_format_int(char* dest, long value) {
+    char tmp[JIVE_INT_MAX_CHARS];
+    char* end = tmp + sizeof(tmp);
+    char* p = end;
+    unsigned long mag = value < 0 ? -(unsigned long)value : (unsigned long)value;
+
+    while (mag >= 100) {
+        unsigned long pair = mag % 100;
+        mag /= 100;
+        p -= 2;
+        memcpy(p, &digit_pairs[pair * 2], 2);
+    }
+    if (mag >= 10) {
+        p -= 2;
+        memcpy(p, &digit_pairs[mag * 2], 2);
+    } else {
+        *--p = (char)('0' + mag);
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+
+    long len = end - p;
+    memcpy(dest, p, (size_t)len);
+    return len;
+}
+
+void jive_print_int(long value) {
+    reserve(JIVE_INT_MAX_CHARS + 1);
+    out.len += (size_t)jive_format_int(out.data + out.len, value);
+    out.data[out.len++] = '\n';
+}
+
+void jive_print_str(const char* str, long len) {
+    if (len <= 0) return;
+    reserve((size_t)len > OUT_BUFFER_SIZE ? OUT_BUFFER_SIZE : (size_t)len);
+    if ((size_t)len > OUT_BUFFER_SIZE - out.len) {
+        // Larger than the whole buffer: bypass it
+        jive_flush();
+        write_all(str, (size_t)len);
+        return;
+    }
+    memcpy(out.data + out.len, str, (size_t)len);
+    out.len += (size_t)len;
+}
+
+void jive_print_cstr(const char* str) {
+    jive_print_str(str, (long)strlen(str));
+}
+
+// Defined by runtime_heap.c and runtime_pgo.c when they are linked in
+void* jive_prof_alloc(long size, const char* site) __attribute__((weak));
+void* jive_prof_realloc(void* ptr, long size, const char* site) __attribute__((weak));
+void jive_prof_free(void* ptr, const char* site) __attribute__((weak));
+void jive_prof_report(void) __attribute__((weak));
+void jive_pgo_write(void) __attribute__((weak));
+
+void jive_exit(long status) {
+    if (jive_prof_report) {
+        jive_prof_report();
+    }
+    if (jive_pgo_write) {
+        jive_pgo_write();
+    }
+    jive_flush();
+    exit((int)status);
+}
+
+const char* jive_heap_site;
+
+void* jive_heap_alloc(long size) {
+    if (jive_heap_site && jive_prof_alloc) {
+        return jive_prof_alloc(size, jive_heap_site);
+    }
+    return malloc((size_t)size);
+}
+
+void* jive_heap_realloc(void* ptr, long size) {
+    if (jive_heap_site && jive_prof_realloc) {
+        return jive_prof_realloc(ptr, size, jive_heap_site);
+    }
+    return realloc(ptr, (size_t)size);
+}
+
+void jive_heap_free(void* ptr) {
+    if (jive_heap_site && jive_prof_free) {
+        jive_prof_free(ptr, jive_heap_site);
+        return;
+    }
+    free(ptr);
+}
+
+long* jive_array_new(long length) {
+    if (length < 0) length = 0;
+    size_t size = sizeof(JiveArrayHeader) + length * sizeof(long);
+    JiveArrayHeader* header = jive_heap_alloc((long)size);
+    if (!header) {
+        static const char message[] = "Error: out of memory\n";
+        jive_print_str(message, sizeof(message) - 1);
+        jive_exit(1);
+    }
+    memset(header, 0, size);
+    header->element_size = sizeof(long);
+    header->length = length;
+    return (long*)(header + 1);
+}
+
+void jive_array_free(long* array) {
+    if (array) {
+        jive_heap_free((JiveArrayHeader*)array - 1);
+    }
+}
+
+void jive_bounds_error(long index, long length) {
+    static const char prefix[] = "Error: index ";
+    static const char middle[] = " out of bounds for length ";
+    char digits[JIVE_INT_MAX_CHARS + 1];
+    jive_print_str(prefix, sizeof(prefix) - 1);
+    jive_print_str(digits, jive_format_int(digits, index));
+    jive_print_str(middle, sizeof(middle) - 1);
+    jive_print_str(digits, jive_format_int(digits, length));
+    jive_print_str("\n", 1);
+    jive_exit(1);
+}
@@ -0,0 +1,188 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+// Runtime library linked with every generated Jive program.
+// The compiler emits calls to these functions; they follow the System V
+// calling convention like Jive functions themselves.
+
+// Buffered output: everything is collected in a thread-local buffer and
+// written to fd 1 when the buffer fills and at exit
+void jive_print_int(long value);                // Decimal digits and a newline
+void jive_print_str(const char* str, long len); // Exactly len bytes
+void jive_print_cstr(const char* str);          // NUL-terminated string
+void jive_flush(void);
+
+// Decimal digits of value written to dest (no NUL); returns the length
+#define JIVE_INT_MAX_CHARS 20  // "-9223372036854775808"
+long jive_format_int(char* dest, long value);
+
+// Flush buffered output and terminate the process
+void jive_exit(long status);
+
+// Arrays: zero-filled 8-byte elements after a 16-byte header, so the
+// elements stay 16-byte aligned and the length sits at the same offset as a
+// string's. Indexing compiles to a single base + index * 8 access; checked
+// accesses compare the index with the length and jump to jive_bounds_error.
+typedef struct {
+    long element_size;
+    long length;
+} JiveArrayHeader;
+
+#define JIVE_ARRAY_LEN_OFFSET 8
+
+long* jive_array_new(long length);
+void jive_array_free(long* array);
+void jive_bounds_error(long index, long length);  // Reports and exits
+
+// Strings (runtime_string.c). A Jive string points at NUL-terminated bytes
+// preceded by a header, so the length is read in O(1) and the bytes can
+// still be handed to C. Literals carry the header in the data section;
+// strings built at run time are malloc'ed and released with jive_str_free.
+typedef struct {
+    long capacity;  // Bytes available for data, excluding the NUL
+    long length;
+} JiveStrHeader;
+
+#define JIVE_STR_LEN_OFFSET 8  // Length lives just below the data
+
+static inline JiveStrHeader* jive_str_header(const char* str) {
+    return (JiveStrHeader*)str - 1;
+}
+
+static inline long jive_str_len(const char* str) {
+    return jive_str_header(str)->length;
+}
+
+char* jive_str_new(long capacity);  // Empty string with room for capacity bytes
+char* jive_str_concat(const char* a, const char* b);
+char* jive_str_concat_int(const char* str, long value);  // str + decimal value
+char* jive_int_concat_str(long value, const char* str);  // Decimal value + str
+char* jive_str_substr(const char* str, long start, long count);  // Clamped to the string
+long jive_str_eq(const char* a, const char* b);
+void jive_str_free(char* str);
+
+// Builders: a growable string behind a handle, so appends can move the
+// buffer without invalidating the builder. print flushes the contents
+// straight into the print buffer and empties the builder; finish hands the
+// bytes over as an ordinary string.
+typedef struct {
+    char* str;  // Jive string whose capacity grows geometrically
+} JiveBuilder;
+
+#define JIVE_SB_MIN_CAPACITY 32
+
+JiveBuilder* jive_sb_new(void);
+JiveBuilder* jive_sb_append_str(JiveBuilder* sb, const char* str);
+JiveBuilder* jive_sb_append_int(JiveBuilder* sb, long value);
+char* jive_sb_finish(JiveBuilder* sb);  // Caller owns the string; the builder starts over
+void jive_sb_print(JiveBuilder* sb);
+void jive_sb_free(JiveBuilder* sb);
+
+// SIMD kernels: SSE2 and AVX2 versions with a scalar fallback, chosen at
+// startup from CPUID (or on first use when constructors do not run)
+long jive_str_starts_with(const char* str, const char* prefix);
+long jive_str_find(const char* str, const char* needle);  // Index or -1
+long jive_str_find_byte(const char* str, long byte);       // Index or -1
+long jive_cstr_len(const char* str);                       // strlen for C strings
+char* jive_str_from_cstr(const char* str);                 // Copy a C string into a Jive string
+
+#define JIVE_SIMD_SCALAR 0
+#define JIVE_SIMD_SSE2   1
+#define JIVE_SIMD_AVX2   2
+
+int jive_str_simd_level(void);       // Level in use
+int jive_str_use_simd(int level);    // Cap the level (benchmarks); returns the level used
+
+// Size-class pool allocator (runtime_pool.c), used for malloc/free when a
+// program is compiled with -fpool-alloc. Requests up to JIVE_POOL_MAX_SMALL
+// bytes are served from per-class free lists threaded through objects in
+// slabs of JIVE_POOL_SLAB_SIZE bytes. Slabs are aligned to their size and
+// start with the class index, so free finds an object's class by masking the
+// pointer. Larger requests get their own aligned mapping marked with class
+// JIVE_POOL_CLASSES. Not thread-safe: Jive programs are single-threaded.
+#define JIVE_POOL_SLAB_SIZE   65536
+#define JIVE_POOL_SLAB_HEADER 64     // Keeps objects 16-byte aligned
+#define JIVE_POOL_MAX_SMALL   4096
+#define JIVE_POOL_CLASSES     20     // 16..256 in steps of 16, then 512..4096
+
+// Class index for a request of size bytes, -1 if it is too large for a class.
+// Shared with the compiler, which picks the class of constant sizes.
+static inline int jive_pool_class(long size) {
+    if (size <= 256) {
+        return size <= 16 ? 0 : (int)((size + 15) / 16) - 1;
+    }
+    int size_class = 16;
+    long class_size = 512;
+    while (class_size < size) {
+        if (class_size == JIVE_POOL_MAX_SMALL) {
+            return -1;
+        }
+        class_size *= 2;
+        size_class++;
+    }
+    return size_class;
+}
+
+static inline long jive_pool_class_size(int size_class) {
+    return size_class < 16 ? (size_class + 1) * 16L : 512L << (size_class - 16);
+}
+
+// Free list heads, one per class. Emitted code pops and pushes them inline
+// and only calls into the runtime when a list is empty or the object is large.
+extern void* jive_pool_heads[JIVE_POOL_CLASSES];
+
+void* jive_alloc(long size);
+void jive_free(void* ptr);
+void* jive_pool_refill(long size_class);  // Carve a new slab, return one object
+long jive_pool_size(void* ptr);           // Usable bytes of a live allocation
+
+// Region allocator (runtime_region.c) behind `region { ... }` blocks. All
+// regions share one list of chunks with a bump pointer; entering a region
+// saves the bump position and exiting restores it, releasing everything
+// allocated inside in O(1). Chunks are kept for reuse by later regions.
+// Emitted code bumps jive_region_bump inline while it stays within
+// jive_region_limit and calls jive_region_alloc otherwise.
+extern char* jive_region_bump;
+extern char* jive_region_limit;
+
+void jive_region_enter(void);
+void jive_region_exit(void);
+void* jive_region_alloc(long size);
+
+// ptr, or NULL if it points into a live region (free of region memory is a no-op)
+void* jive_region_filter(void* ptr);
+
+// Heap profiler (runtime_heap.c), used for malloc/free when a program is
+// compiled with --heap-profile. site is the "function:line" string of the
+// malloc or free in the Jive source. Counts, live and peak bytes per site
+// and overall are written to stderr at exit, or to the file named by
+// JIVE_HEAP_PROFILE. Frees of blocks that are not live are reported and
+// skipped.
+void* jive_prof_alloc(long size, const char* site);
+void* jive_prof_realloc(void* ptr, long size, const char* site);
+void jive_prof_free(void* ptr, const char* site);
+void jive_prof_report(void);  // Write the summary once; called by jive_exit
+
+// Allocation for the runtime's own strings, builders and arrays. Code built
+// with --heap-profile stores the "function:line" of each builtin call that
+// allocates or frees in jive_heap_site first, which sends these blocks
+// through the heap profiler under that site. Otherwise they are plain
+// malloc/realloc/free.
+extern const char* jive_heap_site;
+void* jive_heap_alloc(long size);
+void* jive_heap_realloc(void* ptr, long size);
+void jive_heap_free(void* ptr);
+
+// Profile writer (runtime_pgo.c) for programs compiled with
+// -fprofile-generate. Writes "name count" for every counter the compiler
+// emitted to jive.profile, or to the file named by JIVE_PROFILE.
+void jive_pgo_write(void);  // Write once; called by jive_exit
+void jive_pgo_set_table(const void* table);  // --run: the table is in JIT-loaded code
+
+// Freestanding support (runtime_freestanding.c) for programs linked with
+// -static -nostdlib: write, exit, mmap, malloc and the string functions the
+// runtime uses, on raw Linux x86-64 system calls. malloc is the pool
+// allocator. Compile the runtime with -DJIVE_FREESTANDING, which drops the
+// thread-local print buffer, since nothing sets up a thread pointer.
+
+#endif // RUNTIME_H
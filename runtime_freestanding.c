@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "runtime.h"
+
+// The C library subset the runtime calls, for programs linked with
+// -static -nostdlib. Generated code enters at its own _start and leaves
+// through jive_exit, so nothing here needs initializing: no thread pointer,
+// no stdio, no constructors. Linux x86-64 only.
+//
+//   gcc -O2 -static -nostdlib -fno-stack-protector -DJIVE_FREESTANDING out.o runtime.c
+//       runtime_pool.c runtime_region.c runtime_string.c runtime_freestanding.c -o a.out
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "runtime_freestanding.c needs Linux on x86-64"
+#endif
+
+static int error_number;
+
+int* __errno_location(void) {
+    return &error_number;
+}
+
+// rax = number, then rdi, rsi, rdx, r10, r8, r9; the kernel clobbers rcx and r11
+static long system_call(long number, long a, long b, long c, long d, long e, long f) {
+    register long r10 __asm__("r10") = d;
+    register long r8 __asm__("r8") = e;
+    register long r9 __asm__("r9") = f;
+    long result;
+    __asm__ volatile("syscall"
+                     : "=a"(result)
+                     : "a"(number), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+                     : "rcx", "r11", "memory");
+    return result;
+}
+
+// Results from -4095 to -1 are negated error numbers
+static long checked(long result) {
+    if ((unsigned long)result > -4096UL) {
+        error_number = (int)-result;
+        return -1;
+    }
+    return result;
+}
+
+ssize_t write(int fd, const void* data, size_t len) {
+    return checked(system_call(SYS_write, fd, (long)data, (long)len, 0, 0, 0));
+}
+
+void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t offset) {
+    long result = checked(system_call(SYS_mmap, (long)addr, (long)len, prot, flags, fd, offset));
+    return result == -1 ? MAP_FAILED : (void*)result;
+}
+
+int munmap(void* addr, size_t len) {
+    return (int)checked(system_call(SYS_munmap, (long)addr, (long)len, 0, 0, 0, 0));
+}
+
+void exit(int status) {
+    for (;;) {
+        system_call(SYS_exit_group, status, 0, 0, 0, 0, 0);
+    }
+}
+
+// malloc and free are the pool allocator (runtime_pool.c), which gets its
+// memory from mmap: 16-byte aligned, size classes up to 4 KiB and a mapping
+// of its own for anything larger
+void* malloc(size_t size) {
+    return jive_alloc((long)size);
+}
+
+void free(void* ptr) {
+    jive_free(ptr);
+}
+
+void* calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* ptr = jive_alloc((long)(count * size));
+    return memset(ptr, 0, count * size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return jive_alloc((long)size);
+    }
+    size_t old_size = (size_t)jive_pool_size(ptr);
+    if (size <= old_size) {
+        return ptr;
+    }
+    void* grown = jive_alloc((long)size);
+    memcpy(grown, ptr, old_size);
+    jive_free(ptr);
+    return grown;
+}
+
+// rep movsb/stosb rather than loops, which the compiler would turn back into
+// calls to these very functions
+void* memcpy(void* dest, const void* src, size_t n) {
+    void* d = dest;
+    __asm__ volatile("rep movsb" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    if ((uintptr_t)dest - (uintptr_t)src >= n) {
+        return memcpy(dest, src, n);
+    }
+    // Overlapping with dest above src: copy from the last byte down
+    void* d = (char*)dest + n - 1;
+    src = (const char*)src + n - 1;
+    __asm__ volatile("std\n\trep movsb\n\tcld" : "+D"(d), "+S"(src), "+c"(n) : : "memory");
+    return dest;
+}
+
+void* memset(void* dest, int byte, size_t n) {
+    void* d = dest;
+    __asm__ volatile("rep stosb" : "+D"(d), "+c"(n) : "a"(byte) : "memory");
+    return dest;
+}
+
+int memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* x = a;
+    const unsigned char* y = b;
+    for (size_t i = 0; i < n; i++) {
+        if (x[i] != y[i]) {
+            return x[i] - y[i];
+        }
+    }
+    return 0;
+}
+
+size_t strlen(const char* str) {
+    return (size_t)jive_cstr_len(str);
+}
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "runtime.h"
+
+#define MAX_SITES 4096      // Power of two; site 0 collects the overflow
+#define MAX_REPORTED_SITES 20
+#define LIVE_MAGIC 0x4a495645u  // "JIVE"
+
+// Per-site counters. Sites are keyed by the address of the "function:line"
+// string the compiler emits next to each malloc/free.
+typedef struct {
+    const char* name;
+    long allocs;
+    long frees;
+    long bytes;
+    long live_bytes;
+    long live_blocks;
+    long peak_bytes;
+} HeapSite;
+
+// In front of every profiled block; 16 bytes keeps malloc's alignment
+typedef struct {
+    uint32_t site;
+    uint32_t magic;  // LIVE_MAGIC while allocated
+    long size;
+} BlockHeader;
+
+typedef struct {
+    long allocs;
+    long frees;
+    long bad_frees;
+    long bytes;
+    long live_bytes;
+    long live_blocks;
+    long peak_bytes;
+    struct timespec start;
+    int started;
+    int reported;
+} HeapTotals;
+
+static HeapSite sites[MAX_SITES];
+static int site_count;
+static HeapTotals heap;
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int by_bytes(const void* a, const void* b) {
+    const HeapSite* x = *(const HeapSite* const*)a;
+    const HeapSite* y = *(const HeapSite* const*)b;
+    return (y->bytes > x->bytes) - (y->bytes < x->bytes);
+}
+
+void jive_prof_report(void) {
+    if (!heap.started || heap.reported) {
+        return;
+    }
+    heap.reported = 1;
+
+    const char* path = getenv("JIVE_HEAP_PROFILE");
+    FILE* f = path ? fopen(path, "w") : NULL;
+    if (!f) {
+        f = stderr;
+    }
+    double elapsed = seconds_since(&heap.start);
+
+    fprintf(f, "heap profile: %ld allocation(s), %ld free(s), %ld bad free(s)\n",
+            heap.allocs, heap.frees, heap.bad_frees);
+    fprintf(f, "  %ld bytes allocated, peak %ld bytes live, %ld bytes in %ld block(s) live at exit\n",
+            heap.bytes, heap.peak_bytes, heap.live_bytes, heap.live_blocks);
+    fprintf(f, "  %.3f s, %.0f allocation(s)/s\n",
+            elapsed, elapsed > 0 ? heap.allocs / elapsed : 0.0);
+
+    HeapSite* order[MAX_SITES];
+    int count = 0;
+    for (int i = 0; i < MAX_SITES; i++) {
+        if (sites[i].allocs > 0) {
+            order[count++] = &sites[i];
+        }
+    }
+    qsort(order, count, sizeof(order[0]), by_bytes);
+
+    fprintf(f, "  %-24s %10s %14s %12s %12s %12s\n",
+            "site", "allocs", "bytes", "peak bytes", "live blocks", "live bytes");
+    for (int i = 0; i < count && i < MAX_REPORTED_SITES; i++) {
+        HeapSite* site = order[i];
+        fprintf(f, "  %-24s %10ld %14ld %12ld %12ld %12ld%s\n",
+                site->name, site->allocs, site->bytes, site->peak_bytes,
+                site->live_blocks, site->live_bytes, site->live_blocks ? "  leak" : "");
+    }
+    if (count > MAX_REPORTED_SITES) {
+        fprintf(f, "  ... %d more site(s)\n", count - MAX_REPORTED_SITES);
+    }
+    if (f != stderr) {
+        fclose(f);
+    }
+}
+
+// Programs that exit through libc report here; generated Linux _start
+// reports through jive_exit instead
+__attribute__((destructor))
+static void report_at_exit(void) {
+    jive_prof_report();
+}
+
+// Generated Linux programs skip constructors, so profiling starts with the
+// first allocation
+static void start_profile(void) {
+    heap.started = 1;
+    clock_gettime(CLOCK_MONOTONIC, &heap.start);
+    sites[0].name = "(other)";
+}
+
+static uint32_t site_index(const char* name) {
+    uint32_t slot = (uint32_t)(((uintptr_t)name >> 3) * 0x9E3779B1u) & (MAX_SITES - 1);
+    for (int probe = 0; probe < MAX_SITES; probe++) {
+        if (slot != 0) {
+            if (sites[slot].name == name) {
+                return slot;
+            }
+            if (!sites[slot].name) {
+                if (site_count >= MAX_SITES / 2) {
+                    break;
+                }
+                sites[slot].name = name;
+                site_count++;
+                return slot;
+            }
+        }
+        slot = (slot + 1) & (MAX_SITES - 1);
+    }
+    return 0;
+}
+
+void* jive_prof_alloc(long size, const char* site) {
+    if (!heap.started) {
+        start_profile();
+    }
+    if (size < 0) {
+        size = 0;
+    }
+    BlockHeader* header = malloc(sizeof(BlockHeader) + size);
+    if (!header) {
+        return NULL;
+    }
+    uint32_t index = site_index(site);
+    header->site = index;
+    header->magic = LIVE_MAGIC;
+    header->size = size;
+
+    HeapSite* s = &sites[index];
+    s->allocs++;
+    s->bytes += size;
+    s->live_blocks++;
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes) {
+        s->peak_bytes = s->live_bytes;
+    }
+    heap.allocs++;
+    heap.bytes += size;
+    heap.live_blocks++;
+    heap.live_bytes += size;
+    if (heap.live_bytes > heap.peak_bytes) {
+        heap.peak_bytes = heap.live_bytes;
+    }
+    return header + 1;
+}
+
+// Growth of a runtime string: a new block at site, then a free of the old one
+void* jive_prof_realloc(void* ptr, long size, const char* site) {
+    void* result = jive_prof_alloc(size, site);
+    if (!result || !ptr) {
+        return result;
+    }
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    if (header->magic == LIVE_MAGIC) {
+        memcpy(result, ptr, header->size < size ? header->size : size);
+    }
+    jive_prof_free(ptr, site);
+    return result;
+}
+
+// A block whose header has lost its magic was freed already (malloc reuses
+// those bytes) or never came from jive_prof_alloc. It is reported and left
+// alone rather than corrupting the heap.
+void jive_prof_free(void* ptr, const char* site) {
+    if (!ptr) {
+        return;
+    }
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    if (header->magic != LIVE_MAGIC || header->site >= MAX_SITES) {
+        heap.bad_frees++;
+        fprintf(stderr, "heap: invalid or double free of %p at %s\n", ptr, site);
+        return;
+    }
+    header->magic = 0;
+
+    HeapSite* s = &sites[header->site];
+    s->frees++;
+    s->live_blocks--;
+    s->live_bytes -= header->size;
+    heap.frees++;
+    heap.live_blocks--;
+    heap.live_bytes -= header->size;
+    free(header);
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "runtime.h"
+
+// Emitted by the compiler into programs built with -fprofile-generate
+typedef struct {
+    long count;
+    long* counters;
+    const char** names;
+} JivePgoTable;
+
+extern const JivePgoTable jive_pgo_table __attribute__((weak));
+
+// The linked-in table, or the one in JIT-loaded code
+static const JivePgoTable* table = &jive_pgo_table;
+static int written;
+
+void jive_pgo_set_table(const void* loaded) {
+    table = loaded;
+}
+
+void jive_pgo_write(void) {
+    if (!table || written) {
+        return;
+    }
+    written = 1;
+
+    const char* path = getenv("JIVE_PROFILE");
+    if (!path) {
+        path = "jive.profile";
+    }
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "profile: cannot write '%s'\n", path);
+        return;
+    }
+    fprintf(f, "# jive profile: %ld counter(s)\n", table->count);
+    for (long i = 0; i < table->count; i++) {
+        fprintf(f, "%s %ld\n", table->names[i], table->counters[i]);
+    }
+    fclose(f);
+}
+
+// Programs that exit through libc write here; generated Linux _start writes
+// through jive_exit instead
+__attribute__((destructor))
+static void write_at_exit(void) {
+    jive_pgo_write();
+}
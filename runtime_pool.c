@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "runtime.h"
+
+#define REGION_SIZE (64 * JIVE_POOL_SLAB_SIZE)
+#define PAGE_SIZE 4096
+
+// Start of every slab and of every large mapping
+typedef struct {
+    long size_class;  // JIVE_POOL_CLASSES for a large allocation
+    long map_size;    // Bytes to unmap (large allocations only)
+} SlabHeader;
+
+void* jive_pool_heads[JIVE_POOL_CLASSES];
+
+// Unused part of the current region, handed out one slab at a time
+static char* region_next;
+static char* region_end;
+
+static void out_of_memory(void) {
+    static const char message[] = "Error: out of memory\n";
+    jive_print_str(message, sizeof(message) - 1);
+    jive_exit(1);
+}
+
+// Map size bytes aligned to JIVE_POOL_SLAB_SIZE by over-mapping and trimming
+static char* map_aligned(size_t size) {
+    size_t padded = size + JIVE_POOL_SLAB_SIZE;
+    char* base = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        out_of_memory();
+    }
+    uintptr_t start = ((uintptr_t)base + JIVE_POOL_SLAB_SIZE - 1) & ~(uintptr_t)(JIVE_POOL_SLAB_SIZE - 1);
+    size_t head = start - (uintptr_t)base;
+    if (head > 0) {
+        munmap(base, head);
+    }
+    size_t tail = padded - head - size;
+    if (tail > 0) {
+        munmap((char*)start + size, tail);
+    }
+    return (char*)start;
+}
+
+void* jive_pool_refill(long size_class) {
+    if (region_next == region_end) {
+        region_next = map_aligned(REGION_SIZE);
+        region_end = region_next + REGION_SIZE;
+    }
+    char* slab = region_next;
+    region_next += JIVE_POOL_SLAB_SIZE;
+    ((SlabHeader*)slab)->size_class = size_class;
+
+    // Thread every object but the first onto the (empty) free list, in
+    // address order so consecutive allocations stay adjacent
+    long size = jive_pool_class_size((int)size_class);
+    char* first = slab + JIVE_POOL_SLAB_HEADER;
+    char* end = slab + JIVE_POOL_SLAB_SIZE;
+    void* head = NULL;
+    for (char* obj = first + ((end - first) / size - 1) * size; obj > first; obj -= size) {
+        *(void**)obj = head;
+        head = obj;
+    }
+    jive_pool_heads[size_class] = head;
+    return first;
+}
+
+void* jive_alloc(long size) {
+    int size_class = jive_pool_class(size);
+    if (size_class >= 0) {
+        void* obj = jive_pool_heads[size_class];
+        if (!obj) {
+            return jive_pool_refill(size_class);
+        }
+        jive_pool_heads[size_class] = *(void**)obj;
+        return obj;
+    }
+
+    size_t map_size = (JIVE_POOL_SLAB_HEADER + (size_t)size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    char* base = map_aligned(map_size);
+    SlabHeader* header = (SlabHeader*)base;
+    header->size_class = JIVE_POOL_CLASSES;
+    header->map_size = (long)map_size;
+    return base + JIVE_POOL_SLAB_HEADER;
+}
+
+long jive_pool_size(void* ptr) {
+    SlabHeader* header = (SlabHeader*)((uintptr_t)ptr & ~(uintptr_t)(JIVE_POOL_SLAB_SIZE - 1));
+    if (header->size_class == JIVE_POOL_CLASSES) {
+        return header->map_size - JIVE_POOL_SLAB_HEADER;
+    }
+    return jive_pool_class_size((int)header->size_class);
+}
+
+void jive_free(void* ptr) {
+    if (!ptr) return;
+    SlabHeader* header = (SlabHeader*)((uintptr_t)ptr & ~(uintptr_t)(JIVE_POOL_SLAB_SIZE - 1));
+    if (header->size_class == JIVE_POOL_CLASSES) {
+        munmap(header, (size_t)header->map_size);
+        return;
+    }
+    *(void**)ptr = jive_pool_heads[header->size_class];
+    jive_pool_heads[header->size_class] = ptr;
+}
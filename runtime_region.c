@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "runtime.h"
+
+#define CHUNK_SIZE (1024 * 1024)
+#define MAX_REGION_DEPTH 256
+
+typedef struct Chunk {
+    struct Chunk* next;
+    char* end;
+    char data[] __attribute__((aligned(16)));
+} Chunk;
+
+// Bump position saved by a region enter
+typedef struct {
+    Chunk* chunk;
+    char* bump;
+} RegionMark;
+
+char* jive_region_bump;
+char* jive_region_limit;
+
+// Chunks in use come first; the ones after current are free for reuse
+static Chunk* first_chunk;
+static Chunk* current;
+
+static RegionMark marks[MAX_REGION_DEPTH];
+static int depth;
+
+static void fail(const char* message, long len) {
+    jive_print_str(message, len);
+    jive_exit(1);
+}
+
+static Chunk* new_chunk(size_t min_size) {
+    size_t size = sizeof(Chunk) + min_size;
+    if (size < CHUNK_SIZE) {
+        size = CHUNK_SIZE;
+    }
+    Chunk* chunk = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+        static const char message[] = "Error: out of memory\n";
+        fail(message, sizeof(message) - 1);
+    }
+    chunk->end = (char*)chunk + size;
+    return chunk;
+}
+
+static void use_chunk(Chunk* chunk) {
+    current = chunk;
+    jive_region_bump = chunk->data;
+    jive_region_limit = chunk->end;
+}
+
+void jive_region_enter(void) {
+    if (depth == MAX_REGION_DEPTH) {
+        static const char message[] = "Error: region blocks nested too deeply\n";
+        fail(message, sizeof(message) - 1);
+    }
+    marks[depth].chunk = current;
+    marks[depth].bump = jive_region_bump;
+    depth++;
+}
+
+void jive_region_exit(void) {
+    depth--;
+    current = marks[depth].chunk;
+    jive_region_bump = marks[depth].bump;
+    jive_region_limit = current ? current->end : NULL;
+}
+
+void* jive_region_alloc(long size) {
+    size_t rounded = size > 0 ? ((size_t)size + 15) & ~(size_t)15 : 16;
+    if (jive_region_bump && (size_t)(jive_region_limit - jive_region_bump) >= rounded) {
+        char* result = jive_region_bump;
+        jive_region_bump += rounded;
+        return result;
+    }
+
+    // Move on to the next free chunk, or splice in a new one large enough
+    Chunk* next = current ? current->next : first_chunk;
+    if (!next || (size_t)(next->end - next->data) < rounded) {
+        Chunk* chunk = new_chunk(rounded);
+        chunk->next = next;
+        if (current) {
+            current->next = chunk;
+        } else {
+            first_chunk = chunk;
+        }
+        next = chunk;
+    }
+    use_chunk(next);
+    char* result = jive_region_bump;
+    jive_region_bump += rounded;
+    return result;
+}
+
+void* jive_region_filter(void* ptr) {
+    if (depth == 0 || !current || !ptr) {
+        return ptr;
+    }
+    char* p = ptr;
+    for (Chunk* chunk = first_chunk; chunk; chunk = chunk->next) {
+        char* used_end = chunk == current ? jive_region_bump : chunk->end;
+        if (p >= chunk->data && p < used_end) {
+            return NULL;
+        }
+        if (chunk == current) {
+            break;
+        }
+    }
+    return ptr;
+}
@@ -0,0 +1,450 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "runtime.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define HAVE_X86_SIMD 1
+#else
+#define HAVE_X86_SIMD 0
+#endif
+
+char* jive_str_new(long capacity) {
+    JiveStrHeader* header = jive_heap_alloc(sizeof(JiveStrHeader) + capacity + 1);
+    if (!header) {
+        static const char message[] = "Error: out of memory\n";
+        jive_print_str(message, sizeof(message) - 1);
+        jive_exit(1);
+    }
+    header->capacity = capacity;
+    header->length = 0;
+    char* data = (char*)(header + 1);
+    data[0] = '\0';
+    return data;
+}
+
+static char* str_from(const char* bytes, long len) {
+    char* str = jive_str_new(len);
+    memcpy(str, bytes, len);
+    str[len] = '\0';
+    jive_str_header(str)->length = len;
+    return str;
+}
+
+char* jive_str_concat(const char* a, const char* b) {
+    long a_len = jive_str_len(a);
+    long b_len = jive_str_len(b);
+    char* str = jive_str_new(a_len + b_len);
+    memcpy(str, a, a_len);
+    memcpy(str + a_len, b, b_len);
+    str[a_len + b_len] = '\0';
+    jive_str_header(str)->length = a_len + b_len;
+    return str;
+}
+
+// s + n and n + s: the integer contributes its decimal text
+static char* concat_int(const char* str, long value, int int_first) {
+    char digits[JIVE_INT_MAX_CHARS];
+    long digit_len = jive_format_int(digits, value);
+    long str_len = jive_str_len(str);
+    char* result = jive_str_new(str_len + digit_len);
+    memcpy(result + (int_first ? 0 : str_len), digits, digit_len);
+    memcpy(result + (int_first ? digit_len : 0), str, str_len);
+    result[str_len + digit_len] = '\0';
+    jive_str_header(result)->length = str_len + digit_len;
+    return result;
+}
+
+char* jive_str_concat_int(const char* str, long value) {
+    return concat_int(str, value, 0);
+}
+
+char* jive_int_concat_str(long value, const char* str) {
+    return concat_int(str, value, 1);
+}
+
+char* jive_str_substr(const char* str, long start, long count) {
+    long len = jive_str_len(str);
+    if (start < 0) start = 0;
+    if (start > len) start = len;
+    if (count < 0) count = 0;
+    if (count > len - start) count = len - start;
+    return str_from(str + start, count);
+}
+
+// Kernels. Each comes in a scalar, an SSE2 and an AVX2 flavor; the best one
+// the CPU supports is picked once through CPUID.
+
+typedef long (*MemEqFn)(const char* a, const char* b, long n);
+typedef long (*FindByteFn)(const char* str, long n, int byte);
+typedef long (*FindFn)(const char* str, long n, const char* needle, long m);
+typedef long (*CStrLenFn)(const char* str);
+
+static long memeq_scalar(const char* a, const char* b, long n) {
+    long i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) return 0;
+    }
+    for (; i < n; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static long find_byte_scalar(const char* str, long n, int byte) {
+    for (long i = 0; i < n; i++) {
+        if ((unsigned char)str[i] == (unsigned char)byte) return i;
+    }
+    return -1;
+}
+
+// Candidate positions from i on, checked one at a time
+static long find_tail(const char* str, long n, const char* needle, long m, long i) {
+    for (; i + m <= n; i++) {
+        if (str[i] == needle[0] && memcmp(str + i + 1, needle + 1, m - 1) == 0) return i;
+    }
+    return -1;
+}
+
+static long find_scalar(const char* str, long n, const char* needle, long m) {
+    return find_tail(str, n, needle, m, 0);
+}
+
+static long cstrlen_scalar(const char* str) {
+    const char* p = str;
+    while (*p) p++;
+    return p - str;
+}
+
+#if HAVE_X86_SIMD
+
+// The SSE2 kernels are always inlined so the AVX2 kernels can finish their
+// tails with them: inlined into an AVX2 function they are VEX-encoded, while
+// a call into legacy SSE code after 256-bit instructions pays a state
+// transition penalty
+#define SSE2_KERNEL static inline __attribute__((always_inline))
+
+SSE2_KERNEL long memeq_sse2(const char* a, const char* b, long n) {
+    long i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return 0;
+    }
+    return memeq_scalar(a + i, b + i, n - i);
+}
+
+SSE2_KERNEL long find_byte_sse2(const char* str, long n, int byte) {
+    __m128i target = _mm_set1_epi8((char)byte);
+    long i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(str + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    long rest = find_byte_scalar(str + i, n - i, byte);
+    return rest < 0 ? -1 : i + rest;
+}
+
+// Compare the needle's first and last bytes against 16 positions at once and
+// only memcmp where both match
+SSE2_KERNEL long find_sse2(const char* str, long n, const char* needle, long m) {
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[m - 1]);
+    long i = 0;
+    for (; i + 16 + m - 1 <= n; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i*)(str + i + m - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (m <= 2 || memcmp(str + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_tail(str, n, needle, m, i);
+}
+
+// Aligned loads never cross into the next page, so reading past the
+// terminator within the block is safe
+SSE2_KERNEL long cstrlen_sse2(const char* str) {
+    __m128i zero = _mm_setzero_si128();
+    uintptr_t offset = (uintptr_t)str & 15;
+    const char* p = str - offset;
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), zero));
+    mask >>= offset;
+    if (mask) return __builtin_ctz(mask);
+    for (;;) {
+        p += 16;
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)p), zero));
+        if (mask) return p + __builtin_ctz(mask) - str;
+    }
+}
+
+__attribute__((target("avx2")))
+static long memeq_avx2(const char* a, const char* b, long n) {
+    long i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        if ((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) return 0;
+    }
+    return memeq_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static long find_byte_avx2(const char* str, long n, int byte) {
+    __m256i target = _mm256_set1_epi8((char)byte);
+    long i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(str + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, target));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    long rest = find_byte_sse2(str + i, n - i, byte);
+    return rest < 0 ? -1 : i + rest;
+}
+
+__attribute__((target("avx2")))
+static long find_avx2(const char* str, long n, const char* needle, long m) {
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[m - 1]);
+    long i = 0;
+    for (; i + 32 + m - 1 <= n; i += 32) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i*)(str + i));
+        __m256i block_last = _mm256_loadu_si256((const __m256i*)(str + i + m - 1));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (m <= 2 || memcmp(str + i + bit + 1, needle + 1, m - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    if (i + m > n) return -1;
+    long rest = find_sse2(str + i, n - i, needle, m);
+    return rest < 0 ? -1 : i + rest;
+}
+
+__attribute__((target("avx2")))
+static long cstrlen_avx2(const char* str) {
+    __m256i zero = _mm256_setzero_si256();
+    uintptr_t offset = (uintptr_t)str & 31;
+    const char* p = str - offset;
+    unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), zero));
+    mask >>= offset;
+    if (mask) return __builtin_ctz(mask);
+    for (;;) {
+        p += 32;
+        mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256((const __m256i*)p), zero));
+        if (mask) return p + __builtin_ctz(mask) - str;
+    }
+}
+
+static int detect_simd_level(void) {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return JIVE_SIMD_SSE2;
+    }
+    // The OS must save the YMM registers on context switches
+    unsigned xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 6) != 6) {
+        return JIVE_SIMD_SSE2;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2)) {
+        return JIVE_SIMD_AVX2;
+    }
+    return JIVE_SIMD_SSE2;
+}
+
+#else
+
+static int detect_simd_level(void) {
+    return JIVE_SIMD_SCALAR;
+}
+
+#endif // HAVE_X86_SIMD
+
+// Until the first selection every pointer goes through a resolver, so
+// kernels work even when constructors do not run (the -nostartfiles _start)
+static long memeq_resolve(const char* a, const char* b, long n);
+static long find_byte_resolve(const char* str, long n, int byte);
+static long find_resolve(const char* str, long n, const char* needle, long m);
+static long cstrlen_resolve(const char* str);
+
+static MemEqFn memeq_impl = memeq_resolve;
+static FindByteFn find_byte_impl = find_byte_resolve;
+static FindFn find_impl = find_resolve;
+static CStrLenFn cstrlen_impl = cstrlen_resolve;
+static int simd_level = -1;
+
+int jive_str_simd_level(void) {
+    if (simd_level < 0) {
+        jive_str_use_simd(JIVE_SIMD_AVX2);
+    }
+    return simd_level;
+}
+
+int jive_str_use_simd(int level) {
+    int supported = detect_simd_level();
+    simd_level = level < supported ? level : supported;
+    memeq_impl = memeq_scalar;
+    find_byte_impl = find_byte_scalar;
+    find_impl = find_scalar;
+    cstrlen_impl = cstrlen_scalar;
+#if HAVE_X86_SIMD
+    if (simd_level == JIVE_SIMD_SSE2) {
+        memeq_impl = memeq_sse2;
+        find_byte_impl = find_byte_sse2;
+        find_impl = find_sse2;
+        cstrlen_impl = cstrlen_sse2;
+    } else if (simd_level == JIVE_SIMD_AVX2) {
+        memeq_impl = memeq_avx2;
+        find_byte_impl = find_byte_avx2;
+        find_impl = find_avx2;
+        cstrlen_impl = cstrlen_avx2;
+    }
+#endif
+    return simd_level;
+}
+
+__attribute__((constructor))
+static void select_kernels(void) {
+    jive_str_use_simd(JIVE_SIMD_AVX2);
+}
+
+static long memeq_resolve(const char* a, const char* b, long n) {
+    select_kernels();
+    return memeq_impl(a, b, n);
+}
+
+static long find_byte_resolve(const char* str, long n, int byte) {
+    select_kernels();
+    return find_byte_impl(str, n, byte);
+}
+
+static long find_resolve(const char* str, long n, const char* needle, long m) {
+    select_kernels();
+    return find_impl(str, n, needle, m);
+}
+
+static long cstrlen_resolve(const char* str) {
+    select_kernels();
+    return cstrlen_impl(str);
+}
+
+long jive_str_eq(const char* a, const char* b) {
+    long len = jive_str_len(a);
+    return len == jive_str_len(b) && memeq_impl(a, b, len);
+}
+
+long jive_str_starts_with(const char* str, const char* prefix) {
+    long len = jive_str_len(prefix);
+    return len <= jive_str_len(str) && memeq_impl(str, prefix, len);
+}
+
+long jive_str_find_byte(const char* str, long byte) {
+    return find_byte_impl(str, jive_str_len(str), (int)byte);
+}
+
+long jive_str_find(const char* str, const char* needle) {
+    long n = jive_str_len(str);
+    long m = jive_str_len(needle);
+    if (m == 0) return 0;
+    if (m > n) return -1;
+    return find_impl(str, n, needle, m);
+}
+
+long jive_cstr_len(const char* str) {
+    return cstrlen_impl(str);
+}
+
+char* jive_str_from_cstr(const char* str) {
+    return str_from(str, cstrlen_impl(str));
+}
+
+void jive_str_free(char* str) {
+    if (str) {
+        jive_heap_free(jive_str_header(str));
+    }
+}
+
+// Builders. The string a builder fills doubles its capacity whenever an
+// append would overflow it, so n appends copy O(n) bytes in total.
+
+JiveBuilder* jive_sb_new(void) {
+    JiveBuilder* sb = jive_heap_alloc(sizeof(JiveBuilder));
+    if (!sb) {
+        static const char message[] = "Error: out of memory\n";
+        jive_print_str(message, sizeof(message) - 1);
+        jive_exit(1);
+    }
+    sb->str = jive_str_new(JIVE_SB_MIN_CAPACITY);
+    return sb;
+}
+
+// Room for extra more bytes (plus the NUL) after the current length
+static char* sb_reserve(JiveBuilder* sb, long extra) {
+    JiveStrHeader* header = jive_str_header(sb->str);
+    long needed = header->length + extra;
+    if (needed <= header->capacity) {
+        return sb->str + header->length;
+    }
+    long capacity = header->capacity * 2;
+    if (capacity < needed) capacity = needed;
+    header = jive_heap_realloc(header, sizeof(JiveStrHeader) + capacity + 1);
+    if (!header) {
+        static const char message[] = "Error: out of memory\n";
+        jive_print_str(message, sizeof(message) - 1);
+        jive_exit(1);
+    }
+    header->capacity = capacity;
+    sb->str = (char*)(header + 1);
+    return sb->str + header->length;
+}
+
+JiveBuilder* jive_sb_append_str(JiveBuilder* sb, const char* str) {
+    long len = jive_str_len(str);
+    char* dest = sb_reserve(sb, len);
+    memcpy(dest, str, len);
+    dest[len] = '\0';
+    jive_str_header(sb->str)->length += len;
+    return sb;
+}
+
+JiveBuilder* jive_sb_append_int(JiveBuilder* sb, long value) {
+    char* dest = sb_reserve(sb, JIVE_INT_MAX_CHARS);
+    long len = jive_format_int(dest, value);
+    dest[len] = '\0';
+    jive_str_header(sb->str)->length += len;
+    return sb;
+}
+
+// The built bytes become the result without a copy; the builder restarts
+// with a fresh buffer
+char* jive_sb_finish(JiveBuilder* sb) {
+    char* str = sb->str;
+    sb->str = jive_str_new(JIVE_SB_MIN_CAPACITY);
+    return str;
+}
+
+void jive_sb_print(JiveBuilder* sb) {
+    JiveStrHeader* header = jive_str_header(sb->str);
+    jive_print_str(sb->str, header->length);
+    header->length = 0;
+    sb->str[0] = '\0';
+}
+
+void jive_sb_free(JiveBuilder* sb) {
+    if (sb) {
+        jive_str_free(sb->str);
+        jive_heap_free(sb);
+    }
+}
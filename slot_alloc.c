@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "slot_alloc.h"
+
+#define LABEL_BUCKETS 256
+
+// Each slot that is only ever loaded, stored or spilled into is a variable.
+// Liveness is computed per basic block over the function's IR, then each
+// variable's lifetime is the span of instructions, in IR order, from the first
+// to the last point where it is live. Variables whose spans do not overlap
+// share a slot. Everything else in the frame (stack-allocated mallocs from
+// FRAME_ADDR and their alignment padding) is pinned: it keeps its size and
+// moves down below the variables as a whole.
+
+typedef struct LabelEntry {
+    const char* name;
+    int index;
+    struct LabelEntry* next;
+} LabelEntry;
+
+typedef struct {
+    int first, last;  // Instruction indices
+    int succ[2];      // Successor blocks, -1 for none
+} Block;
+
+typedef struct {
+    int start, end;
+    int var;
+} Lifetime;
+
+// State for the function being allocated
+static IRInstruction** code;  // Its instructions in order
+static int n;
+static int slot_count;
+static int* var_of_slot;      // Variable number per slot, -1 if pinned
+static int var_count;
+static LabelEntry* labels[LABEL_BUCKETS];
+static Block* blocks;
+static int* block_of;         // Block per instruction
+static int block_count;
+static int words;             // Per variable bitset
+static uint64_t* live_in;
+static uint64_t* live_out;
+
+static unsigned hash_label(const char* name) {
+    unsigned hash = 5381;
+    for (; *name; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash % LABEL_BUCKETS;
+}
+
+static int find_label(const char* name) {
+    for (LabelEntry* e = labels[hash_label(name)]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            return e->index;
+        }
+    }
+    return -1;
+}
+
+// Slot index (1 = [rbp-8]) an instruction loads, stores or spills into, or 0
+static int slot_of(IRInstruction* instr) {
+    if ((instr->op != IR_LOAD && instr->op != IR_STORE && instr->op != IR_PARAM) ||
+        instr->operand >= 0 || instr->operand % 8) {
+        return 0;
+    }
+    int slot = -instr->operand / 8;
+    return slot <= slot_count ? slot : 0;
+}
+
+static int ends_block(IROp op) {
+    return op == IR_JMP || op == IR_JZ || op == IR_JNZ || op == IR_RET || op == IR_TAILCALL ||
+           op == IR_COLD_BEGIN || op == IR_COLD_END;
+}
+
+// Where control goes after falling off instruction i. Cold code is moved out
+// of line by the backend, so the hot code before COLD_BEGIN continues after
+// the matching COLD_END.
+static int fallthrough(int i) {
+    int j = i + 1;
+    while (j < n && code[j]->op == IR_COLD_BEGIN) {
+        while (j < n && code[j]->op != IR_COLD_END) {
+            j++;
+        }
+        j++;
+    }
+    return j < n ? j : -1;
+}
+
+static int compare_lifetimes(const void* a, const void* b) {
+    const Lifetime* x = a;
+    const Lifetime* y = b;
+    return x->start != y->start ? (x->start < y->start ? -1 : 1) : x->var - y->var;
+}
+
+static void extend(Lifetime* life, int index) {
+    if (index < life->start) life->start = index;
+    if (index > life->end) life->end = index;
+}
+
+// Number the variables; the slots left over are pinned
+static void collect(IRInstruction* first) {
+    n = 0;
+    for (IRInstruction* instr = first; instr; instr = instr->next) {
+        n++;
+    }
+    code = malloc(n * sizeof(IRInstruction*));
+    n = 0;
+    for (IRInstruction* instr = first; instr; instr = instr->next) {
+        code[n++] = instr;
+    }
+    var_of_slot = malloc((slot_count + 1) * sizeof(int));
+    for (int s = 0; s <= slot_count; s++) {
+        var_of_slot[s] = -1;
+    }
+    var_count = 0;
+    for (int i = 0; i < n; i++) {
+        int slot = slot_of(code[i]);
+        if (slot && var_of_slot[slot] < 0) {
+            var_of_slot[slot] = var_count++;
+        }
+    }
+}
+
+// Returns 0 if a jump leaves for a label outside the function
+static int build_blocks(void) {
+    block_of = malloc(n * sizeof(int));
+    block_count = 0;
+    for (int i = 0; i < n; i++) {
+        if (i == 0 || code[i]->op == IR_LABEL || code[i]->op == IR_COLD_BEGIN ||
+            code[i]->op == IR_COLD_END || ends_block(code[i - 1]->op)) {
+            block_count++;
+        }
+        block_of[i] = block_count - 1;
+        if (code[i]->op == IR_LABEL && code[i]->label) {
+            LabelEntry* e = malloc(sizeof(LabelEntry));
+            e->name = code[i]->label;
+            e->index = i;
+            unsigned bucket = hash_label(e->name);
+            e->next = labels[bucket];
+            labels[bucket] = e;
+        }
+    }
+    blocks = malloc(block_count * sizeof(Block));
+    for (int i = 0; i < n; i++) {
+        Block* b = &blocks[block_of[i]];
+        if (i == 0 || block_of[i - 1] != block_of[i]) {
+            b->first = i;
+        }
+        b->last = i;
+    }
+    for (int b = 0; b < block_count; b++) {
+        IRInstruction* last = code[blocks[b].last];
+        int target = -1, next = -1;
+        if (last->op == IR_JMP || last->op == IR_JZ || last->op == IR_JNZ) {
+            target = find_label(last->label);
+            if (target < 0) {
+                return 0;
+            }
+        }
+        if (last->op != IR_JMP && last->op != IR_RET && last->op != IR_TAILCALL) {
+            next = fallthrough(blocks[b].last);
+        }
+        blocks[b].succ[0] = target >= 0 ? block_of[target] : -1;
+        blocks[b].succ[1] = next >= 0 ? block_of[next] : -1;
+    }
+    return 1;
+}
+
+// Live variables on entry to and exit from each block, iterated to a fixed point
+static void compute_liveness(void) {
+    words = (var_count + 63) / 64;
+    size_t size = (size_t)block_count * words;
+    uint64_t* use = calloc(size, sizeof(uint64_t));
+    uint64_t* def = calloc(size, sizeof(uint64_t));
+    live_in = calloc(size, sizeof(uint64_t));
+    live_out = calloc(size, sizeof(uint64_t));
+    for (int b = 0; b < block_count; b++) {
+        uint64_t* u = use + (size_t)b * words;
+        uint64_t* d = def + (size_t)b * words;
+        for (int i = blocks[b].first; i <= blocks[b].last; i++) {
+            int slot = slot_of(code[i]);
+            if (!slot) continue;
+            int v = var_of_slot[slot];
+            uint64_t bit = 1ULL << (v % 64);
+            if (code[i]->op == IR_LOAD) {
+                if (!(d[v / 64] & bit)) u[v / 64] |= bit;
+            } else {
+                d[v / 64] |= bit;
+            }
+        }
+    }
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int b = block_count - 1; b >= 0; b--) {
+            uint64_t* in = live_in + (size_t)b * words;
+            uint64_t* out = live_out + (size_t)b * words;
+            for (int w = 0; w < words; w++) {
+                uint64_t o = 0;
+                for (int s = 0; s < 2; s++) {
+                    if (blocks[b].succ[s] >= 0) {
+                        o |= live_in[(size_t)blocks[b].succ[s] * words + w];
+                    }
+                }
+                uint64_t i = use[(size_t)b * words + w] | (o & ~def[(size_t)b * words + w]);
+                if (o != out[w] || i != in[w]) {
+                    out[w] = o;
+                    in[w] = i;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    free(use);
+    free(def);
+}
+
+// Interval coloring in order of start: reuse the lowest slot whose last
+// occupant is dead by then. Returns the new slot count.
+static int assign_slots(void) {
+    // Lifetimes: every access, and the ends of the blocks a variable is live across
+    Lifetime* lives = malloc(var_count * sizeof(Lifetime));
+    for (int v = 0; v < var_count; v++) {
+        lives[v].start = INT_MAX;
+        lives[v].end = -1;
+        lives[v].var = v;
+    }
+    for (int i = 0; i < n; i++) {
+        int slot = slot_of(code[i]);
+        if (slot) {
+            extend(&lives[var_of_slot[slot]], i);
+        }
+    }
+    for (int b = 0; b < block_count; b++) {
+        for (int v = 0; v < var_count; v++) {
+            uint64_t bit = 1ULL << (v % 64);
+            if (live_in[(size_t)b * words + v / 64] & bit) {
+                extend(&lives[v], blocks[b].first);
+            }
+            if (live_out[(size_t)b * words + v / 64] & bit) {
+                extend(&lives[v], blocks[b].last);
+            }
+        }
+    }
+
+    int* color_end = malloc(var_count * sizeof(int));
+    int* color_of_var = malloc(var_count * sizeof(int));
+    int color_count = 0;
+    qsort(lives, var_count, sizeof(Lifetime), compare_lifetimes);
+    for (int k = 0; k < var_count; k++) {
+        int c = 0;
+        while (c < color_count && color_end[c] >= lives[k].start) {
+            c++;
+        }
+        if (c == color_count) {
+            color_count++;
+        }
+        color_end[c] = lives[k].end;
+        color_of_var[lives[k].var] = c;
+    }
+
+    // Color c is slot c + 1. The pinned slots follow in runs, each moved by
+    // an even number of slots so stack allocations stay 16-byte aligned.
+    int* pinned_slot = malloc((slot_count + 1) * sizeof(int));
+    int result = color_count;
+    for (int s = 1; s <= slot_count; ) {
+        if (var_of_slot[s] >= 0) {
+            s++;
+            continue;
+        }
+        int end = s;
+        while (end < slot_count && var_of_slot[end + 1] < 0) {
+            end++;
+        }
+        int base = result + 1;
+        if ((base - s) % 2) {
+            base++;
+        }
+        for (int k = s; k <= end; k++) {
+            pinned_slot[k] = base + (k - s);
+        }
+        result = base + (end - s);
+        s = end + 1;
+    }
+    for (int i = 0; i < n; i++) {
+        int old = slot_of(code[i]);
+        if (old) {
+            code[i]->operand = -(color_of_var[var_of_slot[old]] + 1) * 8;
+        } else if (code[i]->op == IR_FRAME_ADDR && code[i]->operand < 0 && code[i]->operand % 8 == 0 &&
+                   -code[i]->operand / 8 <= slot_count) {
+            code[i]->operand = -pinned_slot[-code[i]->operand / 8] * 8;
+        }
+    }
+    free(pinned_slot);
+    free(color_of_var);
+    free(color_end);
+    free(lives);
+    return result;
+}
+
+static void free_state(void) {
+    for (int b = 0; b < LABEL_BUCKETS; b++) {
+        while (labels[b]) {
+            LabelEntry* next = labels[b]->next;
+            free(labels[b]);
+            labels[b] = next;
+        }
+    }
+    free(live_in);
+    free(live_out);
+    free(blocks);
+    free(block_of);
+    free(var_of_slot);
+    free(code);
+    live_in = live_out = NULL;
+    blocks = NULL;
+    block_of = NULL;
+}
+
+int allocate_slots(IRInstruction* first, int slots) {
+    if (slots == 0) {
+        return 0;
+    }
+    slot_count = slots;
+    collect(first);
+    int result = slot_count;
+    if (var_count && build_blocks()) {
+        compute_liveness();
+        result = assign_slots();
+    }
+    free_state();
+    return result;
+}
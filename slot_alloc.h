@@ -0,0 +1,12 @@
+#ifndef SLOT_ALLOC_H
+#define SLOT_ALLOC_H
+
+#include "stack_machine_ir.h"
+
+// Give variables whose lifetimes never overlap the same frame slot. first is
+// the function's label and the IR up to the end of the list is its body;
+// slot_count is the number of 8-byte slots codegen handed out. LOAD, STORE
+// and PARAM operands are rewritten in place and the new slot count returned.
+int allocate_slots(IRInstruction* first, int slot_count);
+
+#endif // SLOT_ALLOC_H
@@ -1,7 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include "stack_machine.h"
+#include "symbol_table.h"
+#include "options.h"
+#include "runtime.h"
+#include "assembler.h"
+#include "elf64.h"
 
 static const char* get_op_name(IROp op) {
     switch (op) {
@@ -12,18 +18,42 @@ static const char* get_op_name(IROp op) {
         case IR_SUB: return "SUB";
         case IR_MUL: return "MUL";
         case IR_DIV: return "DIV";
+        case IR_MULI: return "MULI";
+        case IR_DIVI: return "DIVI";
         case IR_LOAD: return "LOAD";
         case IR_STORE: return "STORE";
         case IR_CALL: return "CALL";
         case IR_RET: return "RET";
+        case IR_ENTER: return "ENTER";
+        case IR_PARAM: return "PARAM";
+        case IR_ARGS: return "ARGS";
+        case IR_TAILCALL: return "TAILCALL";
         case IR_JMP: return "JMP";
         case IR_JZ: return "JZ";
         case IR_JNZ: return "JNZ";
         case IR_LABEL: return "LABEL";
         case IR_CMP: return "CMP";
-        case IR_PRINT: return "PRINT";
+        case IR_PRINT_INT: return "PRINT_INT";
+        case IR_PRINT_STR: return "PRINT_STR";
+        case IR_STR_LEN: return "STR_LEN";
+        case IR_INDEX_LOAD: return "INDEX_LOAD";
+        case IR_INDEX_STORE: return "INDEX_STORE";
+        case IR_VEC_LOAD: return "VEC_LOAD";
+        case IR_VEC_SPLAT: return "VEC_SPLAT";
+        case IR_VEC_ADD: return "VEC_ADD";
+        case IR_VEC_SUB: return "VEC_SUB";
+        case IR_VEC_STORE: return "VEC_STORE";
+        case IR_VEC_ALIAS: return "VEC_ALIAS";
+        case IR_VEC_END: return "VEC_END";
         case IR_MALLOC: return "MALLOC";
+        case IR_FRAME_ADDR: return "FRAME_ADDR";
+        case IR_REGION_ENTER: return "REGION_ENTER";
+        case IR_REGION_EXIT: return "REGION_EXIT";
+        case IR_REGION_ALLOC: return "REGION_ALLOC";
         case IR_FREE: return "FREE";
+        case IR_HEAP_SITE: return "HEAP_SITE";
+        case IR_COLD_BEGIN: return "COLD_BEGIN";
+        case IR_COLD_END: return "COLD_END";
         default: return "UNKNOWN";
     }
 }
@@ -40,20 +70,480 @@ static const char* get_cmp_name(int cmp_op) {
     }
 }
 
-void generate_assembly(IRProgram* program, const char* output_file) {
-    FILE* f = fopen(output_file, "w");
-    if (!f) {
-        fprintf(stderr, "Error: cannot open output file '%s'\n", output_file);
-        exit(1);
+// Detect platform (macOS vs Linux)
+#ifdef __APPLE__
+#define PLATFORM_MACOS 1
+#else
+#define PLATFORM_MACOS 0
+#endif
+
+static const char* runtime_functions[] = {
+    "jive_print_int", "jive_print_str", "jive_exit", "jive_bounds_error", NULL
+};
+
+static const char* heap_profile_functions[] = {
+    "jive_prof_alloc", "jive_prof_free", "jive_heap_site", NULL
+};
+
+static const char* pool_functions[] = {
+    "jive_alloc", "jive_free", "jive_pool_refill", "jive_pool_heads", NULL
+};
+
+static const char* region_functions[] = {
+    "jive_region_enter", "jive_region_exit", "jive_region_alloc", "jive_region_filter",
+    "jive_region_bump", "jive_region_limit", NULL
+};
+
+static const char* arg_regs[MAX_REG_PARAMS] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+
+// Operand stack depth (in 8-byte slots) relative to the aligned frame, used to
+// keep rsp 16-byte aligned at every call site
+static int stack_depth;
+static int param_index;
+static int pool_label_counter;
+static int uses_bounds_checks;
+static int vec_depth;  // Vector values live in xmm/ymm0, 1, ... like a second stack
+static int profile_counter;  // Next -fprofile-generate counter, in instruction order
+static const char* open_function;  // Label of the function being emitted
+
+// Cold code of the open function, collected between IR_COLD_BEGIN and
+// IR_COLD_END and written to .text.unlikely once the function is closed
+static FILE* hot_text;
+static FILE* cold_text;
+static char* cold_buffer;
+static size_t cold_size;
+static int cold_depth;
+
+#define TEXT_UNLIKELY "section .text.unlikely progbits alloc exec nowrite align=16"
+
+// Alignment padding pushed by each in-flight IR_ARGS, innermost on top
+#define MAX_CALL_NESTING 256
+static int call_pad[MAX_CALL_NESTING];
+static int call_pad_top;
+
+// Functions the program defines and externs declared so far, so emitting a
+// call does not rescan the whole program
+#define NAME_BUCKETS 1024
+
+typedef struct NameEntry {
+    const char* name;
+    struct NameEntry* next;
+} NameEntry;
+
+static NameEntry* defined_functions[NAME_BUCKETS];
+static NameEntry* declared_externs[NAME_BUCKETS];
+
+static unsigned hash_name(const char* name) {
+    unsigned hash = 5381;
+    for (; *name; name++) {
+        hash = hash * 33 + (unsigned char)*name;
+    }
+    return hash % NAME_BUCKETS;
+}
+
+static int name_in(NameEntry** set, const char* name) {
+    for (NameEntry* e = set[hash_name(name)]; e; e = e->next) {
+        if (strcmp(e->name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void name_add(NameEntry** set, const char* name) {
+    unsigned bucket = hash_name(name);
+    NameEntry* e = malloc(sizeof(NameEntry));
+    e->name = name;
+    e->next = set[bucket];
+    set[bucket] = e;
+}
+
+static void clear_names(NameEntry** set) {
+    for (int i = 0; i < NAME_BUCKETS; i++) {
+        while (set[i]) {
+            NameEntry* next = set[i]->next;
+            free(set[i]);
+            set[i] = next;
+        }
+    }
+}
+
+// Jive functions are emitted as "_name"; anything called but not defined is
+// treated as an external C function and uses the platform's C symbol name
+static int is_defined_function(const char* label) {
+    return name_in(defined_functions, label);
+}
+
+static const char* call_target(const char* label) {
+    if (PLATFORM_MACOS || is_defined_function(label)) {
+        return label;
+    }
+    return label + 1;  // Strip the Jive "_" prefix to get the C name
+}
+
+// Call a C library or runtime routine whose arguments are already in registers
+static void emit_c_call(FILE* f, const char* name) {
+    int pad = stack_depth % 2;
+    if (pad) {
+        fprintf(f, "    sub rsp, 8\n");
+    }
+    if (PLATFORM_MACOS) {
+        fprintf(f, "    call _%s\n", name);
+    } else {
+        fprintf(f, "    call %s\n", name);
+    }
+    if (pad) {
+        fprintf(f, "    add rsp, 8\n");
+    }
+}
+
+// Inline pool allocation for a size class known at compile time: pop the
+// class free list, calling the runtime only when it is empty. Result in rax.
+static void emit_pool_alloc(FILE* f, int size_class) {
+    const char* prefix = PLATFORM_MACOS ? "_" : "";
+    int id = pool_label_counter++;
+    fprintf(f, "    mov rax, [rel %sjive_pool_heads + %d]\n", prefix, size_class * 8);
+    fprintf(f, "    test rax, rax\n");
+    fprintf(f, "    jz pool_refill_%d\n", id);
+    fprintf(f, "    mov rcx, [rax]\n");
+    fprintf(f, "    mov [rel %sjive_pool_heads + %d], rcx\n", prefix, size_class * 8);
+    fprintf(f, "    jmp pool_done_%d\n", id);
+    fprintf(f, "pool_refill_%d:\n", id);
+    fprintf(f, "    mov edi, %d\n", size_class);
+    emit_c_call(f, "jive_pool_refill");
+    fprintf(f, "pool_done_%d:\n", id);
+}
+
+// Inline pool free of the pointer in rax: read the class from the slab
+// header and push the object on its free list. NULL is ignored and large
+// allocations go to jive_free.
+static void emit_pool_free(FILE* f) {
+    const char* prefix = PLATFORM_MACOS ? "_" : "";
+    int id = pool_label_counter++;
+    fprintf(f, "    test rax, rax\n");
+    fprintf(f, "    jz pool_done_%d\n", id);
+    fprintf(f, "    mov rcx, rax\n");
+    fprintf(f, "    and rcx, -%d\n", JIVE_POOL_SLAB_SIZE);
+    fprintf(f, "    mov rcx, [rcx]\n");
+    fprintf(f, "    cmp rcx, %d\n", JIVE_POOL_CLASSES);
+    fprintf(f, "    jae pool_large_%d\n", id);
+    fprintf(f, "    lea rdx, [rel %sjive_pool_heads]\n", prefix);
+    fprintf(f, "    mov rsi, [rdx + rcx*8]\n");
+    fprintf(f, "    mov [rax], rsi\n");
+    fprintf(f, "    mov [rdx + rcx*8], rax\n");
+    fprintf(f, "    jmp pool_done_%d\n", id);
+    fprintf(f, "pool_large_%d:\n", id);
+    fprintf(f, "    mov rdi, rax\n");
+    emit_c_call(f, "jive_free");
+    fprintf(f, "pool_done_%d:\n", id);
+}
+
+// Inline bump allocation of a constant size from the innermost region,
+// calling the runtime when the current chunk is full. Result in rax.
+static void emit_region_alloc(FILE* f, int size) {
+    const char* prefix = PLATFORM_MACOS ? "_" : "";
+    int id = pool_label_counter++;
+    int rounded = size > 0 ? (size + 15) & ~15 : 16;
+    fprintf(f, "    mov rax, [rel %sjive_region_bump]\n", prefix);
+    fprintf(f, "    lea rcx, [rax + %d]\n", rounded);
+    fprintf(f, "    cmp rcx, [rel %sjive_region_limit]\n", prefix);
+    fprintf(f, "    ja region_refill_%d\n", id);
+    fprintf(f, "    mov [rel %sjive_region_bump], rcx\n", prefix);
+    fprintf(f, "    jmp region_done_%d\n", id);
+    fprintf(f, "region_refill_%d:\n", id);
+    fprintf(f, "    mov edi, %d\n", size);
+    emit_c_call(f, "jive_region_alloc");
+    fprintf(f, "region_done_%d:\n", id);
+}
+
+// NASM strings have no escapes, so quotes and control characters (such as the
+// newlines of coalesced prints) are written as byte values
+static void emit_string_bytes(FILE* f, const char* s) {
+    int in_quotes = 0;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c < 0x7f && c != '"') {
+            if (!in_quotes) {
+                fprintf(f, "\"");
+                in_quotes = 1;
+            }
+            fputc(c, f);
+        } else {
+            if (in_quotes) {
+                fprintf(f, "\", ");
+                in_quotes = 0;
+            }
+            fprintf(f, "%d, ", c);
+        }
+    }
+    if (in_quotes) {
+        fprintf(f, "\", ");
+    }
+    fprintf(f, "0\n");
+}
+
+static int is_heap_site(IRInstruction* instr) {
+    return (instr->op == IR_MALLOC || instr->op == IR_FREE || instr->op == IR_HEAP_SITE) &&
+           instr->label;
+}
+
+static IRInstruction* first_heap_site(IRProgram* program, const char* site) {
+    for (IRInstruction* instr = program->head; instr; instr = instr->next) {
+        if (is_heap_site(instr) && strcmp(instr->label, site) == 0) {
+            return instr;
+        }
+    }
+    return NULL;
+}
+
+// "function:line" becomes site_function_line; the line has no '_', so
+// distinct sites get distinct labels
+static void emit_site_label(FILE* f, const char* site) {
+    fprintf(f, "site_");
+    for (; *site; site++) {
+        fputc(*site == ':' ? '_' : *site, f);
+    }
+}
+
+// Label of a Jive function: the prologue follows it
+static int is_function_start(IRInstruction* instr) {
+    return instr->op == IR_LABEL && instr->next && instr->next->op == IR_ENTER;
+}
+
+// End label of the function being emitted, which sizes its ELF symbol, then
+// its cold code. The linker gathers .text.unlikely from every object in one
+// place, away from the hot code; Mach-O keeps it after the function.
+static void close_function(FILE* f) {
+    if (open_function && !PLATFORM_MACOS) {
+        fprintf(f, "%s.end:\n", open_function);
     }
+    if (cold_text) {
+        fclose(cold_text);
+        cold_text = NULL;
+        if (!PLATFORM_MACOS) {
+            fprintf(f, "%s\n", TEXT_UNLIKELY);
+        }
+        if (open_function) {
+            fprintf(f, "%s.cold:\n", open_function);
+        }
+        fwrite(cold_buffer, 1, cold_size, f);
+        if (!PLATFORM_MACOS) {
+            fprintf(f, "section .text\n");
+        }
+        free(cold_buffer);
+        cold_buffer = NULL;
+    }
+    open_function = NULL;
+}
+
+// Counters an instruction owns under -fprofile-generate: one for labels and
+// calls, one per direction for conditional branches
+static int counter_slots(IRInstruction* instr) {
+    if (!options.profile_generate || !instr->profile_key) {
+        return 0;
+    }
+    return (instr->op == IR_JZ || instr->op == IR_JNZ) ? 2 : 1;
+}
+
+static void emit_counter_inc(FILE* f, int index) {
+    fprintf(f, "    inc qword [rel pgo_counters + %d]\n", index * 8);
+}
+
+// The table runtime_pgo.c reads at exit: counter count, the counters and a
+// name for each; branch counters are named key/taken and key/fallthrough
+static void emit_profile_table(FILE* f, IRProgram* program) {
+    const char* prefix = PLATFORM_MACOS ? "_" : "";
+    int count = 0;
+    for (IRInstruction* instr = program->head; instr; instr = instr->next) {
+        count += counter_slots(instr);
+    }
+    fprintf(f, "align 8\n");
+    fprintf(f, "global %sjive_pgo_table\n", prefix);
+    fprintf(f, "%sjive_pgo_table: dq %d, pgo_counters, pgo_names\n", prefix, count);
+    fprintf(f, "pgo_names:\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "    dq pgo_name_%d\n", i);
+    }
+    int index = 0;
+    for (IRInstruction* instr = program->head; instr; instr = instr->next) {
+        int slots = counter_slots(instr);
+        for (int i = 0; i < slots; i++) {
+            char* name = malloc(strlen(instr->profile_key) + 16);
+            if (slots == 2) {
+                sprintf(name, "%s/%s", instr->profile_key, i == 0 ? "taken" : "fallthrough");
+            } else {
+                strcpy(name, instr->profile_key);
+            }
+            fprintf(f, "pgo_name_%d: db ", index++);
+            emit_string_bytes(f, name);
+            free(name);
+        }
+    }
+    fprintf(f, "section .bss\n");
+    fprintf(f, "alignb 8\n");
+    fprintf(f, "pgo_counters: resq %d\n", count > 0 ? count : 1);
+}
+
+// Conditional branch that counts the direction it takes: taken bumps the
+// first of the instruction's two counters, falling through the second
+static void emit_counted_branch(FILE* f, const char* inverse, const char* target,
+                                int instruction_num) {
+    fprintf(f, "    %s .pgo_fall_%d\n", inverse, instruction_num);
+    emit_counter_inc(f, profile_counter);
+    fprintf(f, "    jmp %s\n", target);
+    fprintf(f, ".pgo_fall_%d:\n", instruction_num);
+    emit_counter_inc(f, profile_counter + 1);
+    profile_counter += 2;
+}
+
+static int log2_exact(uint64_t value) {
+    if (value == 0 || (value & (value - 1)) != 0) {
+        return -1;
+    }
+    int shift = 0;
+    while ((value >> shift) != 1) {
+        shift++;
+    }
+    return shift;
+}
+
+// rax = rax * k using shifts, adds and lea instead of imul where possible
+static void emit_mul_const(FILE* f, int64_t k) {
+    uint64_t mag = k < 0 ? -(uint64_t)k : (uint64_t)k;
+    int shift;
+    
+    if (k == 0) {
+        fprintf(f, "    xor eax, eax\n");
+        return;
+    }
+    
+    if ((shift = log2_exact(mag)) >= 0) {
+        if (shift > 0) {
+            fprintf(f, "    shl rax, %d\n", shift);
+        }
+    } else if (mag % 9 == 0 && log2_exact(mag / 9) >= 0) {
+        fprintf(f, "    lea rax, [rax + rax*8]\n");
+        if ((shift = log2_exact(mag / 9)) > 0) fprintf(f, "    shl rax, %d\n", shift);
+    } else if (mag % 5 == 0 && log2_exact(mag / 5) >= 0) {
+        fprintf(f, "    lea rax, [rax + rax*4]\n");
+        if ((shift = log2_exact(mag / 5)) > 0) fprintf(f, "    shl rax, %d\n", shift);
+    } else if (mag % 3 == 0 && log2_exact(mag / 3) >= 0) {
+        fprintf(f, "    lea rax, [rax + rax*2]\n");
+        if ((shift = log2_exact(mag / 3)) > 0) fprintf(f, "    shl rax, %d\n", shift);
+    } else if ((shift = log2_exact(mag - 1)) >= 0) {
+        fprintf(f, "    mov rcx, rax\n");
+        fprintf(f, "    shl rax, %d\n", shift);
+        fprintf(f, "    add rax, rcx\n");
+    } else if ((shift = log2_exact(mag + 1)) >= 0) {
+        fprintf(f, "    mov rcx, rax\n");
+        fprintf(f, "    shl rax, %d\n", shift);
+        fprintf(f, "    sub rax, rcx\n");
+    } else {
+        fprintf(f, "    imul rax, rax, %lld\n", (long long)k);
+        return;
+    }
+    
+    if (k < 0) {
+        fprintf(f, "    neg rax\n");
+    }
+}
+
+// Magic multiplier and shift for signed 64-bit division by d, |d| >= 2
+// (Hacker's Delight, figure 10-1)
+static void div_magic(int64_t d, int64_t* magic, int* shift) {
+    const uint64_t two63 = 1ULL << 63;
+    uint64_t ad = d < 0 ? -(uint64_t)d : (uint64_t)d;
+    uint64_t t = two63 + ((uint64_t)d >> 63);
+    uint64_t anc = t - 1 - t % ad;
+    int p = 63;
+    uint64_t q1 = two63 / anc;
+    uint64_t r1 = two63 - q1 * anc;
+    uint64_t q2 = two63 / ad;
+    uint64_t r2 = two63 - q2 * ad;
+    uint64_t delta;
     
-    // Detect platform (macOS vs Linux)
-    #ifdef __APPLE__
-    #define PLATFORM_MACOS 1
-    #else
-    #define PLATFORM_MACOS 0
-    #endif
+    do {
+        p++;
+        q1 = 2 * q1;
+        r1 = 2 * r1;
+        if (r1 >= anc) {
+            q1++;
+            r1 -= anc;
+        }
+        q2 = 2 * q2;
+        r2 = 2 * r2;
+        if (r2 >= ad) {
+            q2++;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    
+    *magic = (int64_t)(q2 + 1);
+    if (d < 0) {
+        *magic = -*magic;
+    }
+    *shift = p - 64;
+}
+
+// rax = rax / d truncating toward zero like idiv, without a divide.
+// Clobbers rcx and rdx.
+static void emit_div_const(FILE* f, int64_t d) {
+    uint64_t mag = d < 0 ? -(uint64_t)d : (uint64_t)d;
+    int shift = log2_exact(mag);
+    
+    if (mag == 1) {
+        // x / -1 wraps for the most negative value instead of trapping
+        if (d < 0) {
+            fprintf(f, "    neg rax\n");
+        }
+        return;
+    }
     
+    if (shift > 0) {
+        // Bias negative dividends by 2^k - 1 so the arithmetic shift rounds toward zero
+        fprintf(f, "    mov rcx, rax\n");
+        fprintf(f, "    sar rcx, 63\n");
+        fprintf(f, "    shr rcx, %d\n", 64 - shift);
+        fprintf(f, "    add rax, rcx\n");
+        fprintf(f, "    sar rax, %d\n", shift);
+        if (d < 0) {
+            fprintf(f, "    neg rax\n");
+        }
+        return;
+    }
+    
+    int64_t magic;
+    div_magic(d, &magic, &shift);
+    fprintf(f, "    mov rcx, rax\n");
+    fprintf(f, "    mov rax, %lld\n", (long long)magic);
+    fprintf(f, "    imul rcx\n");  // rdx = high 64 bits of n * magic
+    if (d > 0 && magic < 0) {
+        fprintf(f, "    add rdx, rcx\n");
+    } else if (d < 0 && magic > 0) {
+        fprintf(f, "    sub rdx, rcx\n");
+    }
+    if (shift > 0) {
+        fprintf(f, "    sar rdx, %d\n", shift);
+    }
+    // Add one for negative quotients to round toward zero
+    fprintf(f, "    mov rax, rdx\n");
+    fprintf(f, "    shr rax, 63\n");
+    fprintf(f, "    add rax, rdx\n");
+}
+
+static void write_assembly(IRProgram* program, FILE* f) {
+    if (PLATFORM_MACOS && options.freestanding) {
+        fprintf(stderr, "Error: -ffreestanding needs Linux system calls\n");
+        exit(1);
+    }
+    for (IRInstruction* fn = program->head; fn; fn = fn->next) {
+        if (fn->op == IR_LABEL && fn->next && fn->next->op == IR_ENTER &&
+            !name_in(defined_functions, fn->label)) {
+            name_add(defined_functions, fn->label);
+        }
+    }
+
     // Collect string literals first
     IRInstruction* instr = program->head;
     int string_counter = 0;
@@ -64,36 +554,91 @@ void generate_assembly(IRProgram* program, const char* output_file) {
         instr = instr->next;
     }
     
-    // Write data section for string literals and format strings
-    fprintf(f, "section .data\n");
+    // Read-only data: string literals, each preceded by the string header
+    // (capacity and length, both the literal's length)
+    fprintf(f, "section .rodata\n");
     if (string_counter > 0) {
         instr = program->head;
         int str_idx = 0;
         while (instr) {
             if (instr->op == IR_PUSH_STR && instr->str_value) {
-                fprintf(f, "str_%d: db \"%s\", 0\n", str_idx, instr->str_value);
+                size_t len = strlen(instr->str_value);
+                fprintf(f, "align 8\n");
+                fprintf(f, "    dq %zu, %zu\n", len, len);
+                fprintf(f, "str_%d: db ", str_idx);
+                emit_string_bytes(f, instr->str_value);
                 str_idx++;
             }
             instr = instr->next;
         }
     }
-    // Add format strings for printf
-    fprintf(f, "fmt_int: db \"%%d\", 10, 0\n");
-    fprintf(f, "fmt_str: db \"%%s\", 0\n");
+    // Allocation sites for the heap profiler, one string per source location
+    if (options.heap_profile) {
+        for (instr = program->head; instr; instr = instr->next) {
+            if (is_heap_site(instr) && first_heap_site(program, instr->label) == instr) {
+                emit_site_label(f, instr->label);
+                fprintf(f, ": db ");
+                emit_string_bytes(f, instr->label);
+            }
+        }
+    }
+    if (options.profile_generate) {
+        fprintf(f, "section .data\n");
+        emit_profile_table(f, program);
+    }
     fprintf(f, "\n");
     
     if (PLATFORM_MACOS) {
         fprintf(f, "section .text\n");
-        fprintf(f, "global _main\n");
-        fprintf(f, "extern _printf\n");
         fprintf(f, "extern _malloc\n");
-        fprintf(f, "extern _free\n\n");
+        fprintf(f, "extern _free\n");
     } else {
         fprintf(f, "section .text\n");
         fprintf(f, "global _start\n");
-        fprintf(f, "extern printf\n");
         fprintf(f, "extern malloc\n");
-        fprintf(f, "extern free\n\n");
+        fprintf(f, "extern free\n");
+    }
+    // Buffered print runtime (runtime.c)
+    for (int i = 0; runtime_functions[i]; i++) {
+        fprintf(f, "extern %s%s\n", PLATFORM_MACOS ? "_" : "", runtime_functions[i]);
+    }
+    if (options.heap_profile) {
+        for (int i = 0; heap_profile_functions[i]; i++) {
+            fprintf(f, "extern %s%s\n", PLATFORM_MACOS ? "_" : "", heap_profile_functions[i]);
+        }
+    } else if (options.pool_alloc) {
+        for (int i = 0; pool_functions[i]; i++) {
+            fprintf(f, "extern %s%s\n", PLATFORM_MACOS ? "_" : "", pool_functions[i]);
+        }
+    }
+    for (instr = program->head; instr; instr = instr->next) {
+        if (instr->op == IR_REGION_ENTER) {
+            for (int i = 0; region_functions[i]; i++) {
+                fprintf(f, "extern %s%s\n", PLATFORM_MACOS ? "_" : "", region_functions[i]);
+            }
+            break;
+        }
+    }
+    
+    // Export every Jive function so C code can call it, and declare external
+    // C helpers that Jive code calls
+    for (instr = program->head; instr; instr = instr->next) {
+        if (is_function_start(instr) && PLATFORM_MACOS) {
+            fprintf(f, "global %s\n", instr->label);
+        } else if (is_function_start(instr)) {
+            // Typed and sized, so profilers attribute samples by address range
+            fprintf(f, "global %s:function (%s.end - %s)\n", instr->label, instr->label, instr->label);
+        } else if ((instr->op == IR_CALL || instr->op == IR_TAILCALL) && instr->label &&
+                   !is_defined_function(instr->label)) {
+            if (!name_in(declared_externs, instr->label)) {
+                name_add(declared_externs, instr->label);
+                fprintf(f, "extern %s\n", call_target(instr->label));
+            }
+        }
+    }
+    fprintf(f, "\n");
+    
+    if (!PLATFORM_MACOS) {
         // Linux entry point - check if main exists and call it
         int has_main = 0;
         IRInstruction* check_instr = program->head;
@@ -107,28 +652,75 @@ void generate_assembly(IRProgram* program, const char* output_file) {
         }
         if (has_main) {
             fprintf(f, "_start:\n");
+            // Outermost frame: frame-pointer unwinders stop at rbp = 0
+            fprintf(f, "    xor ebp, ebp\n");
             fprintf(f, "    call _main\n");
-            fprintf(f, "    mov rax, 60\n");
-            fprintf(f, "    mov rdi, 0\n");
-            fprintf(f, "    syscall\n\n");
+            // Exit through the runtime so buffered output is flushed
+            fprintf(f, "    mov rdi, rax\n");
+            fprintf(f, "    call jive_exit\n\n");
         }
     }
     
     // Generate assembly
     instr = program->head;
     int instruction_num = 0;
-    int str_index = 0;
+    stack_depth = 0;
+    call_pad_top = 0;
+    uses_bounds_checks = 0;
+    vec_depth = 0;
+    profile_counter = 0;
+    open_function = NULL;
+    cold_depth = 0;
+    int source_line = 0;
     
     while (instr) {
+        // -g: attribute the code that follows to its Jive line in the DWARF
+        // line table (nasm -g -F dwarf, or elf64.c for .o output)
+        if (options.debug_source && instr->line && instr->line != source_line) {
+            source_line = instr->line;
+            fprintf(f, "%%line %d+0 %s\n", source_line, options.debug_source);
+        }
         switch (instr->op) {
             case IR_LABEL:
+                if (is_function_start(instr)) {
+                    close_function(f);
+                    open_function = instr->label;
+                    if (options.block_layout) {
+                        fprintf(f, "    align 16\n");
+                    }
+                }
+                if (instr->operand) {
+                    fprintf(f, "    align %d\n", instr->operand);
+                }
                 if (instr->label) {
                     fprintf(f, "%s:\n", instr->label);
                 }
+                if (counter_slots(instr)) {
+                    emit_counter_inc(f, profile_counter++);
+                }
+                break;
+                
+            case IR_COLD_BEGIN:
+                if (cold_depth++ == 0) {
+                    if (!cold_text) {
+                        cold_text = open_memstream(&cold_buffer, &cold_size);
+                    }
+                    hot_text = f;
+                    f = cold_text;
+                    source_line = 0;
+                }
+                break;
+                
+            case IR_COLD_END:
+                if (--cold_depth == 0) {
+                    f = hot_text;
+                    source_line = 0;
+                }
                 break;
                 
             case IR_PUSH:
                 fprintf(f, "    push %d\n", instr->operand);
+                stack_depth++;
                 break;
                 
             case IR_PUSH_STR: {
@@ -144,39 +736,57 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 // Push address of string literal
                 fprintf(f, "    lea rax, [rel str_%d]\n", current_str_idx);
                 fprintf(f, "    push rax\n");
+                stack_depth++;
                 break;
             }
                 
             case IR_POP:
                 fprintf(f, "    pop rax\n");
+                stack_depth--;
                 break;
                 
             case IR_ADD:
-                fprintf(f, "    pop rbx\n");
+                fprintf(f, "    pop rcx\n");
                 fprintf(f, "    pop rax\n");
-                fprintf(f, "    add rax, rbx\n");
+                fprintf(f, "    add rax, rcx\n");
                 fprintf(f, "    push rax\n");
+                stack_depth--;
                 break;
                 
             case IR_SUB:
-                fprintf(f, "    pop rbx\n");
+                fprintf(f, "    pop rcx\n");
                 fprintf(f, "    pop rax\n");
-                fprintf(f, "    sub rax, rbx\n");
+                fprintf(f, "    sub rax, rcx\n");
                 fprintf(f, "    push rax\n");
+                stack_depth--;
                 break;
                 
             case IR_MUL:
-                fprintf(f, "    pop rbx\n");
+                fprintf(f, "    pop rcx\n");
                 fprintf(f, "    pop rax\n");
-                fprintf(f, "    imul rax, rbx\n");
+                fprintf(f, "    imul rax, rcx\n");
                 fprintf(f, "    push rax\n");
+                stack_depth--;
                 break;
                 
             case IR_DIV:
-                fprintf(f, "    pop rbx\n");
+                fprintf(f, "    pop rcx\n");
                 fprintf(f, "    pop rax\n");
                 fprintf(f, "    cqo\n");  // Sign extend rax into rdx:rax
-                fprintf(f, "    idiv rbx\n");
+                fprintf(f, "    idiv rcx\n");
+                fprintf(f, "    push rax\n");
+                stack_depth--;
+                break;
+                
+            case IR_MULI:
+                fprintf(f, "    pop rax\n");
+                emit_mul_const(f, instr->operand);
+                fprintf(f, "    push rax\n");
+                break;
+                
+            case IR_DIVI:
+                fprintf(f, "    pop rax\n");
+                emit_div_const(f, instr->operand);
                 fprintf(f, "    push rax\n");
                 break;
                 
@@ -189,6 +799,7 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                     fprintf(f, "    mov rax, [rbp %d]\n", instr->operand);
                 }
                 fprintf(f, "    push rax\n");
+                stack_depth++;
                 break;
                 
             case IR_STORE:
@@ -200,16 +811,86 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                     // Local variable
                     fprintf(f, "    mov [rbp %d], rax\n", instr->operand);
                 }
+                stack_depth--;
+                break;
+                
+            case IR_ENTER: {
+                // Standard frame; round the locals up so rsp stays 16-byte aligned
+                int frame_size = ((instr->operand + 1) / 2) * 16;
+                fprintf(f, "    push rbp\n");
+                fprintf(f, "    mov rbp, rsp\n");
+                if (frame_size > 0) {
+                    fprintf(f, "    sub rsp, %d\n", frame_size);
+                }
+                stack_depth = 0;
+                param_index = 0;
+                break;
+            }
+                
+            case IR_PARAM:
+                fprintf(f, "    mov [rbp %d], %s\n", instr->operand, arg_regs[param_index++]);
+                break;
+                
+            case IR_ARGS: {
+                // Pad below the stack-passed arguments if they would leave rsp misaligned
+                int stack_args = instr->operand > MAX_REG_PARAMS ? instr->operand - MAX_REG_PARAMS : 0;
+                int pad = (stack_depth + stack_args) % 2;
+                if (pad) {
+                    fprintf(f, "    sub rsp, 8\n");
+                    stack_depth++;
+                }
+                if (call_pad_top >= MAX_CALL_NESTING) {
+                    fprintf(stderr, "Error: calls nested too deeply\n");
+                    exit(1);
+                }
+                call_pad[call_pad_top++] = pad;
                 break;
+            }
                 
-            case IR_CALL:
-                // Arguments are already on stack
-                // Call function
+            case IR_CALL: {
+                if (counter_slots(instr)) {
+                    emit_counter_inc(f, profile_counter++);
+                }
+                // First argument is on top of the stack; move up to six into registers
+                int reg_args = instr->operand < MAX_REG_PARAMS ? instr->operand : MAX_REG_PARAMS;
+                for (int i = 0; i < reg_args; i++) {
+                    fprintf(f, "    pop %s\n", arg_regs[i]);
+                }
+                stack_depth -= reg_args;
                 if (instr->label) {
-                    fprintf(f, "    call %s\n", instr->label);
+                    if (!is_defined_function(instr->label)) {
+                        fprintf(f, "    xor eax, eax\n");  // No vector args in case the C helper is variadic
+                    }
+                    fprintf(f, "    call %s\n", call_target(instr->label));
+                }
+                // Drop stack-passed arguments and alignment padding
+                int cleanup = instr->operand - reg_args + call_pad[--call_pad_top];
+                if (cleanup > 0) {
+                    fprintf(f, "    add rsp, %d\n", cleanup * 8);
                 }
+                stack_depth -= cleanup;
                 // Return value is in rax, push it
                 fprintf(f, "    push rax\n");
+                stack_depth++;
+                break;
+            }
+                
+            case IR_TAILCALL:
+                if (counter_slots(instr)) {
+                    emit_counter_inc(f, profile_counter++);
+                }
+                // Register-only arguments: load them, drop our frame and jump so
+                // the callee returns straight to our caller
+                for (int i = 0; i < instr->operand; i++) {
+                    fprintf(f, "    pop %s\n", arg_regs[i]);
+                }
+                stack_depth -= instr->operand;
+                fprintf(f, "    mov rsp, rbp\n");
+                fprintf(f, "    pop rbp\n");
+                if (!is_defined_function(instr->label)) {
+                    fprintf(f, "    xor eax, eax\n");  // No vector args in case the C helper is variadic
+                }
+                fprintf(f, "    jmp %s\n", call_target(instr->label));
                 break;
                 
             case IR_RET:
@@ -217,6 +898,7 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 fprintf(f, "    mov rsp, rbp\n");
                 fprintf(f, "    pop rbp\n");
                 fprintf(f, "    ret\n");
+                stack_depth--;
                 break;
                 
             case IR_CMP: {
@@ -226,9 +908,9 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 snprintf(true_label, sizeof(true_label), ".cmp_true_%d", instruction_num);
                 snprintf(end_label, sizeof(end_label), ".cmp_end_%d", instruction_num);
                 
-                fprintf(f, "    pop rbx\n");  // right operand
+                fprintf(f, "    pop rcx\n");  // right operand
                 fprintf(f, "    pop rax\n");  // left operand
-                fprintf(f, "    cmp rax, rbx\n");
+                fprintf(f, "    cmp rax, rcx\n");
                 
                 // Jump based on comparison operator (in operand field)
                 // 0=EQ, 1=NE, 2=LT, 3=GT, 4=LE, 5=GE
@@ -262,6 +944,7 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 fprintf(f, "    push 1\n");
                 
                 fprintf(f, "%s:\n", end_label);
+                stack_depth--;
                 break;
             }
                 
@@ -275,9 +958,12 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 // Jump if zero (equal) - check flags from previous CMP
                 fprintf(f, "    pop rax\n");
                 fprintf(f, "    test rax, rax\n");
-                if (instr->label) {
+                if (instr->label && counter_slots(instr)) {
+                    emit_counted_branch(f, "jnz", instr->label, instruction_num);
+                } else if (instr->label) {
                     fprintf(f, "    jz %s\n", instr->label);
                 }
+                stack_depth--;
                 break;
             }
                 
@@ -285,86 +971,251 @@ void generate_assembly(IRProgram* program, const char* output_file) {
                 // Jump if not zero
                 fprintf(f, "    pop rax\n");
                 fprintf(f, "    test rax, rax\n");
-                if (instr->label) {
+                if (instr->label && counter_slots(instr)) {
+                    emit_counted_branch(f, "jz", instr->label, instruction_num);
+                } else if (instr->label) {
                     fprintf(f, "    jnz %s\n", instr->label);
                 }
+                stack_depth--;
                 break;
             }
                 
-            case IR_PRINT: {
-                // Print value/string from stack
-                // For simplicity, we'll print as integer if it's a number, or as string if it's a pointer
-                // In a real implementation, we'd need type information
-                // Here we'll assume: if value < 0x1000, it's an int, else it's a string pointer
-                char print_str_label[64];
-                char print_end_label[64];
-                snprintf(print_str_label, sizeof(print_str_label), ".print_str_%d", instruction_num);
-                snprintf(print_end_label, sizeof(print_end_label), ".print_end_%d", instruction_num);
+            case IR_PRINT_INT:
+                fprintf(f, "    pop rdi\n");
+                stack_depth--;
+                emit_c_call(f, "jive_print_int");
+                break;
+                
+            case IR_PRINT_STR:
+                fprintf(f, "    pop rdi\n");
+                stack_depth--;
+                if (instr->operand >= 0) {
+                    // Literal: length known at compile time
+                    fprintf(f, "    mov esi, %d\n", instr->operand);
+                } else {
+                    fprintf(f, "    mov rsi, [rdi - %d]\n", JIVE_STR_LEN_OFFSET);
+                }
+                emit_c_call(f, "jive_print_str");
+                break;
+                
+            case IR_STR_LEN:
+                fprintf(f, "    pop rax\n");
+                fprintf(f, "    mov rax, [rax - %d]\n", JIVE_STR_LEN_OFFSET);
+                fprintf(f, "    push rax\n");
+                break;
+                
+            case IR_INDEX_LOAD:
+                fprintf(f, "    pop rcx\n");  // Index
+                fprintf(f, "    pop rax\n");  // Base
+                if (instr->operand) {
+                    // Unsigned compare also catches negative indices
+                    fprintf(f, "    cmp rcx, [rax - %d]\n", JIVE_ARRAY_LEN_OFFSET);
+                    fprintf(f, "    jae bounds_error\n");
+                    uses_bounds_checks = 1;
+                }
+                fprintf(f, "    mov rax, [rax + rcx*8]\n");
+                fprintf(f, "    push rax\n");
+                stack_depth--;
+                break;
+                
+            case IR_INDEX_STORE:
+                fprintf(f, "    pop rdx\n");  // Value
+                fprintf(f, "    pop rcx\n");  // Index
+                fprintf(f, "    pop rax\n");  // Base
+                if (instr->operand) {
+                    fprintf(f, "    cmp rcx, [rax - %d]\n", JIVE_ARRAY_LEN_OFFSET);
+                    fprintf(f, "    jae bounds_error\n");
+                    uses_bounds_checks = 1;
+                }
+                fprintf(f, "    mov [rax + rcx*8], rdx\n");
+                stack_depth -= 3;
+                break;
                 
+            // Vector ops: 2 lanes use SSE2 on xmm registers, 4 lanes AVX2 on ymm
+            case IR_VEC_LOAD:
+                fprintf(f, "    pop rcx\n");
                 fprintf(f, "    pop rax\n");
-                fprintf(f, "    cmp rax, 0x1000\n");
-                fprintf(f, "    jge %s\n", print_str_label);
-                
-                // Print as integer
-                if (PLATFORM_MACOS) {
-                    fprintf(f, "    lea rdi, [rel fmt_int]\n");
-                    fprintf(f, "    mov rsi, rax\n");
-                    fprintf(f, "    xor rax, rax\n");  // No vector args
-                    fprintf(f, "    call _printf\n");
+                if (instr->operand == 4) {
+                    fprintf(f, "    vmovdqu ymm%d, [rax + rcx*8]\n", vec_depth);
                 } else {
-                    fprintf(f, "    mov rsi, rax\n");
-                    fprintf(f, "    lea rdi, [rel fmt_int]\n");
-                    fprintf(f, "    xor rax, rax\n");  // No vector args
-                    fprintf(f, "    call printf\n");
-                }
-                fprintf(f, "    jmp %s\n", print_end_label);
-                
-                // Print as string
-                fprintf(f, "%s:\n", print_str_label);
-                if (PLATFORM_MACOS) {
-                    fprintf(f, "    lea rdi, [rel fmt_str]\n");
-                    fprintf(f, "    mov rsi, rax\n");
-                    fprintf(f, "    xor rax, rax\n");  // No vector args
-                    fprintf(f, "    call _printf\n");
+                    fprintf(f, "    movdqu xmm%d, [rax + rcx*8]\n", vec_depth);
+                }
+                vec_depth++;
+                stack_depth -= 2;
+                break;
+                
+            case IR_VEC_SPLAT:
+                fprintf(f, "    pop rax\n");
+                if (instr->operand == 4) {
+                    fprintf(f, "    vmovq xmm%d, rax\n", vec_depth);
+                    fprintf(f, "    vpbroadcastq ymm%d, xmm%d\n", vec_depth, vec_depth);
                 } else {
-                    fprintf(f, "    mov rsi, rax\n");
-                    fprintf(f, "    lea rdi, [rel fmt_str]\n");
-                    fprintf(f, "    xor rax, rax\n");  // No vector args
-                    fprintf(f, "    call printf\n");
+                    fprintf(f, "    movq xmm%d, rax\n", vec_depth);
+                    fprintf(f, "    punpcklqdq xmm%d, xmm%d\n", vec_depth, vec_depth);
                 }
+                vec_depth++;
+                stack_depth--;
+                break;
                 
-                fprintf(f, "%s:\n", print_end_label);
+            case IR_VEC_ADD:
+            case IR_VEC_SUB: {
+                const char* op = instr->op == IR_VEC_ADD ? "paddq" : "psubq";
+                vec_depth--;
+                if (instr->operand == 4) {
+                    fprintf(f, "    v%s ymm%d, ymm%d, ymm%d\n", op, vec_depth - 1, vec_depth - 1, vec_depth);
+                } else {
+                    fprintf(f, "    %s xmm%d, xmm%d\n", op, vec_depth - 1, vec_depth);
+                }
                 break;
             }
                 
+            case IR_VEC_STORE:
+                vec_depth--;
+                fprintf(f, "    pop rcx\n");
+                fprintf(f, "    pop rax\n");
+                if (instr->operand == 4) {
+                    fprintf(f, "    vmovdqu [rax + rcx*8], ymm%d\n", vec_depth);
+                } else {
+                    fprintf(f, "    movdqu [rax + rcx*8], xmm%d\n", vec_depth);
+                }
+                stack_depth -= 2;
+                break;
+                
+            case IR_VEC_ALIAS:
+                // |a - b| - 1 as unsigned is at least operand - 1 exactly when
+                // the pointers are equal or operand bytes or more apart
+                fprintf(f, "    pop rcx\n");
+                fprintf(f, "    pop rax\n");
+                fprintf(f, "    sub rax, rcx\n");
+                fprintf(f, "    mov rcx, rax\n");
+                fprintf(f, "    neg rax\n");
+                fprintf(f, "    cmovl rax, rcx\n");
+                fprintf(f, "    dec rax\n");
+                fprintf(f, "    cmp rax, %d\n", instr->operand - 1);
+                fprintf(f, "    setae al\n");
+                fprintf(f, "    movzx eax, al\n");
+                fprintf(f, "    push rax\n");
+                stack_depth--;
+                break;
+                
+            case IR_VEC_END:
+                // Avoid AVX-to-SSE transition stalls in the code that follows
+                if (instr->operand == 4) {
+                    fprintf(f, "    vzeroupper\n");
+                }
+                break;
+                
             case IR_MALLOC: {
-                // Allocate memory - size is on stack
-                fprintf(f, "    pop rdi\n");  // Size argument
-                if (PLATFORM_MACOS) {
-                    fprintf(f, "    call _malloc\n");
+                int size_class = instr->operand >= 0 ? jive_pool_class(instr->operand) : -1;
+                if (options.heap_profile) {
+                    if (instr->operand >= 0) {
+                        fprintf(f, "    mov edi, %d\n", instr->operand);
+                    } else {
+                        fprintf(f, "    pop rdi\n");  // Size argument
+                        stack_depth--;
+                    }
+                    fprintf(f, "    lea rsi, [rel ");
+                    emit_site_label(f, instr->label);
+                    fprintf(f, "]\n");
+                    emit_c_call(f, "jive_prof_alloc");
+                } else if (options.pool_alloc && size_class >= 0) {
+                    emit_pool_alloc(f, size_class);
                 } else {
-                    fprintf(f, "    call malloc\n");
+                    if (instr->operand >= 0) {
+                        fprintf(f, "    mov edi, %d\n", instr->operand);
+                    } else {
+                        fprintf(f, "    pop rdi\n");  // Size argument
+                        stack_depth--;
+                    }
+                    emit_c_call(f, options.pool_alloc ? "jive_alloc" : "malloc");
                 }
                 fprintf(f, "    push rax\n");  // Push returned pointer
+                stack_depth++;
                 break;
             }
                 
+            case IR_FRAME_ADDR:
+                fprintf(f, "    lea rax, [rbp %d]\n", instr->operand);
+                fprintf(f, "    push rax\n");
+                stack_depth++;
+                break;
+                
+            case IR_REGION_ENTER:
+                emit_c_call(f, "jive_region_enter");
+                break;
+                
+            case IR_REGION_EXIT:
+                emit_c_call(f, "jive_region_exit");
+                break;
+                
+            case IR_REGION_ALLOC:
+                if (instr->operand >= 0) {
+                    emit_region_alloc(f, instr->operand);
+                } else {
+                    fprintf(f, "    pop rdi\n");  // Size argument
+                    stack_depth--;
+                    emit_c_call(f, "jive_region_alloc");
+                }
+                fprintf(f, "    push rax\n");
+                stack_depth++;
+                break;
+                
             case IR_FREE: {
+                if (options.heap_profile) {
+                    fprintf(f, "    pop rdi\n");
+                    stack_depth--;
+                    if (instr->operand) {
+                        emit_c_call(f, "jive_region_filter");
+                        fprintf(f, "    mov rdi, rax\n");
+                    }
+                    fprintf(f, "    lea rsi, [rel ");
+                    emit_site_label(f, instr->label);
+                    fprintf(f, "]\n");
+                    emit_c_call(f, "jive_prof_free");
+                    break;
+                }
+                if (instr->operand) {
+                    // Region memory is released with its region; the filter
+                    // turns such pointers into NULL
+                    fprintf(f, "    pop rdi\n");
+                    stack_depth--;
+                    emit_c_call(f, "jive_region_filter");
+                    if (options.pool_alloc) {
+                        emit_pool_free(f);
+                    } else {
+                        fprintf(f, "    mov rdi, rax\n");
+                        emit_c_call(f, "free");
+                    }
+                    break;
+                }
+                if (options.pool_alloc) {
+                    fprintf(f, "    pop rax\n");
+                    stack_depth--;
+                    emit_pool_free(f);
+                    break;
+                }
                 // Free memory - pointer is on stack
                 fprintf(f, "    pop rdi\n");  // Pointer argument
-                if (PLATFORM_MACOS) {
-                    fprintf(f, "    call _free\n");
-                } else {
-                    fprintf(f, "    call free\n");
-                }
+                stack_depth--;
+                emit_c_call(f, "free");
                 break;
             }
+                
+            case IR_HEAP_SITE:
+                // Read by the runtime's jive_heap_alloc and jive_heap_free
+                fprintf(f, "    lea rax, [rel ");
+                emit_site_label(f, instr->label);
+                fprintf(f, "]\n");
+                fprintf(f, "    mov [rel %sjive_heap_site], rax\n", PLATFORM_MACOS ? "_" : "");
+                break;
         }
         
         instr = instr->next;
         instruction_num++;
     }
     
+    close_function(f);
+    
     // Add exit code (only if no main function)
     int has_main_check = 0;
     IRInstruction* check_instr2 = program->head;
@@ -377,15 +1228,59 @@ void generate_assembly(IRProgram* program, const char* output_file) {
         check_instr2 = check_instr2->next;
     }
     if (!has_main_check) {
-        if (PLATFORM_MACOS) {
-            fprintf(f, "\n    mov rax, 0x2000001  ; exit syscall\n");
-        } else {
-            fprintf(f, "\n    mov rax, 60  ; exit syscall\n");
-        }
-        fprintf(f, "    mov rdi, 0\n");
-        fprintf(f, "    syscall\n");
+        fprintf(f, "\n    xor edi, edi\n");
+        emit_c_call(f, "jive_exit");
     }
     
+    // Shared target of every failed bounds check: rcx holds the index and
+    // rax the array base
+    if (uses_bounds_checks) {
+        if (options.block_layout && !PLATFORM_MACOS) {
+            fprintf(f, "%s\n", TEXT_UNLIKELY);
+        }
+        fprintf(f, "\nbounds_error:\n");
+        fprintf(f, "    mov rdi, rcx\n");
+        fprintf(f, "    mov rsi, [rax - %d]\n", JIVE_ARRAY_LEN_OFFSET);
+        fprintf(f, "    and rsp, -16\n");
+        fprintf(f, "    call %sjive_bounds_error\n", PLATFORM_MACOS ? "_" : "");
+    }
+    clear_names(defined_functions);
+    clear_names(declared_externs);
+}
+
+void generate_assembly(IRProgram* program, const char* output_file) {
+    FILE* f = fopen(output_file, "w");
+    if (!f) {
+        fprintf(stderr, "Error: cannot open output file '%s'\n", output_file);
+        exit(1);
+    }
+    write_assembly(program, f);
+    fclose(f);
+}
+
+// The same text, assembled in memory instead of by nasm
+AsmObject* assemble_program(IRProgram* program) {
+    if (PLATFORM_MACOS) {
+        fprintf(stderr, "Error: the built-in assembler is ELF only; write .asm and use nasm -f macho64\n");
+        exit(1);
+    }
+    char* text = NULL;
+    size_t size = 0;
+    FILE* f = open_memstream(&text, &size);
+    if (!f) {
+        fprintf(stderr, "Error: cannot buffer assembly\n");
+        exit(1);
+    }
+    write_assembly(program, f);
     fclose(f);
+
+    AsmObject* obj = assemble(text);
+    free(text);
+    return obj;
 }
 
+void generate_object(IRProgram* program, const char* output_file) {
+    AsmObject* obj = assemble_program(program);
+    write_elf_object(obj, output_file);
+    free_asm_object(obj);
+}
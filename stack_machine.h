@@ -2,8 +2,11 @@
 #define STACK_MACHINE_H
 
 #include "stack_machine_ir.h"
+#include "assembler.h"
 
 void generate_assembly(IRProgram* program, const char* output_file);
+void generate_object(IRProgram* program, const char* output_file);  // ELF64 .o, no nasm
+AsmObject* assemble_program(IRProgram* program);  // Machine code in memory (ELF only)
 
 #endif // STACK_MACHINE_H
 
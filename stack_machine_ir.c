@@ -3,6 +3,8 @@
 #include <string.h>
 #include "stack_machine_ir.h"
 
+static int current_line;
+
 IRProgram* create_ir_program() {
     IRProgram* program = malloc(sizeof(IRProgram));
     program->head = NULL;
@@ -16,6 +18,8 @@ void emit_ir(IRProgram* program, IROp op, int operand, const char* label) {
     instr->operand = operand;
     instr->label = label ? strdup(label) : NULL;
     instr->str_value = NULL;
+    instr->profile_key = NULL;
+    instr->line = current_line;
     instr->next = NULL;
     
     if (program->tail) {
@@ -33,6 +37,8 @@ void emit_ir_str(IRProgram* program, IROp op, const char* str_value) {
     instr->operand = 0;
     instr->label = NULL;
     instr->str_value = str_value ? strdup(str_value) : NULL;
+    instr->profile_key = NULL;
+    instr->line = current_line;
     instr->next = NULL;
     
     if (program->tail) {
@@ -44,6 +50,22 @@ void emit_ir_str(IRProgram* program, IROp op, const char* str_value) {
     }
 }
 
+void ir_set_line(int line) {
+    current_line = line;
+}
+
+// Name the counter of the last instruction emitted: key, or key/suffix
+void set_profile_key(IRProgram* program, const char* key, const char* suffix) {
+    IRInstruction* instr = program->tail;
+    free(instr->profile_key);
+    if (suffix) {
+        instr->profile_key = malloc(strlen(key) + strlen(suffix) + 2);
+        sprintf(instr->profile_key, "%s/%s", key, suffix);
+    } else {
+        instr->profile_key = strdup(key);
+    }
+}
+
 void free_ir_program(IRProgram* program) {
     IRInstruction* instr = program->head;
     while (instr) {
@@ -54,6 +76,9 @@ void free_ir_program(IRProgram* program) {
         if (instr->str_value) {
             free(instr->str_value);
         }
+        if (instr->profile_key) {
+            free(instr->profile_key);
+        }
         free(instr);
         instr = next;
     }
@@ -9,18 +9,42 @@ typedef enum {
     IR_SUB,
     IR_MUL,
     IR_DIV,
+    IR_MULI,     // Multiply top of stack by constant (operand)
+    IR_DIVI,     // Signed divide top of stack by non-zero constant (operand)
     IR_LOAD,
     IR_STORE,
     IR_CALL,
     IR_RET,
+    IR_ENTER,    // Function prologue (operand = local slot count)
+    IR_PARAM,    // Spill next register argument (operand = stack offset)
+    IR_ARGS,     // Start of call argument evaluation (operand = arg count)
+    IR_TAILCALL, // Tear down the frame and jump to label (operand = arg count)
     IR_JMP,      // Unconditional jump
     IR_JZ,       // Jump if zero
     IR_JNZ,      // Jump if not zero
-    IR_LABEL,    // Label definition
+    IR_LABEL,    // Label definition (operand = alignment in bytes, 0 for none)
     IR_CMP,      // Compare (sets flags for conditional jumps)
-    IR_PRINT,    // Print value/string
-    IR_MALLOC,   // Allocate memory
-    IR_FREE      // Free memory
+    IR_PRINT_INT, // Print integer
+    IR_PRINT_STR, // Print string (operand = literal length, -1 if unknown)
+    IR_STR_LEN,  // Replace a string with its length from the header
+    IR_INDEX_LOAD,  // base, index -> base[index] (operand = 1: bounds check)
+    IR_INDEX_STORE, // base, index, value -> base[index] = value (operand as LOAD)
+    IR_VEC_LOAD,    // base, index -> vector of base[index..] (operand = lanes)
+    IR_VEC_SPLAT,   // value -> vector with value in every lane (operand = lanes)
+    IR_VEC_ADD,     // Lane-wise add of the top two vectors (operand = lanes)
+    IR_VEC_SUB,     // Lane-wise subtract of the top two vectors (operand = lanes)
+    IR_VEC_STORE,   // base, index; vector -> base[index..] = vector (operand = lanes)
+    IR_VEC_ALIAS,   // a, b -> 1 if a == b or they are operand bytes or more apart
+    IR_VEC_END,     // Leaving vector code (operand = lanes)
+    IR_MALLOC,   // Allocate memory (operand = constant size, -1 if on stack; label = site)
+    IR_FRAME_ADDR, // Push address of frame space (operand = rbp offset)
+    IR_REGION_ENTER, // Open a region block
+    IR_REGION_EXIT,  // Release everything allocated since the matching enter
+    IR_REGION_ALLOC, // Bump-allocate from the innermost region (operand as MALLOC)
+    IR_FREE,     // Free memory (operand = 1: skip pointers owned by a live region; label = site)
+    IR_HEAP_SITE, // The next runtime call allocates or frees for heap profiler site label
+    IR_COLD_BEGIN, // Code up to the matching COLD_END is unlikely to run (.text.unlikely)
+    IR_COLD_END
 } IROp;
 
 typedef struct IRInstruction {
@@ -28,6 +52,8 @@ typedef struct IRInstruction {
     int operand;  // For PUSH, LOAD, STORE, etc.
     char* label;  // For jumps and labels
     char* str_value;  // For string literals
+    char* profile_key;  // Counter name on labels, branches and calls (-fprofile-generate)
+    int line;  // Jive source line the instruction was generated for, 0 if none
     struct IRInstruction* next;
 } IRInstruction;
 
@@ -39,6 +65,8 @@ typedef struct {
 IRProgram* create_ir_program();
 void emit_ir(IRProgram* program, IROp op, int operand, const char* label);
 void emit_ir_str(IRProgram* program, IROp op, const char* str_value);
+void set_profile_key(IRProgram* program, const char* key, const char* suffix);
+void ir_set_line(int line);  // Source line recorded on instructions emitted from now on
 void free_ir_program(IRProgram* program);
 
 #endif // STACK_MACHINE_IR_H
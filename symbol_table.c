@@ -65,6 +65,7 @@ Symbol* declare_var(Scope* scope, const char* name, SymType type) {
     Symbol* sym = malloc(sizeof(Symbol));
     sym->name = strdup(name);
     sym->type = type;
+    sym->value_type = 0;
     scope->local_count++;
     // Local variables use negative offsets from rbp
     sym->offset = -(scope->local_count * 8);
@@ -77,11 +78,27 @@ Symbol* declare_param(Scope* scope, const char* name) {
     Symbol* sym = malloc(sizeof(Symbol));
     sym->name = strdup(name);
     sym->type = SYM_PARAM;
+    sym->value_type = 0;
     scope->param_count++;
-    // Parameters use positive offsets: first param at [rbp+16], second at [rbp+24], etc.
-    sym->offset = 16 + (scope->param_count - 1) * 8;
+    if (scope->param_count <= MAX_REG_PARAMS) {
+        // Register parameters are spilled by the prologue into local slots
+        scope->local_count++;
+        sym->offset = -(scope->local_count * 8);
+    } else {
+        // Stack parameters use positive offsets: 7th param at [rbp+16], 8th at [rbp+24], etc.
+        sym->offset = 16 + (scope->param_count - MAX_REG_PARAMS - 1) * 8;
+    }
     sym->next = scope->symbols;
     scope->symbols = sym;
     return sym;
 }
 
+// Reserve size bytes of frame space, 16-byte aligned like malloc, and return
+// the rbp offset of its lowest address
+int reserve_stack(Scope* scope, int size) {
+    scope->local_count += (size + 7) / 8;
+    if (scope->local_count % 2) {
+        scope->local_count++;
+    }
+    return -(scope->local_count * 8);
+}
@@ -1,6 +1,9 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
+// System V passes the first six integer arguments in rdi/rsi/rdx/rcx/r8/r9
+#define MAX_REG_PARAMS 6
+
 typedef enum {
     SYM_VAR,
     SYM_FN,
@@ -11,6 +14,7 @@ typedef struct Symbol {
     char* name;
     SymType type;
     int offset;  // Stack offset
+    int value_type;  // Declared ValueType (TYPE_INT, TYPE_STRING, TYPE_BUILDER)
     struct Symbol* next;
 } Symbol;
 
@@ -26,6 +30,7 @@ void destroy_scope(Scope* scope);
 Symbol* lookup(Scope* scope, const char* name);
 Symbol* declare_var(Scope* scope, const char* name, SymType type);
 Symbol* declare_param(Scope* scope, const char* name);
+int reserve_stack(Scope* scope, int size);
 
 #endif // SYMBOL_TABLE_H
 
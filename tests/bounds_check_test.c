@@ -0,0 +1,91 @@
+// Bounds-check elimination in while (i < len(a)) loops: a[i] in the body
+// must compile unchecked whatever other statements sit between the loop and
+// the let that starts i at 0, and must stay checked when i can start
+// negative, the limit is not len(a) or the body writes i before the access.
+// Exits non-zero if any case comes out the wrong way. Run from the
+// repository root.
+//
+//   gcc -O2 -rdynamic -I. tests/bounds_check_test.c $(ls *.c | grep -v '^main.c$\|^runtime_freestanding.c$') -ldl -o bounds_check_test
+//   ./bounds_check_test
+
+#include <stdio.h>
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "loop_opt.h"
+#include "options.h"
+
+CompilerOptions options = {
+    .inline_limit = 0,  // Keep the loop in its own function
+    .loop_optimize = 1,
+    .bounds_check = 1,
+};
+
+#define SUM_LOOP "    while (i < len(a)) {\n        s = s + a[i];\n        i = i + 1;\n    }\n"
+
+typedef struct {
+    const char* name;
+    const char* before_loop;  // Statements between the arrays and the loop
+    const char* loop;
+    int checked;              // Whether a[i] must keep its check
+} Case;
+
+static const Case cases[] = {
+    {"let i directly before the loop", "    let s: int = 0;\n    let i: int = 0;\n", SUM_LOOP, 0},
+    {"let i before another let", "    let i: int = 0;\n    let s: int = 0;\n", SUM_LOOP, 0},
+    {"let i before a print", "    let i: int = 0;\n    let s: int = 0;\n    print(s);\n", SUM_LOOP, 0},
+    {"assignment i = 0 before another let", "    let i: int = 5;\n    i = 0;\n    let s: int = 0;\n",
+     SUM_LOOP, 0},
+    {"i = 0 - 2 after the let", "    let i: int = 0;\n    i = 0 - 2;\n    let s: int = 0;\n", SUM_LOOP, 1},
+    {"limit is len of another array", "    let i: int = 0;\n    let s: int = 0;\n",
+     "    while (i < len(b)) {\n        s = s + a[i];\n        i = i + 1;\n    }\n", 1},
+    {"limit is a literal", "    let i: int = 0;\n    let s: int = 0;\n",
+     "    while (i < 10) {\n        s = s + a[i];\n        i = i + 1;\n    }\n", 1},
+    {"i written before the access", "    let i: int = 0;\n    let s: int = 0;\n",
+     "    while (i < len(a)) {\n        i = i + 1;\n        s = s + a[i];\n    }\n", 1},
+};
+
+// Checked a[i] loads left in the program
+static int checked_loads(const Case* c) {
+    char source[1024];
+    snprintf(source, sizeof(source),
+             "fn sum(a: array, b: array) -> int {\n"
+             "%s"
+             "%s"
+             "    return s;\n"
+             "}\n"
+             "fn main() -> int {\n"
+             "    let a: array = new_array(10);\n"
+             "    let b: array = new_array(20);\n"
+             "    return sum(a, b);\n"
+             "}\n",
+             c->before_loop, c->loop);
+    init_lexer(source);
+    ASTNode* ast = parse_program();
+    cleanup_lexer();
+    optimize_loops(ast);
+    IRProgram* ir = generate_code(ast);
+    int count = 0;
+    for (IRInstruction* instr = ir->head; instr; instr = instr->next) {
+        if (instr->op == IR_INDEX_LOAD && instr->operand) {
+            count++;
+        }
+    }
+    free_ir_program(ir);
+    free_ast(ast);
+    return count;
+}
+
+int main(void) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        int checked = checked_loads(&cases[i]) != 0;
+        const char* result = "ok";
+        if (checked != cases[i].checked) {
+            result = checked ? "FAIL: a[i] still checked" : "FAIL: a[i] compiled unchecked";
+        }
+        printf("%-40s %s\n", cases[i].name, result);
+        failures += checked != cases[i].checked;
+    }
+    return failures != 0;
+}
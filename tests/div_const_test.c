@@ -0,0 +1,108 @@
+// Multiplication and division by constants: every divisor in the table is
+// compiled through IR_DIVI (shift or magic-number multiply) into a one-line
+// function, loaded with the JIT and compared against C's truncating division
+// for every dividend from -100000 to 100000 and the 64-bit boundary values.
+// The multipliers go through IR_MULI the same way. Exits non-zero on the
+// first mismatch per constant. Run from the repository root, on Linux.
+//
+//   gcc -O2 -rdynamic -I. tests/div_const_test.c $(ls *.c | grep -v '^main.c$\|^runtime_freestanding.c$') -ldl -o div_const_test
+//   ./div_const_test
+
+#include <stdio.h>
+#include <stdint.h>
+#include "stack_machine_ir.h"
+#include "jit.h"
+#include "options.h"
+
+#define SWEEP 100000
+
+CompilerOptions options = {0};
+
+typedef long (*UnaryFunction)(long);
+
+static const int divisors[] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 16, 17, 25, 100, 125, 641, 1000,
+    1024, 65536, 1000003, 2147483647,
+    -1, -2, -3, -4, -5, -6, -7, -8, -9, -10, -16, -25, -100, -641, -1000, -65536,
+    -1000003, -2147483647, -2147483647 - 1,
+};
+
+static const int multipliers[] = {
+    0, 1, 2, 3, 5, 7, 9, 10, 12, 15, 17, 18, 20, 24, 31, 33, 36, 40, 45, 63, 65, 72,
+    100, 1000, 65536, 2147483647,
+    -1, -2, -3, -5, -7, -9, -10, -17, -31, -33, -1000, -2147483647 - 1,
+};
+
+// Around the ends of the 32- and 64-bit ranges, and the values where
+// magic-number rounding goes wrong first
+static const int64_t boundaries[] = {
+    INT64_MIN, INT64_MIN + 1, INT64_MIN + 2, INT64_MIN / 2, INT64_MIN / 3,
+    INT64_MAX, INT64_MAX - 1, INT64_MAX - 2, INT64_MAX / 2, INT64_MAX / 3,
+    -4294967296LL, -4294967295LL, -2147483649LL, -2147483648LL, -2147483647LL,
+    2147483646LL, 2147483647LL, 2147483648LL, 4294967295LL, 4294967296LL,
+    1000000000000LL, -1000000000000LL, 999999999999999999LL, -999999999999999999LL,
+};
+
+// fn f(x: int) -> int { return x op k; }
+static UnaryFunction compile(IROp op, int k) {
+    IRProgram* program = create_ir_program();
+    emit_ir(program, IR_LABEL, 0, "_main");
+    emit_ir(program, IR_ENTER, 1, NULL);
+    emit_ir(program, IR_PARAM, -8, NULL);
+    emit_ir(program, IR_LOAD, -8, NULL);
+    emit_ir(program, op, k, NULL);
+    emit_ir(program, IR_RET, 0, NULL);
+    UnaryFunction f = (UnaryFunction)jit_compile(program, 0);
+    free_ir_program(program);
+    return f;
+}
+
+// What idiv gives, except that INT64_MIN / -1 wraps instead of trapping
+static int64_t expected_quotient(int64_t x, int64_t d) {
+    if (d == -1) {
+        return (int64_t)(0 - (uint64_t)x);
+    }
+    return x / d;
+}
+
+static int64_t expected_product(int64_t x, int64_t k) {
+    return (int64_t)((uint64_t)x * (uint64_t)k);
+}
+
+// Runs f over every dividend; prints and returns 1 on the first mismatch
+static int check(const char* what, int k, UnaryFunction f, int64_t (*expected)(int64_t, int64_t)) {
+    size_t boundary_count = sizeof(boundaries) / sizeof(boundaries[0]);
+    for (int64_t i = -SWEEP; i <= SWEEP + (int64_t)boundary_count * 3; i++) {
+        int64_t x = i;
+        if (i > SWEEP) {
+            // Each boundary, and one multiple of k either side of it
+            int64_t b = boundaries[(i - SWEEP - 1) / 3];
+            int64_t near = k && k != -1 ? b / k * k : b;
+            x = (i - SWEEP - 1) % 3 == 0 ? b : (i - SWEEP - 1) % 3 == 1 ? near : near - 1;
+        }
+        int64_t got = f(x);
+        int64_t want = expected(x, k);
+        if (got != want) {
+            printf("FAIL: %lld %s %d = %lld, expected %lld\n", (long long)x, what, k,
+                   (long long)got, (long long)want);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    int failures = 0;
+    size_t divisor_count = sizeof(divisors) / sizeof(divisors[0]);
+    size_t multiplier_count = sizeof(multipliers) / sizeof(multipliers[0]);
+    for (size_t i = 0; i < divisor_count; i++) {
+        failures += check("/", divisors[i], compile(IR_DIVI, divisors[i]), expected_quotient);
+    }
+    for (size_t i = 0; i < multiplier_count; i++) {
+        failures += check("*", multipliers[i], compile(IR_MULI, multipliers[i]), expected_product);
+    }
+    printf("%zu divisors, %zu multipliers, %d dividends each: %s\n", divisor_count,
+           multiplier_count, 2 * SWEEP + 1 + (int)(sizeof(boundaries) / sizeof(boundaries[0])) * 3,
+           failures ? "FAIL" : "ok");
+    return failures != 0;
+}
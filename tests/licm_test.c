@@ -0,0 +1,68 @@
+// Loop-invariant code motion: int arithmetic over unchanged variables moves
+// to a temporary before the loop, while string + (a call that allocates a
+// new string) must stay in the body. Exits non-zero if a case hoists when it
+// must not or keeps in the loop what it should move. Run from the
+// repository root.
+//
+//   gcc -O2 -rdynamic -I. tests/licm_test.c $(ls *.c | grep -v '^main.c$\|^runtime_freestanding.c$') -ldl -o licm_test
+//   ./licm_test
+
+#include <stdio.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "loop_opt.h"
+#include "options.h"
+
+CompilerOptions options = {
+    .inline_limit = 0,
+    .loop_optimize = 1,
+};
+
+typedef struct {
+    const char* name;
+    const char* body;   // Declarations, then the loop
+    int hoisted;        // Temporaries expected before the loop
+} Case;
+
+static const Case cases[] = {
+    {"int sum is hoisted",
+     "    let a: int = 2;\n    let b: int = 5;\n    let s: int = 0;\n"
+     "    while (i < 2) {\n        s = s + (a + b);\n        i = i + 1;\n    }\n    print(s);\n", 1},
+    {"string + int in print stays",
+     "    let s: string = \"v\";\n    let k: int = 7;\n"
+     "    while (i < 2) {\n        print(s + k);\n        i = i + 1;\n    }\n", 0},
+    {"string + string freed in the loop stays",
+     "    let s: string = \"a\";\n    let t: string = \"b\";\n"
+     "    while (i < 2) {\n        let x: string = s + t;\n        print(x);\n        free(x);\n"
+     "        i = i + 1;\n    }\n", 0},
+};
+
+// licm.N temporaries declared anywhere in a subtree
+static int count_hoisted(ASTNode* node) {
+    if (!node) return 0;
+    int count = node->type == AST_VAR_DECL && strncmp(node->var_name, "licm.", 5) == 0;
+    return count + count_hoisted(node->left) + count_hoisted(node->right) +
+           count_hoisted(node->condition) + count_hoisted(node->then_block) +
+           count_hoisted(node->else_block) + count_hoisted(node->body) +
+           count_hoisted(node->statements) + count_hoisted(node->body_nodes);
+}
+
+int main(void) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char source[1024];
+        snprintf(source, sizeof(source),
+                 "fn main() -> int {\n    let i: int = 0;\n%s    return 0;\n}\n", cases[i].body);
+        init_lexer(source);
+        ASTNode* ast = parse_program();
+        cleanup_lexer();
+        optimize_loops(ast);
+        int hoisted = count_hoisted(ast);
+        free_ast(ast);
+        int ok = hoisted == cases[i].hoisted;
+        printf("%-40s %s\n", cases[i].name, ok ? "ok" : "FAIL: wrong number of hoisted temporaries");
+        failures += !ok;
+    }
+    return failures != 0;
+}
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vectorize.h"
+#include "options.h"
+
+#define MAX_VECTOR_REGS 16
+#define MAX_BASES 16
+
+static ASTNode* program_ast;
+static const char* current_fn;
+static int loop_number;
+
+// Arrays a vectorizable loop touches, in order of first use
+typedef struct {
+    const char* names[MAX_BASES];
+    int stored[MAX_BASES];
+    int count;
+} BaseSet;
+
+// Number of declarations/assignments of name in a subtree
+static int count_assigns(ASTNode* node, const char* name) {
+    if (!node) return 0;
+    int count = 0;
+    if ((node->type == AST_ASSIGN || node->type == AST_VAR_DECL) &&
+        strcmp(node->var_name, name) == 0) {
+        count = 1;
+    }
+    return count + count_assigns(node->left, name) + count_assigns(node->right, name) +
+           count_assigns(node->condition, name) + count_assigns(node->then_block, name) +
+           count_assigns(node->else_block, name) + count_assigns(node->body, name) +
+           count_assigns(node->params, name) + count_assigns(node->args, name) +
+           count_assigns(node->next_arg, name) + count_assigns(node->statements, name);
+}
+
+static int is_user_function(const char* name) {
+    for (ASTNode* stmt = program_ast->statements; stmt; stmt = stmt->right) {
+        if (stmt->type == AST_FN_DEF && strcmp(stmt->fn_name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// loop_opt's strength reduction turns i * k into a variable sr.N and
+// advances it with sr.N = sr.N + k right after the induction step. The '.'
+// keeps these names apart from Jive identifiers.
+static int is_derived_iv(const char* name) {
+    return strncmp(name, "sr.", 3) == 0;
+}
+
+static int add_base(BaseSet* bases, const char* name, int stored) {
+    for (int i = 0; i < bases->count; i++) {
+        if (strcmp(bases->names[i], name) == 0) {
+            bases->stored[i] |= stored;
+            return 1;
+        }
+    }
+    if (bases->count >= MAX_BASES) {
+        return 0;
+    }
+    bases->names[bases->count] = name;
+    bases->stored[bases->count] = stored;
+    bases->count++;
+    return 1;
+}
+
+// Vector registers needed to evaluate expr; the right operand is evaluated
+// while the left one is held
+static int vector_regs(ASTNode* expr) {
+    if (expr->type != AST_BINOP) {
+        return 1;
+    }
+    int left = vector_regs(expr->left);
+    int right = vector_regs(expr->right) + 1;
+    return left > right ? left : right;
+}
+
+// Element-wise value: a[i], loop invariants and + or - of those. Returns the
+// reason it cannot be vectorized, or NULL.
+static const char* check_value(ASTNode* expr, ASTNode* loop, const char* iv, BaseSet* bases) {
+    switch (expr->type) {
+        case AST_INT_LIT:
+            return NULL;
+        case AST_VAR:
+            if (strcmp(expr->var_name, iv) == 0) {
+                return "induction variable used as a value";
+            }
+            if (is_derived_iv(expr->var_name)) {
+                return "no 64-bit vector multiply or divide";  // A reduced i * k
+            }
+            if (count_assigns(loop->body, expr->var_name) > 0) {
+                return "operand changes in the loop";
+            }
+            return NULL;
+        case AST_INDEX:
+            if (expr->left->type != AST_VAR || strcmp(expr->left->var_name, iv) != 0) {
+                return "index is not the induction variable";
+            }
+            if (count_assigns(loop->body, expr->var_name) > 0) {
+                return "array written in the loop";
+            }
+            return add_base(bases, expr->var_name, 0) ? NULL : "too many arrays";
+        case AST_BINOP: {
+            if (expr->binop != BINOP_PLUS && expr->binop != BINOP_MINUS) {
+                return "no 64-bit vector multiply or divide";
+            }
+            const char* reason = check_value(expr->left, loop, iv, bases);
+            return reason ? reason : check_value(expr->right, loop, iv, bases);
+        }
+        case AST_CALL_EXPR:
+        case AST_INLINE:
+            return "call in the loop body";
+        default:
+            return "unsupported expression";
+    }
+}
+
+// Loop-invariant limit: a literal, a variable or len(x)
+static int is_invariant_limit(ASTNode* expr, ASTNode* loop, const char* iv) {
+    switch (expr->type) {
+        case AST_INT_LIT:
+            return 1;
+        case AST_VAR:
+            return strcmp(expr->var_name, iv) != 0 && count_assigns(loop->body, expr->var_name) == 0;
+        case AST_CALL_EXPR:
+            return strcmp(expr->call_name, "len") == 0 && !is_user_function("len") &&
+                   expr->args && !expr->args->next_arg && expr->args->type == AST_VAR &&
+                   count_assigns(loop->body, expr->args->var_name) == 0;
+        default:
+            return 0;
+    }
+}
+
+static ASTNode* make_var(const char* name) {
+    ASTNode* node = create_ast_node(AST_VAR);
+    node->var_name = strdup(name);
+    return node;
+}
+
+// Recognize while (i < n) { a[i] = ...; ... i = i + 1; } and return NULL, or
+// the reason the loop does not qualify
+static const char* analyze(ASTNode* loop, const char** iv, ASTNode** limit, BaseSet* bases) {
+    ASTNode* cond = loop->condition;
+    if (cond->type != AST_COMPARE ||
+        (cond->compare_op != COMPARE_LT && cond->compare_op != COMPARE_GT)) {
+        return "condition is not i < n";
+    }
+    ASTNode* var = cond->compare_op == COMPARE_LT ? cond->left : cond->right;
+    *limit = cond->compare_op == COMPARE_LT ? cond->right : cond->left;
+    if (var->type != AST_VAR) {
+        return "condition is not i < n";
+    }
+    *iv = var->var_name;
+
+    // The step must be the only write to i and come last, apart from the
+    // derived-variable updates strength reduction puts after it
+    ASTNode* step = NULL;
+    for (ASTNode* stmt = loop->body->statements; stmt; stmt = stmt->right) {
+        if (stmt->type != AST_ASSIGN || !is_derived_iv(stmt->var_name)) {
+            step = stmt;
+        }
+    }
+    if (!step || step->type != AST_ASSIGN || strcmp(step->var_name, *iv) != 0 ||
+        step->left->type != AST_BINOP || step->left->binop != BINOP_PLUS ||
+        step->left->left->type != AST_VAR || strcmp(step->left->left->var_name, *iv) != 0 ||
+        step->left->right->type != AST_INT_LIT || step->left->right->int_value != 1 ||
+        count_assigns(loop->body, *iv) != 1) {
+        return "no unit step i = i + 1 at the end of the body";
+    }
+    if (!is_invariant_limit(*limit, loop, *iv)) {
+        return "loop limit is not invariant";
+    }
+    if (step == loop->body->statements) {
+        return "empty loop body";
+    }
+
+    for (ASTNode* stmt = loop->body->statements; stmt != step; stmt = stmt->right) {
+        if (stmt->type == AST_ASSIGN || stmt->type == AST_VAR_DECL) {
+            return "loop-carried scalar dependence";
+        }
+        if (stmt->type != AST_INDEX_ASSIGN) {
+            return "body statement is not an element store";
+        }
+        if (stmt->condition->type != AST_VAR || strcmp(stmt->condition->var_name, *iv) != 0) {
+            return "index is not the induction variable";
+        }
+        if (count_assigns(loop->body, stmt->var_name) > 0) {
+            return "array written in the loop";
+        }
+        const char* reason = check_value(stmt->left, loop, *iv, bases);
+        if (reason) {
+            return reason;
+        }
+        if (vector_regs(stmt->left) > MAX_VECTOR_REGS) {
+            return "expression needs too many vector registers";
+        }
+        if (!add_base(bases, stmt->var_name, 1)) {
+            return "too many arrays";
+        }
+    }
+    if (step->right) {
+        return "derived induction variable updated in the loop";
+    }
+    return NULL;
+}
+
+// Vector loop first, then the original loop as the scalar epilogue. Arrays
+// that may be written through one name and accessed through another must be
+// the same pointer or at least a vector apart, or the vector loop is skipped.
+static void vectorize_loop(ASTNode* loop) {
+    const char* iv = NULL;
+    ASTNode* limit = NULL;
+    BaseSet bases;
+    bases.count = 0;
+    loop_number++;
+
+    const char* reason = analyze(loop, &iv, &limit, &bases);
+    if (reason) {
+        if (options.vectorize_report) {
+            printf("vectorize: %s: loop %d: not vectorized (%s)\n", current_fn, loop_number, reason);
+        }
+        return;
+    }
+
+    int lanes = options.avx2 ? 4 : 2;
+    ASTNode* vec = create_ast_node(AST_VECTOR_LOOP);
+    vec->var_name = strdup(iv);
+    vec->left = clone_ast(limit);
+    vec->int_value = lanes;
+
+    ASTNode* tail = NULL;
+    for (ASTNode* stmt = loop->body->statements; stmt->right; stmt = stmt->right) {
+        ASTNode* next = stmt->right;
+        stmt->right = NULL;
+        ASTNode* copy = clone_ast(stmt);
+        stmt->right = next;
+        if (tail) {
+            tail->right = copy;
+        } else {
+            vec->statements = copy;
+        }
+        tail = copy;
+        vec->stmt_count++;
+    }
+
+    int checks = 0;
+    ASTNode** check_tail = &vec->params;
+    for (int s = 0; s < bases.count; s++) {
+        for (int b = 0; b < bases.count; b++) {
+            // Each pair once, with a stored array on the left
+            if (b == s || !bases.stored[s] || (bases.stored[b] && b < s)) {
+                continue;
+            }
+            ASTNode* check = create_ast_node(AST_COMPARE);
+            check->left = make_var(bases.names[s]);
+            check->right = make_var(bases.names[b]);
+            *check_tail = check;
+            check_tail = &check->next_arg;
+            checks++;
+        }
+    }
+
+    // Turn the loop node into { vector loop; while (...) {...} } in place
+    ASTNode* scalar = create_ast_node(AST_WHILE);
+    scalar->condition = loop->condition;
+    scalar->body = loop->body;
+    scalar->profile_key = loop->profile_key;
+    loop->profile_key = NULL;
+    vec->right = scalar;
+
+    loop->type = AST_BLOCK;
+    loop->condition = NULL;
+    loop->body = NULL;
+    loop->statements = vec;
+    loop->stmt_count = 2;
+
+    if (options.vectorize_report) {
+        printf("vectorize: %s: loop %d: vectorized (%d x 64-bit lanes, %s, %d alias check(s))\n",
+               current_fn, loop_number, lanes, options.avx2 ? "AVX2" : "SSE2", checks);
+    }
+}
+
+static void vectorize_stmts(ASTNode* stmt) {
+    while (stmt) {
+        switch (stmt->type) {
+            case AST_IF:
+                vectorize_stmts(stmt->then_block);
+                vectorize_stmts(stmt->else_block);
+                break;
+            case AST_WHILE:
+                vectorize_stmts(stmt->body);
+                vectorize_loop(stmt);
+                break;
+            case AST_BLOCK:
+                vectorize_stmts(stmt->statements);
+                break;
+            case AST_INLINE:
+            case AST_REGION:
+                vectorize_stmts(stmt->body);
+                break;
+            default:
+                break;
+        }
+        stmt = stmt->right;
+    }
+}
+
+void vectorize_loops(ASTNode* program) {
+    if (!program || program->type != AST_PROGRAM || !options.vectorize) {
+        return;
+    }
+    program_ast = program;
+
+    for (ASTNode* stmt = program->statements; stmt; stmt = stmt->right) {
+        if (stmt->type == AST_FN_DEF) {
+            current_fn = stmt->fn_name;
+            loop_number = 0;
+            vectorize_stmts(stmt->body_nodes);
+        }
+    }
+}
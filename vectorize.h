@@ -0,0 +1,8 @@
+#ifndef VECTORIZE_H
+#define VECTORIZE_H
+
+#include "parser.h"
+
+void vectorize_loops(ASTNode* program);
+
+#endif // VECTORIZE_H